@@ -12,13 +12,21 @@
 #include "common/hack.h"
 #include "common/instrumentation.h"
 
+#include "hashtable/cuckoo.h"
+#include "hashtable/cuckoo_pages.h"
 #include "hashtable/dense_hash_map.h"
+#include "hashtable/hopscotch.h"
 #include "hashtable/DPH_with_buckets.h"
 #include "hashtable/DPH_with_buckets_2.h"
+#include "hashtable/DPH_with_buckets_concurrent.h"
+#include "hashtable/DPH_tuning.h"
 #include "hashtable/sparse_hash_map.h"
 #include "hashtable/DPH_with_single_vector.h"
 #include "hashtable/unordered_map.h"
 #include "hashtable/microbenchmark.h"
+#include "hashtable/open_addressing.h"
+#include "hashtable/robin_hood.h"
+#include "hashtable/swiss_table.h"
 #include "hashtable/wordcount.h"
 
 void usage(char* name) {
@@ -33,12 +41,20 @@ void usage(char* name) {
          << "-c <double>   cutoff, at which difference ratio to stop printing (deafult: 1.01)" << endl
          << "-m <int>      maximum number of differences to print (default: 25)" << endl
          << "-b <int>      which contender to compare to the others (default: 0)" << endl
+         << "-t <filename> also benchmark the DPH-with-buckets parameters found by tune_hash" << endl
+         << "-L            only run \"find large\" on tables of 2^22 to 2^26 elements, for" << endl
+         << "              the paged cuckoo tables and DPH-with-buckets" << endl
+         << "-sv           only run the microbenchmarks on small tables, for the" << endl
+         << "              DPH_with_single_vector variants and DPH-with-buckets" << endl
          << endl
          << "Instrumentation options:" << endl
          << "-nt           disable timer instrumentation" << endl
          << "-np           disable all PAPI instrumentations" << endl
          << "-npc          disable PAPI cache instrumentation" << endl
-         << "-npi          disable PAPI instruction instrumentation" << endl;
+         << "-npi          disable PAPI instruction instrumentation" << endl
+         << "-ptlb         enable PAPI TLB instrumentation" << endl
+         << "-l            enable per-operation latency instrumentation" << endl
+         << "-s            enable structure statistics (slots, tombstones, bucket sizes)" << endl;
     exit(0);
 }
 
@@ -47,7 +63,8 @@ int main(int argc, char** argv) {
     common::arg_parser args(argc, argv);
     if (args.is_set("h") || args.is_set("-help")) usage(argv[0]);
     const std::string resultfn_prefix = args.get<std::string>("p", "results_hash_"),
-                      serializationfn = args.get<std::string>("o", "data_hash.txt");
+                      serializationfn = args.get<std::string>("o", "data_hash.txt"),
+                      tunedfn = args.get<std::string>("t", "");
     const int repetitions    = args.get<int>("n", 1),
               max_results    = args.get<int>("m", 25),
               base_contender = args.get<int>("b", 0);
@@ -56,27 +73,63 @@ int main(int argc, char** argv) {
     const bool disable_timer      = args.is_set("nt"),
                disable_papi_cache = args.is_set("npc") || args.is_set("np"),
                disable_papi_instr = args.is_set("npi") || args.is_set("np"),
+               enable_papi_tlb    = args.is_set("ptlb"),
+               enable_latency = args.is_set("l"),
+               enable_structure = args.is_set("s"),
+               large_tables = args.is_set("L"),
+               single_vector = args.is_set("sv"),
                append_results = args.is_set("a");
 
     using HashTable = hashtable::hashtable<int, int>;
     using Configuration = std::pair<size_t, size_t>;
     using Benchmark = common::benchmark<HashTable, Configuration>;
 
-    // Set up data structure contenders
+    // Set up data structure contenders and the benchmarks they run
     common::contender_list<HashTable> contenders;
-
-    // Add wrappers around std::unordered_map and Google's libsparsehash
-    hashtable::unordered_map<int, int>::register_contenders(contenders);
-    hashtable::dense_hash_map<int, int>::register_contenders(contenders);
-    hashtable::sparse_hash_map<int, int>::register_contenders(contenders);
-
-	hashtable::DPH_with_buckets<int, int>::register_contenders(contenders);
-	hashtable::DPH_with_buckets_2<int, int>::register_contenders(contenders);
-
-    // Register Benchmarks
     common::contender_list<Benchmark> benchmarks;
-    hashtable::microbenchmark<HashTable>::register_benchmarks(benchmarks);
-    hashtable::wordcount<HashTable>::register_benchmarks(benchmarks);
+
+    if (large_tables) {
+        // Building the large tables takes long, so only the paged cuckoo
+        // tables and the DPH table they compete with run on them
+        contenders.register_contender("DPH-with-buckets", "DPH-with-buckets",
+            [](){ return new hashtable::DPH_with_buckets<int, int>(1000); });
+        hashtable::cuckoo_pages<int, int>::register_contenders(contenders);
+
+        hashtable::microbenchmark<HashTable>::register_large_benchmarks(benchmarks);
+    } else if (single_vector) {
+        // DPH_with_single_vector needs space quadratic in the bucket sizes,
+        // so it only runs on small tables, next to DPH-with-buckets
+        contenders.register_contender("DPH-with-buckets", "DPH-with-buckets",
+            [](){ return new hashtable::DPH_with_buckets<int, int>(1000); });
+        hashtable::DPH_with_single_vector<int, int>::register_contenders(contenders);
+
+        const std::vector<Configuration> configs{
+            std::make_pair(1<<12, 0xDECAF),
+            std::make_pair(1<<14, 0xBEEF)
+        };
+        hashtable::microbenchmark<HashTable>::register_benchmarks(benchmarks, configs);
+    } else {
+        // Add wrappers around std::unordered_map and Google's libsparsehash
+        hashtable::unordered_map<int, int>::register_contenders(contenders);
+        hashtable::dense_hash_map<int, int>::register_contenders(contenders);
+        hashtable::sparse_hash_map<int, int>::register_contenders(contenders);
+
+		hashtable::DPH_with_buckets<int, int>::register_contenders(contenders);
+		hashtable::DPH_with_buckets_2<int, int>::register_contenders(contenders);
+		hashtable::DPH_with_buckets_concurrent<int, int>::register_contenders(contenders);
+		hashtable::open_addressing<int, int>::register_contenders(contenders);
+		hashtable::robin_hood<int, int>::register_contenders(contenders);
+		hashtable::swiss_table<int, int>::register_contenders(contenders);
+		hashtable::hopscotch<int, int>::register_contenders(contenders);
+		hashtable::cuckoo<int, int>::register_contenders(contenders);
+		hashtable::cuckoo_pages<int, int>::register_contenders(contenders);
+		if (!tunedfn.empty())
+			hashtable::register_tuned_contenders(contenders, hashtable::DPH_read_parameters(tunedfn));
+
+        // Register Benchmarks
+        hashtable::microbenchmark<HashTable>::register_benchmarks(benchmarks);
+        hashtable::wordcount<HashTable>::register_benchmarks(benchmarks);
+    }
 
     // Register instrumentations
     common::contender_list<common::instrumentation> instrumentations;
@@ -92,11 +145,28 @@ int main(int argc, char** argv) {
     if (!disable_papi_instr)
     instrumentations.register_contender("PAPI instruction", "PAPI_instr",
         [](){ return new common::papi_instrumentation_instr(); });
+
+    if (enable_papi_tlb)
+    instrumentations.register_contender("PAPI TLB", "PAPI_tlb",
+        [](){ return new common::papi_instrumentation_tlb(); });
+
+    if (enable_latency)
+    instrumentations.register_contender("latency", "latency",
+        [](){ return new common::latency_instrumentation(); });
+
+#ifdef REHASH_STATS
+    instrumentations.register_contender("rehash statistics", "rehash",
+        [](){ return new common::rehash_instrumentation(); });
+#endif
 #else
     instrumentations.register_contender("memory usage", "memory",
         [](){ return new common::memory_instrumentation(); });
 #endif
 
+    if (enable_structure)
+    instrumentations.register_contender("structure statistics", "structure",
+        [](){ return new common::structure_instrumentation(); });
+
     std::vector<std::vector<common::benchmark_result_aggregate>> results;
 
     // Run the benchmarks
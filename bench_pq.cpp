@@ -35,7 +35,8 @@ void usage(char* name) {
          << "-nt           disable timer instrumentation" << endl
          << "-np           disable all PAPI instrumentations" << endl
          << "-npc          disable PAPI cache instrumentation" << endl
-         << "-npi          disable PAPI instruction instrumentation" << endl;
+         << "-npi          disable PAPI instruction instrumentation" << endl
+         << "-ptlb         enable PAPI TLB instrumentation" << endl;
     exit(0);
 }
 
@@ -55,6 +56,7 @@ int main(int argc, char** argv) {
     const bool disable_timer      = args.is_set("nt"),
                disable_papi_cache = args.is_set("npc") || args.is_set("np"),
                disable_papi_instr = args.is_set("npi") || args.is_set("np"),
+               enable_papi_tlb    = args.is_set("ptlb"),
                append_results = args.is_set("a");
 
     using PQ = pq::priority_queue<int>;
@@ -93,6 +95,10 @@ int main(int argc, char** argv) {
     if (!disable_papi_instr)
     instrumentations.register_contender("PAPI instruction", "PAPI_instr",
         [](){ return new common::papi_instrumentation_instr(); });
+
+    if (enable_papi_tlb)
+    instrumentations.register_contender("PAPI TLB", "PAPI_tlb",
+        [](){ return new common::papi_instrumentation_tlb(); });
 #else
     instrumentations.register_contender("memory usage", "memory",
         [](){ return new common::memory_instrumentation(); });
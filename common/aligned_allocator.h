@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#include <utility>
+
+namespace common {
+
+/// Allocator that aligns every allocation to Alignment bytes, a cache line
+/// by default. C++14's operator new ignores the alignment of over-aligned
+/// types, so arrays of cache-line sized blocks need this to start each block
+/// on a line of its own.
+template <typename T, size_t Alignment = 64>
+class aligned_allocator {
+    static_assert(Alignment >= sizeof(void*) && (Alignment & (Alignment - 1)) == 0,
+                  "the alignment must be a power of two of at least a pointer's size");
+public:
+    using value_type = T;
+    using pointer = T*;
+    using const_pointer = const T*;
+    using reference = T&;
+    using const_reference = const T&;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    template <typename U>
+    struct rebind { using other = aligned_allocator<U, Alignment>; };
+
+    static const size_t alignment = Alignment;
+
+    aligned_allocator() noexcept {}
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U, Alignment> &) noexcept {}
+
+    T* allocate(size_t n, const void* = nullptr) {
+        if (n > max_size()) throw std::bad_alloc();
+        void* p = nullptr;
+        if (posix_memalign(&p, Alignment, n * sizeof(T)) != 0) throw std::bad_alloc();
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t) noexcept {
+        free(p);
+    }
+
+    size_t max_size() const noexcept {
+        return std::numeric_limits<size_t>::max() / sizeof(T);
+    }
+
+    T* address(T &x) const noexcept { return &x; }
+    const T* address(const T &x) const noexcept { return &x; }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new((void*)p) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    void destroy(U* p) {
+        p->~U();
+    }
+};
+
+template <typename T, typename U, size_t Alignment>
+bool operator==(const aligned_allocator<T, Alignment> &, const aligned_allocator<U, Alignment> &) noexcept { return true; }
+
+template <typename T, typename U, size_t Alignment>
+bool operator!=(const aligned_allocator<T, Alignment> &, const aligned_allocator<U, Alignment> &) noexcept { return false; }
+
+}
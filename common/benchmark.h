@@ -8,6 +8,7 @@
 #include <boost/serialization/base_object.hpp>
 
 #include "contenders.h"
+#include "structure_stats.h"
 #include "terminal.h"
 
 namespace common {
@@ -55,9 +56,12 @@ public:
     benchmark_result_aggregate(const benchmark_result_aggregate &other) = default;
 
     void destroy() { // can't put this in d'tor because copies are made
-        if (min != nullptr) delete min; min = nullptr;
-        if (max != nullptr) delete max; max = nullptr;
-        if (avg != nullptr) delete avg; avg = nullptr;
+        if (min != nullptr) { delete min; }
+        min = nullptr;
+        if (max != nullptr) { delete max; }
+        max = nullptr;
+        if (avg != nullptr) { delete avg; }
+        avg = nullptr;
     }
     void add_result(const benchmark_result *const result) {
         ++num_results;
@@ -198,6 +202,7 @@ public:
 
         // stop and destroy instrumentation
         instrumentation->finish();
+        if (instrumentation->inspects_structure()) structure_trace::inspect(*instance);
         auto result = instrumentation->result();
 
         // Tear down benchmark and destroy data structure
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+
+namespace common {
+
+/// Epoch-based reclamation (Fraser 2004) for data structures with lock-free
+/// readers. A reader announces the global epoch while it holds a guard; a
+/// writer retires what it unlinked in the current epoch and frees it two
+/// epochs later. The epoch only advances once every reader in a guard has
+/// announced it, so no reader can still hold a pointer to what is freed.
+///
+/// Like rehash_stats, the epoch and the reader records are global, so
+/// readers of any number of tables share them. Entering and leaving a guard
+/// is a load and a store, so readers are wait-free once their thread has
+/// registered on its first guard.
+namespace epoch {
+
+/// The announcement of one reader thread. Records are never freed, a thread
+/// that exits hands its record over to the next new reader.
+struct record {
+    /// epoch << 1 | 1 while the reader is in a guard, 0 outside
+    std::atomic<size_t> announced;
+    std::atomic<bool> taken;
+    record* next;
+    size_t depth; ///< guards nested on the owning thread
+
+    record() : announced(0), taken(true), next(nullptr), depth(0) {}
+};
+
+class domain {
+private:
+    std::atomic<size_t> global;
+    std::atomic<record*> records;
+
+public:
+    domain() : global(0), records(nullptr) {}
+
+    static domain& instance() {
+        static domain instance;
+        return instance;
+    }
+
+    size_t current() const {
+        return global.load();
+    }
+
+    /// A free record, from an exited thread or newly pushed onto the list
+    record* acquire() {
+        for (record* r = records.load(); r != nullptr; r = r->next) {
+            bool taken = false;
+            if (!r->taken.load() && r->taken.compare_exchange_strong(taken, true)) {
+                return r;
+            }
+        }
+        record* r = new record();
+        record* head = records.load();
+        do {
+            r->next = head;
+        } while (!records.compare_exchange_weak(head, r));
+        return r;
+    }
+
+    void release(record* r) {
+        r->announced.store(0);
+        r->taken.store(false);
+    }
+
+    void enter(record* r) {
+        if (r->depth++ == 0) {
+            r->announced.store(global.load() << 1 | 1);
+        }
+    }
+
+    void leave(record* r) {
+        if (--r->depth == 0) {
+            r->announced.store(0);
+        }
+    }
+
+    /// Moves on to the next epoch if every reader in a guard has announced
+    /// the current one. Returns the epoch afterwards.
+    size_t try_advance() {
+        size_t epoch = global.load();
+        for (record* r = records.load(); r != nullptr; r = r->next) {
+            size_t announced = r->announced.load();
+            if ((announced & 1) != 0 && (announced >> 1) != epoch) {
+                return epoch;
+            }
+        }
+        global.compare_exchange_strong(epoch, epoch + 1);
+        return global.load();
+    }
+};
+
+/// The record of this thread, registered on first use
+inline record* local() {
+    struct registration {
+        record* r;
+        registration() : r(domain::instance().acquire()) {}
+        ~registration() { domain::instance().release(r); }
+    };
+    static thread_local registration registration;
+    return registration.r;
+}
+
+/// Pointers loaded while a guard is alive stay valid until it is destroyed.
+/// Guards nest, only the outermost one announces the epoch.
+class guard {
+public:
+    guard() : r(local()) { domain::instance().enter(r); }
+    ~guard() { domain::instance().leave(r); }
+
+    guard(const guard &) = delete;
+    guard& operator=(const guard &) = delete;
+private:
+    record* r;
+};
+
+/// The objects a writer has unlinked and not yet freed. Each writer keeps
+/// its own list, the list is not thread-safe.
+class limbo {
+private:
+    struct retired {
+        size_t epoch;
+        void* object;
+        void (*destroy)(void*);
+    };
+    std::deque<retired> objects;
+
+    template <typename U>
+    static void destroy(void* object) {
+        delete static_cast<U*>(object);
+    }
+
+public:
+    limbo() = default;
+    limbo(const limbo &) = delete;
+    limbo& operator=(const limbo &) = delete;
+
+    /// Frees everything, the caller guarantees that no reader is left
+    ~limbo() {
+        for (retired &r : objects) {
+            r.destroy(r.object);
+        }
+    }
+
+    /// Deletes object once no reader can reach it any more. It must have
+    /// been unlinked already.
+    template <typename U>
+    void retire(U* object) {
+        objects.push_back(retired{domain::instance().current(), object, &limbo::destroy<U>});
+        collect();
+    }
+
+    /// Frees the objects that were retired at least two epochs ago
+    void collect() {
+        if (objects.empty()) {
+            return;
+        }
+        size_t epoch = domain::instance().try_advance();
+        while (!objects.empty() && objects.front().epoch + 2 <= epoch) {
+            objects.front().destroy(objects.front().object);
+            objects.pop_front();
+        }
+    }
+
+    size_t size() const {
+        return objects.size();
+    }
+};
+
+}
+}
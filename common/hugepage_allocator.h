@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+namespace common {
+
+/// Allocator that backs large arrays with huge pages, to cut the TLB misses
+/// of random accesses into them. Allocations of at least huge_page_size
+/// bytes are mapped separately: from the reserved huge pages (MAP_HUGETLB)
+/// if there are any, else 2MB-aligned with MADV_HUGEPAGE, so that
+/// transparent huge pages can back them. Without either, they get normal
+/// pages. Smaller allocations, like the nodes of linked structures, use
+/// operator new.
+///
+/// Mapped memory bypasses malloc, so malloc_count does not see it.
+template <typename T>
+class hugepage_allocator {
+public:
+    using value_type = T;
+    using pointer = T*;
+    using const_pointer = const T*;
+    using reference = T&;
+    using const_reference = const T&;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    template <typename U>
+    struct rebind { using other = hugepage_allocator<U>; };
+
+    static const size_t huge_page_size = size_t(1) << 21;
+
+    hugepage_allocator() noexcept {}
+    template <typename U>
+    hugepage_allocator(const hugepage_allocator<U> &) noexcept {}
+
+    T* allocate(size_t n, const void* = nullptr) {
+        if (n > max_size()) throw std::bad_alloc();
+        size_t bytes = n * sizeof(T);
+        if (!is_mapped(bytes)) {
+            return static_cast<T*>(::operator new(bytes));
+        }
+        return static_cast<T*>(map(round_up(bytes)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept {
+        size_t bytes = n * sizeof(T);
+        if (!is_mapped(bytes)) {
+            ::operator delete(p);
+            return;
+        }
+#if defined(__linux__)
+        munmap(p, round_up(bytes));
+#endif
+    }
+
+    size_t max_size() const noexcept {
+        return std::numeric_limits<size_t>::max() / sizeof(T);
+    }
+
+    T* address(T &x) const noexcept { return &x; }
+    const T* address(const T &x) const noexcept { return &x; }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new((void*)p) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    void destroy(U* p) {
+        p->~U();
+    }
+
+private:
+    static bool is_mapped(size_t bytes) {
+#if defined(__linux__)
+        return bytes >= huge_page_size;
+#else
+        (void)bytes;
+        return false;
+#endif
+    }
+
+    static size_t round_up(size_t bytes) {
+        return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+    }
+
+#if defined(__linux__)
+    static void* map(size_t bytes) {
+        const int prot = PROT_READ | PROT_WRITE, flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_HUGETLB
+        void* p = mmap(nullptr, bytes, prot, flags | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) return p;
+#endif
+        // Map one huge page more and trim it, so the mapping is aligned
+        char* raw = static_cast<char*>(mmap(nullptr, bytes + huge_page_size, prot, flags, -1, 0));
+        if (raw == MAP_FAILED) throw std::bad_alloc();
+        size_t head = (huge_page_size - reinterpret_cast<size_t>(raw) % huge_page_size) % huge_page_size;
+        if (head > 0) munmap(raw, head);
+        munmap(raw + head + bytes, huge_page_size - head);
+#ifdef MADV_HUGEPAGE
+        madvise(raw + head, bytes, MADV_HUGEPAGE);
+#endif
+        return raw + head;
+    }
+#else
+    static void* map(size_t bytes) {
+        return ::operator new(bytes);
+    }
+#endif
+};
+
+template <typename T, typename U>
+bool operator==(const hugepage_allocator<T> &, const hugepage_allocator<U> &) noexcept { return true; }
+
+template <typename T, typename U>
+bool operator!=(const hugepage_allocator<T> &, const hugepage_allocator<U> &) noexcept { return false; }
+
+}
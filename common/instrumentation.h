@@ -21,6 +21,7 @@
 //TODO check for more compilers and architectures for 32 and 64 bit detection
 
 #include <algorithm>
+#include <iostream>
 #include <ostream>
 #include <papi.h>
 
@@ -31,6 +32,9 @@
 
 #include "timer.h"
 #include "benchmark.h"
+#include "latency.h"
+#include "rehash_stats.h"
+#include "structure_stats.h"
 
 namespace common {
 
@@ -40,6 +44,9 @@ public:
     virtual void finish() = 0;
     virtual benchmark_result* result() const = 0;
     virtual benchmark_result* new_result(bool set_to_max = false) const = 0;
+    /// Whether the benchmark should inspect the data structure before
+    /// destroying it, see structure_instrumentation
+    virtual bool inspects_structure() const { return false; }
     virtual ~instrumentation() {}
 };
 
@@ -51,6 +58,8 @@ public:
     timer_result() : duration(0) {}
     virtual ~timer_result() {}
 
+    double milliseconds() const { return duration; }
+
     bool is_same_type(benchmark_result *other) const override {
         return dynamic_cast<timer_result*>(other) != nullptr;
     }
@@ -236,6 +245,7 @@ public:
 
 using papi_instrumentation_cache = papi_instrumentation<>;
 using papi_instrumentation_instr = papi_instrumentation<PAPI_BR_MSP, PAPI_TOT_INS, PAPI_TOT_CYC>;
+using papi_instrumentation_tlb = papi_instrumentation<PAPI_TLB_DM, PAPI_TLB_IM, PAPI_TOT_CYC>;
 
 
 class memory_result : public benchmark_result {
@@ -246,6 +256,8 @@ public:
     memory_result(size_t total, size_t peak, size_t count) : total(total), peak(peak), count(count) {}
     virtual ~memory_result() {}
 
+    size_t peak_bytes() const { return peak; }
+
     bool is_same_type(benchmark_result *other) const override {
         return dynamic_cast<memory_result*>(other) != nullptr;
     }
@@ -367,6 +379,380 @@ private:
     size_t count;
 };
 
+
+class rehash_result : public benchmark_result {
+    friend class boost::serialization::access;
+    rehash_stats stats;
+public:
+    rehash_result() {}
+    rehash_result(const rehash_stats &stats) : stats(stats) {}
+    virtual ~rehash_result() {}
+
+    bool is_same_type(benchmark_result *other) const override {
+        return dynamic_cast<rehash_result*>(other) != nullptr;
+    }
+
+    std::ostream& print(std::ostream& os) const override {
+        return os
+            << "rehashes: " << stats.rehashes
+            << "; bucket rehashes: " << stats.bucketRehashes
+            << "; retries: " << stats.retries
+            << "; bucket resizes: " << stats.bucketResizes
+            << "; displacements: " << stats.displacements
+            << "; stashed: " << stats.stashed
+            << "; rehash time: " << stats.time << "ms";
+    }
+    std::ostream& result(std::ostream& os) const override {
+        return os << " rehashes=" << stats.rehashes << " bucketrehashes=" << stats.bucketRehashes
+                  << " retries=" << stats.retries << " bucketresizes=" << stats.bucketResizes
+                  << " displacements=" << stats.displacements << " stashed=" << stats.stashed
+                  << " rehashtime=" << stats.time;
+    }
+
+    void add(const benchmark_result *const other) override {
+        const rehash_stats &o = dynamic_cast<const rehash_result*>(other)->stats;
+        stats.rehashes       += o.rehashes;
+        stats.bucketRehashes += o.bucketRehashes;
+        stats.retries        += o.retries;
+        stats.bucketResizes  += o.bucketResizes;
+        stats.displacements  += o.displacements;
+        stats.stashed        += o.stashed;
+        stats.time           += o.time;
+    };
+    void min(const benchmark_result *const other) override {
+        const rehash_stats &o = dynamic_cast<const rehash_result*>(other)->stats;
+        stats.rehashes       = std::min(stats.rehashes,       o.rehashes);
+        stats.bucketRehashes = std::min(stats.bucketRehashes, o.bucketRehashes);
+        stats.retries        = std::min(stats.retries,        o.retries);
+        stats.bucketResizes  = std::min(stats.bucketResizes,  o.bucketResizes);
+        stats.displacements  = std::min(stats.displacements,  o.displacements);
+        stats.stashed        = std::min(stats.stashed,        o.stashed);
+        stats.time           = std::min(stats.time,           o.time);
+    };
+    void max(const benchmark_result *const other) override {
+        const rehash_stats &o = dynamic_cast<const rehash_result*>(other)->stats;
+        stats.rehashes       = std::max(stats.rehashes,       o.rehashes);
+        stats.bucketRehashes = std::max(stats.bucketRehashes, o.bucketRehashes);
+        stats.retries        = std::max(stats.retries,        o.retries);
+        stats.bucketResizes  = std::max(stats.bucketResizes,  o.bucketResizes);
+        stats.displacements  = std::max(stats.displacements,  o.displacements);
+        stats.stashed        = std::max(stats.stashed,        o.stashed);
+        stats.time           = std::max(stats.time,           o.time);
+    };
+    void div(const int divisor) override {
+        stats.rehashes       /= divisor;
+        stats.bucketRehashes /= divisor;
+        stats.retries        /= divisor;
+        stats.bucketResizes  /= divisor;
+        stats.displacements  /= divisor;
+        stats.stashed        /= divisor;
+        stats.time           /= divisor;
+    };
+
+    std::vector<double> compare_to(const benchmark_result *other) override {
+        const rehash_stats &o = dynamic_cast<const rehash_result*>(other)->stats;
+        auto divide = [](double a, double b) -> double {
+            if (a == 0 && b == 0) return 1.0;
+            else return a / b;
+        };
+        return std::vector<double>{
+            divide(stats.rehashes,       o.rehashes),
+            divide(stats.bucketRehashes, o.bucketRehashes),
+            divide(stats.retries,        o.retries),
+            divide(stats.bucketResizes,  o.bucketResizes),
+            divide(stats.displacements,  o.displacements),
+            divide(stats.stashed,        o.stashed),
+            divide(stats.time,           o.time)
+        };
+    }
+
+    std::ostream& print_component(int component, std::ostream &os) override {
+        switch (component) {
+        case 0: return os << "rehashes: " << stats.rehashes;
+        case 1: return os << "bucket rehashes: " << stats.bucketRehashes;
+        case 2: return os << "retries: " << stats.retries;
+        case 3: return os << "bucket resizes: " << stats.bucketResizes;
+        case 4: return os << "displacements: " << stats.displacements;
+        case 5: return os << "stashed: " << stats.stashed;
+        case 6: return os << "rehash time: " << stats.time << "ms";
+        default: assert(false); return os;
+        }
+    }
+
+    template <typename Archive>
+    void serialize(Archive & ar, const unsigned int) {
+        ar & boost::serialization::base_object<benchmark_result>(*this);
+        ar & stats.rehashes & stats.bucketRehashes & stats.retries & stats.bucketResizes
+           & stats.displacements & stats.stashed & stats.time;
+    }
+};
+
+/// Reports the rehash telemetry of the benchmarked contender. Only meaningful
+/// in builds with REHASH_STATS, otherwise all counters stay zero.
+class rehash_instrumentation : public instrumentation {
+public:
+    virtual ~rehash_instrumentation() = default;
+    void setup() { rehash_trace::stats().reset(); }
+    void finish() { value = rehash_trace::stats(); }
+
+    virtual rehash_result* result() const { return new rehash_result(value); }
+
+    virtual rehash_result* new_result(bool set_to_max = false) const {
+        rehash_stats stats;
+        if (set_to_max) {
+            stats.rehashes = stats.bucketRehashes = stats.retries = stats.bucketResizes = ((size_t)1) << 62;
+            stats.displacements = stats.stashed = ((size_t)1) << 62;
+            stats.time = 1e100;
+        }
+        return new rehash_result(stats);
+    }
+
+private:
+    rehash_stats value;
+};
+
+
+class structure_result : public benchmark_result {
+    friend class boost::serialization::access;
+    structure_stats stats;
+public:
+    structure_result() {}
+    structure_result(const structure_stats &stats) : stats(stats) {}
+    virtual ~structure_result() {}
+
+    bool is_same_type(benchmark_result *other) const override {
+        return dynamic_cast<structure_result*>(other) != nullptr;
+    }
+
+    std::ostream& print(std::ostream& os) const override {
+        os << "slots: " << stats.slots
+           << "; entries: " << stats.entries
+           << "; tombstones: " << stats.tombstones
+           << "; bytes: " << stats.bytes
+           << "; buckets: " << stats.buckets;
+        if (stats.buckets > 0) {
+            os << "; bucket sizes:";
+            for (size_t c = 0; c < structure_stats::size_classes; ++c) {
+                if (stats.bucketSizes[c] > 0) {
+                    os << " " << size_class_desc(c) << ":" << stats.bucketSizes[c];
+                }
+            }
+        }
+        return os;
+    }
+    std::ostream& result(std::ostream& os) const override {
+        os << " slots=" << stats.slots << " entries=" << stats.entries
+           << " tombstones=" << stats.tombstones << " structbytes=" << stats.bytes
+           << " buckets=" << stats.buckets;
+        for (size_t c = 0; c < structure_stats::size_classes; ++c) {
+            os << " bucketsize" << c << "=" << stats.bucketSizes[c];
+        }
+        return os;
+    }
+
+    void add(const benchmark_result *const other) override {
+        combine(other, [](size_t a, size_t b) { return a + b; });
+    };
+    void min(const benchmark_result *const other) override {
+        combine(other, [](size_t a, size_t b) { return std::min(a, b); });
+    };
+    void max(const benchmark_result *const other) override {
+        combine(other, [](size_t a, size_t b) { return std::max(a, b); });
+    };
+    void div(const int divisor) override {
+        combine(this, [divisor](size_t a, size_t) { return a / divisor; });
+    };
+
+    std::vector<double> compare_to(const benchmark_result *other) override {
+        const structure_stats &o = dynamic_cast<const structure_result*>(other)->stats;
+        auto divide = [](double a, double b) -> double {
+            if (a == 0 && b == 0) return 1.0;
+            else return a / b;
+        };
+        return std::vector<double>{
+            divide(stats.slots,      o.slots),
+            divide(stats.entries,    o.entries),
+            divide(stats.tombstones, o.tombstones),
+            divide(stats.bytes,      o.bytes),
+            divide(stats.buckets,    o.buckets)
+        };
+    }
+
+    std::ostream& print_component(int component, std::ostream &os) override {
+        switch (component) {
+        case 0: return os << "slots: " << stats.slots;
+        case 1: return os << "entries: " << stats.entries;
+        case 2: return os << "tombstones: " << stats.tombstones;
+        case 3: return os << "bytes: " << stats.bytes;
+        case 4: return os << "buckets: " << stats.buckets;
+        default: assert(false); return os;
+        }
+    }
+
+    template <typename Archive>
+    void serialize(Archive & ar, const unsigned int) {
+        ar & boost::serialization::base_object<benchmark_result>(*this);
+        ar & stats.slots & stats.entries & stats.tombstones & stats.bytes & stats.buckets;
+        ar & stats.bucketSizes;
+    }
+
+private:
+    template <typename F>
+    void combine(const benchmark_result *const other, F f) {
+        const structure_stats &o = dynamic_cast<const structure_result*>(other)->stats;
+        stats.slots      = f(stats.slots,      o.slots);
+        stats.entries    = f(stats.entries,    o.entries);
+        stats.tombstones = f(stats.tombstones, o.tombstones);
+        stats.bytes      = f(stats.bytes,      o.bytes);
+        stats.buckets    = f(stats.buckets,    o.buckets);
+        for (size_t c = 0; c < structure_stats::size_classes; ++c) {
+            stats.bucketSizes[c] = f(stats.bucketSizes[c], o.bucketSizes[c]);
+        }
+    }
+
+    static std::string size_class_desc(size_t c) {
+        if (c == 0) return "0";
+        std::ostringstream s;
+        s << (size_t(1) << (c - 1));
+        if (c + 1 == structure_stats::size_classes) s << "+";
+        else if (c > 1) s << "-" << (size_t(1) << c) - 1;
+        return s.str();
+    }
+};
+
+/// Reports the space statistics of the data structure as the benchmark left
+/// it: slots, live entries, tombstones, bytes and the bucket size histogram.
+/// Data structures without an inspect(structure_stats&) member report zeros.
+class structure_instrumentation : public instrumentation {
+public:
+    virtual ~structure_instrumentation() = default;
+    void setup() {}
+    void finish() {}
+    bool inspects_structure() const override { return true; }
+
+    virtual structure_result* result() const { return new structure_result(structure_trace::stats()); }
+
+    virtual structure_result* new_result(bool set_to_max = false) const {
+        structure_stats stats;
+        if (set_to_max) {
+            stats.slots = stats.entries = stats.tombstones = stats.bytes = stats.buckets = ((size_t)1) << 62;
+            for (size_t c = 0; c < structure_stats::size_classes; ++c) {
+                stats.bucketSizes[c] = ((size_t)1) << 62;
+            }
+        }
+        return new structure_result(stats);
+    }
+};
+
+
+class latency_result : public benchmark_result {
+    friend class boost::serialization::access;
+    double median, p99, maximum;
+public:
+    latency_result() : median(0), p99(0), maximum(0) {}
+    latency_result(double median, double p99, double maximum)
+        : median(median), p99(p99), maximum(maximum) {}
+    virtual ~latency_result() {}
+
+    bool is_same_type(benchmark_result *other) const override {
+        return dynamic_cast<latency_result*>(other) != nullptr;
+    }
+
+    std::ostream& print(std::ostream& os) const override {
+        return os << "median latency: " << median << "ns; p99 latency: " << p99
+                  << "ns; max latency: " << maximum << "ns";
+    }
+    std::ostream& result(std::ostream& os) const override {
+        return os << " latencymedian=" << median << " latencyp99=" << p99
+                  << " latencymax=" << maximum;
+    }
+
+    void add(const benchmark_result *const other) override {
+        const latency_result *o = dynamic_cast<const latency_result*>(other);
+        median += o->median;
+        p99 += o->p99;
+        maximum += o->maximum;
+    };
+    void min(const benchmark_result *const other) override {
+        const latency_result *o = dynamic_cast<const latency_result*>(other);
+        median = std::min(median, o->median);
+        p99 = std::min(p99, o->p99);
+        maximum = std::min(maximum, o->maximum);
+    };
+    void max(const benchmark_result *const other) override {
+        const latency_result *o = dynamic_cast<const latency_result*>(other);
+        median = std::max(median, o->median);
+        p99 = std::max(p99, o->p99);
+        maximum = std::max(maximum, o->maximum);
+    };
+    void div(const int divisor) override {
+        median /= divisor;
+        p99 /= divisor;
+        maximum /= divisor;
+    };
+
+    std::vector<double> compare_to(const benchmark_result *other) override {
+        const latency_result *o = dynamic_cast<const latency_result*>(other);
+        auto divide = [](double a, double b) -> double {
+            if (a == 0 && b == 0) return 1.0;
+            else return a / b;
+        };
+        return std::vector<double>{
+            divide(median, o->median),
+            divide(p99, o->p99),
+            divide(maximum, o->maximum)
+        };
+    }
+
+    std::ostream& print_component(int component, std::ostream &os) override {
+        switch (component) {
+        case 0: return os << "median latency: " << median << "ns";
+        case 1: return os << "p99 latency: " << p99 << "ns";
+        case 2: return os << "max latency: " << maximum << "ns";
+        default: assert(false); return os;
+        }
+    }
+
+    template <typename Archive>
+    void serialize(Archive & ar, const unsigned int) {
+        ar & boost::serialization::base_object<benchmark_result>(*this);
+        ar & median & p99 & maximum;
+    }
+};
+
+/// Summarises the per-operation latencies recorded by the benchmark through
+/// latency::sample. Benchmarks that record no samples report zeros.
+class latency_instrumentation : public instrumentation {
+public:
+    latency_instrumentation() : median(0), p99(0), maximum(0) {}
+    virtual ~latency_instrumentation() = default;
+    void setup() { latency::samples().clear(); }
+    void finish() {
+        std::vector<double> &samples = latency::samples();
+        median = p99 = maximum = 0;
+        if (samples.empty()) return;
+        median = quantile(samples, 0.5);
+        p99 = quantile(samples, 0.99);
+        maximum = *std::max_element(samples.begin(), samples.end());
+    }
+
+    virtual latency_result* result() const { return new latency_result(median, p99, maximum); }
+
+    virtual latency_result* new_result(bool set_to_max = false) const {
+        if (set_to_max) return new latency_result(1e100, 1e100, 1e100);
+        return new latency_result();
+    }
+
+private:
+    static double quantile(std::vector<double> &samples, double q) {
+        auto nth = samples.begin() + (size_t)(q * (samples.size() - 1));
+        std::nth_element(samples.begin(), nth, samples.end());
+        return *nth;
+    }
+
+    double median, p99, maximum;
+};
+
 }
 
 
@@ -380,3 +766,12 @@ BOOST_CLASS_EXPORT_IMPLEMENT(common::papi_result)
 
 BOOST_CLASS_EXPORT_KEY(common::memory_result)
 BOOST_CLASS_EXPORT_IMPLEMENT(common::memory_result)
+
+BOOST_CLASS_EXPORT_KEY(common::rehash_result)
+BOOST_CLASS_EXPORT_IMPLEMENT(common::rehash_result)
+
+BOOST_CLASS_EXPORT_KEY(common::structure_result)
+BOOST_CLASS_EXPORT_IMPLEMENT(common::structure_result)
+
+BOOST_CLASS_EXPORT_KEY(common::latency_result)
+BOOST_CLASS_EXPORT_IMPLEMENT(common::latency_result)
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace common {
+
+/// Per-operation latency samples. Benchmarks time single operations with a
+/// latency::sample, latency_instrumentation summarises them. Like
+/// rehash_stats, the samples are global, so the instrumentation does not
+/// need to know the benchmark.
+namespace latency {
+
+/// The recorded latencies, in ns
+inline std::vector<double>& samples() {
+    static std::vector<double> samples;
+    return samples;
+}
+
+/// Records its lifetime as one sample
+class sample {
+public:
+    sample() : start(std::chrono::steady_clock::now()) {}
+    ~sample() {
+        samples().push_back(std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+}
+}
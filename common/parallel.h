@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace common {
+
+/// Splits [0, n) into `blocks` contiguous blocks and calls
+/// f(block, begin, end) for each of them on its own thread. The first block
+/// runs on the calling thread, so a single block spawns no thread at all.
+template <typename F>
+void parallel_blocks(size_t blocks, size_t n, F f) {
+    std::vector<std::thread> workers;
+    for (size_t block = 1; block < blocks; ++block) {
+        workers.emplace_back(f, block, n * block / blocks, n * (block + 1) / blocks);
+    }
+    f(size_t(0), size_t(0), n / std::max(blocks, size_t(1)));
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+/// Calls f(i) for every i in [0, n) on up to `threads` threads. Indices are
+/// handed out one at a time, so uneven work per index is balanced.
+template <typename F>
+void parallel_for(size_t threads, size_t n, F f) {
+    std::atomic<size_t> next(0);
+    parallel_blocks(std::max(size_t(1), std::min(threads, n)), n, [&](size_t, size_t, size_t) {
+        for (size_t i = next++; i < n; i = next++) {
+            f(i);
+        }
+    });
+}
+
+}
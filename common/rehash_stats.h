@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+
+#include "timer.h"
+
+namespace common {
+
+/// Telemetry of hash tables that rebuild themselves with fresh hash functions.
+/// Contenders report events through rehash_trace. Like malloc_count's
+/// counters, the statistics are global, so rehash_instrumentation can read
+/// them without knowing the data structure.
+struct rehash_stats {
+    size_t rehashes;       ///< rebuilds of the whole table
+    size_t bucketRehashes; ///< rebuilds of a single bucket
+    size_t retries;        ///< hash functions that were drawn and rejected
+    size_t bucketResizes;  ///< buckets that changed their length
+    size_t displacements;  ///< entries moved aside to make room for an insert
+    size_t stashed;        ///< inserts that found no room and went to a stash
+    double time;           ///< time spent rebuilding, in ms
+
+    rehash_stats() : rehashes(0), bucketRehashes(0), retries(0), bucketResizes(0),
+                     displacements(0), stashed(0), time(0) {}
+
+    void reset() { *this = rehash_stats(); }
+};
+
+/// Recording functions for rehash_stats. They compile to nothing unless
+/// REHASH_STATS is defined, so release benchmarks don't pay for them.
+namespace rehash_trace {
+
+inline rehash_stats& stats() {
+    static rehash_stats stats;
+    return stats;
+}
+
+#ifdef REHASH_STATS
+/// Guards the counters, as buckets may be rebuilt on several threads
+inline std::mutex& stats_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+inline void count(size_t rehash_stats::*counter) {
+    std::lock_guard<std::mutex> lock(stats_mutex());
+    ++(stats().*counter);
+}
+
+inline void rehash()        { count(&rehash_stats::rehashes); }
+inline void bucket_rehash() { count(&rehash_stats::bucketRehashes); }
+inline void retry()         { count(&rehash_stats::retries); }
+inline void bucket_resize() { count(&rehash_stats::bucketResizes); }
+inline void stash()         { count(&rehash_stats::stashed); }
+
+inline void displace(size_t entries) {
+    std::lock_guard<std::mutex> lock(stats_mutex());
+    stats().displacements += entries;
+}
+
+/// Adds its lifetime to the rehash time. Rebuilds nest (a full rehash
+/// rebuilds every bucket), so only the outermost scope is counted. Scopes
+/// are only opened on the thread that runs the table's operations.
+class scope {
+public:
+    scope() { ++depth(); }
+    ~scope() {
+        if (--depth() == 0) stats().time += t.get();
+    }
+private:
+    static size_t& depth() {
+        static size_t depth = 0;
+        return depth;
+    }
+    timer t;
+};
+#else
+inline void rehash() {}
+inline void bucket_rehash() {}
+inline void retry() {}
+inline void bucket_resize() {}
+inline void stash() {}
+inline void displace(size_t) {}
+
+class scope {
+public:
+    scope() {}
+};
+#endif
+
+}
+}
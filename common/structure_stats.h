@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+namespace common {
+
+/// Where a data structure's space goes, as reported by its inspect(stats)
+/// member after a benchmark. Like rehash_stats, the record is global, so
+/// structure_instrumentation can read it without knowing the data structure.
+struct structure_stats {
+    /// Buckets are counted by their live entries in power-of-two classes:
+    /// class 0 holds the empty buckets, class i > 0 those with
+    /// [2^(i-1), 2^i) entries, and the last class everything above.
+    static const size_t size_classes = 16;
+
+    size_t slots;      ///< allocated slots, live or not
+    size_t entries;    ///< live entries
+    size_t tombstones; ///< slots of erased entries not yet reclaimed
+    size_t bytes;      ///< bytes of the slots and bucket headers, not of scratch buffers
+    size_t buckets;    ///< number of buckets, 0 for unbucketed structures
+    size_t bucketSizes[size_classes]; ///< buckets per size class
+
+    structure_stats() : slots(0), entries(0), tombstones(0), bytes(0), buckets(0), bucketSizes() {}
+
+    void reset() { *this = structure_stats(); }
+
+    /// The size class of a bucket with the given number of entries
+    static size_t size_class(size_t entries) {
+        size_t c = 0;
+        while (entries > 0 && c + 1 < size_classes) {
+            entries >>= 1;
+            ++c;
+        }
+        return c;
+    }
+
+    /// Adds a bucket with the given number of slots and live entries
+    void add_bucket(size_t bucketSlots, size_t bucketEntries, size_t bucketTombstones) {
+        slots += bucketSlots;
+        entries += bucketEntries;
+        tombstones += bucketTombstones;
+        ++buckets;
+        ++bucketSizes[size_class(bucketEntries)];
+    }
+};
+
+namespace structure_trace {
+
+inline structure_stats& stats() {
+    static structure_stats stats;
+    return stats;
+}
+
+/// Records the statistics of data structures that provide
+/// inspect(structure_stats&) const, and nothing for all others
+template <typename DataStructure>
+auto inspect(const DataStructure &ds, int) -> decltype(ds.inspect(stats()), void()) {
+    stats().reset();
+    ds.inspect(stats());
+}
+
+template <typename DataStructure>
+void inspect(const DataStructure &, long) {
+    stats().reset();
+}
+
+template <typename DataStructure>
+void inspect(const DataStructure &ds) {
+    inspect(ds, 0);
+}
+
+}
+}
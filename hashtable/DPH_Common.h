@@ -1,185 +1,1079 @@
-#pragma once
-
-#include <cassert>
-#include <iostream>
-#include <random>
-
-#include <primesieve.hpp>
-
-using namespace common::monad;
-
-namespace hashtable {
-
-class bucket_hash_function {
-private:
-	size_t _random;
-	size_t _random2;
-	size_t _prime;
-	size_t _size;
-	
-public:
-	bucket_hash_function() : bucket_hash_function(0, 0, 0, 0) { }
-	bucket_hash_function(size_t random, size_t random2, size_t prime, size_t size) :
-		_random(random),
-		_random2(random2),
-		_prime(prime),
-		_size(size)
-	{ }
-
-	void setParameters(size_t random, size_t random2, size_t prime, size_t size) {
-		_random = random;
-		_random2 = random2;
-		_prime = prime;
-		_size = size;
-	}
-	size_t operator()(size_t& x) const {
-		assert(_random >= size_t(1) and _random <= (_prime - 1));
-		assert(_prime >= _size);
-		size_t product = _random * x;
-		size_t sum = product + _random2;
-		size_t primed = sum % _prime;
-		size_t sized = primed % _size;
-		return sized;
-	}
-};
-
-class entry_hash_function {
-private:
-	size_t _random;
-	size_t _random2;
-	size_t _prime;
-
-public:
-	entry_hash_function() : entry_hash_function(0, 0, 0) { }
-	entry_hash_function(size_t random, size_t random2, size_t prime) :
-		_random(random),
-		_random2(random2),
-		_prime(prime)
-	{ }
-
-	void setParameters(size_t random, size_t random2, size_t prime) {
-		_random = random;
-		_random2 = random2;
-		_prime = prime;
-	}
-	size_t operator()(size_t& x) const {
-		assert(_random >= size_t(1) and _random <= (_prime - 1));
-		size_t product = _random * x;
-		size_t sum = product + _random2;
-		size_t primed = sum % _prime;
-		return primed;
-	}
-};
-
-class prime_generator {
-public:
-	size_t operator()(size_t greaterEqualsThan) {
-		std::vector<size_t> primes;
-		primesieve::generate_n_primes<size_t>(1, greaterEqualsThan, &primes);
-		return primes[0];
-	}
-};
-
-class random_generator {
-public:
-	size_t operator()(size_t from, size_t to) {
-		// Seed with a real random value, if available
-		std::random_device device;
-		std::default_random_engine engine(device());
-		std::uniform_int_distribution<size_t> uniform_dist(from, to);
-		return uniform_dist(engine);
-	}
-};
-
-template <typename Key, typename T>
-class bucket_entry {
-private:
-	Key _key;
-	T _value;
-	bool initialized;
-	bool deleteFlag;
-public:
-	bucket_entry() : _key(Key()), _value(T()), initialized(false), deleteFlag(false) {
-	}
-	bucket_entry(Key& key, T& value)  : _key(key), _value(value), initialized(false), deleteFlag(false)  {
-	}
-	
-	Key& getKey() {
-		return _key;
-	}
-	
-	T& getValue() {
-		return _value;
-	}
-
-	maybe<T> find(const Key &requestedKey) const {
-		if (initialized && !deleteFlag) {
-			// If this is not the case something with the dynamic rehashing didn't work out
-			assert(requestedKey == requestedKey);
-			((void) requestedKey);
-			return just<T>(_value);
-		} else {
-			return nothing<T>();
-		}
-	}
-
-	bool isInitialized() {
-		return initialized;
-	}
-
-	void initialize(Key key) {
-		_key = key;
-		initialized = true;
-	}
-
-	bool isDeleted() {
-		return deleteFlag;
-	}
-
-	void markDeleted() {
-		deleteFlag = true;
-	}
-};
-
-class rehash_counters {
-public:
-	int resizeAndRehashBucketCounter;
-	int rehashBucketCounter;
-	int rehashBucketNewFunctionCounter;
-	int rehashAllCounter;
-	int rehashAllNewFunctionCounter;
-	int rehashAllNewBucketFunctionCounter;
-
-	rehash_counters() {
-		resizeAndRehashBucketCounter = 0;
-		rehashBucketCounter = 0;
-		rehashBucketNewFunctionCounter = 0;
-		rehashAllCounter = 0;
-		rehashAllNewFunctionCounter = 0;
-		rehashAllNewBucketFunctionCounter = 0;
-	}
-
-	double rehashBucketNewFunctionRatio() {
-		return rehashBucketCounter / (double) rehashBucketNewFunctionCounter;
-	}
-
-	double rehashAllNewFunctionRatio() {
-		return rehashAllCounter / (double) rehashAllNewFunctionCounter;
-	}
-
-	double rehashAllNewBucketFunctionRatio() {
-		return rehashAllCounter / (double) rehashAllNewBucketFunctionCounter;
-	}
-
-	void print() {
-		std::cout << "Resize and Rehash Bucket: " << resizeAndRehashBucketCounter << std::endl;
-		std::cout << "Rehash Bucket: " << rehashBucketCounter << std::endl;
-		std::cout << "Rehash Bucket New Function Ratio: " << rehashBucketNewFunctionRatio() << std::endl;
-		std::cout << "Rehash All: " << rehashAllCounter << std::endl;
-		std::cout << "Rehash All New Function Ratio: " << rehashAllNewFunctionRatio() << std::endl;
-		std::cout << "Rehash All New Bucket Function Ratio: " << rehashAllNewBucketFunctionRatio() << std::endl;
-		std::cout << std::endl;
-	}
-};
-
-}
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+#include "../common/hugepage_allocator.h"
+#include "../common/parallel.h"
+#include "../common/rehash_stats.h"
+
+using namespace common::monad;
+
+namespace hashtable {
+
+/// Remainder by a divisor that is fixed when the hash function is drawn.
+/// Barrett reduction with a precomputed 64 bit reciprocal: one high
+/// multiplication estimates the quotient, which is off by at most one, so a
+/// multiply, a subtraction and a conditional correction replace the
+/// hardware division.
+class fast_modulo {
+private:
+	size_t _reciprocal;
+	size_t _divisor;
+
+public:
+	fast_modulo() : fast_modulo(1) { }
+	explicit fast_modulo(size_t divisor) :
+		_reciprocal(divisor > 0 ? ~size_t(0) / divisor : 0),
+		_divisor(divisor)
+	{ }
+
+	size_t divisor() const {
+		return _divisor;
+	}
+
+	size_t operator()(size_t x) const {
+		size_t quotient = size_t((__uint128_t(x) * _reciprocal) >> 64);
+		size_t remainder = x - quotient * _divisor;
+		return remainder >= _divisor ? remainder - _divisor : remainder;
+	}
+};
+
+/// Plain % reduction, kept as a baseline to compare fast_modulo against
+class hardware_modulo {
+private:
+	size_t _divisor;
+
+public:
+	hardware_modulo() : hardware_modulo(1) { }
+	explicit hardware_modulo(size_t divisor) : _divisor(divisor) { }
+
+	size_t divisor() const {
+		return _divisor;
+	}
+
+	size_t operator()(size_t x) const {
+		return x % _divisor;
+	}
+};
+
+/// Answers "smallest prime >= n". Small queries are a bit scan over a sieve
+/// of the odd numbers below `limit` that is built once, on first use, and is
+/// read-only afterwards. Larger queries fall back to a deterministic
+/// Miller-Rabin test on the candidates above n.
+class prime_table {
+public:
+	static const size_t limit = size_t(1) << 22;
+
+	static size_t next(size_t greaterEqualsThan) {
+		static const prime_table table;
+		return table.find(greaterEqualsThan);
+	}
+
+private:
+	// Bit i is set iff 2i+1 is composite
+	std::vector<uint64_t> composite;
+
+	prime_table() : composite(limit / 128, 0) {
+		composite[0] |= 1; // 1 is not a prime
+		for (size_t p = 3; p * p < limit; p += 2) {
+			if (isComposite(p)) continue;
+			for (size_t multiple = p * p; multiple < limit; multiple += 2 * p) {
+				composite[multiple / 128] |= uint64_t(1) << ((multiple / 2) % 64);
+			}
+		}
+	}
+
+	bool isComposite(size_t odd) const {
+		return (composite[odd / 128] >> ((odd / 2) % 64)) & 1;
+	}
+
+	size_t find(size_t n) const {
+		if (n <= 2) return 2;
+		if (n < limit) {
+			size_t word = n / 128;
+			uint64_t primes = ~composite[word] & (~uint64_t(0) << ((n / 2) % 64));
+			while (primes == 0 && ++word < composite.size()) {
+				primes = ~composite[word];
+			}
+			if (primes != 0) {
+				return 2 * (64 * word + __builtin_ctzll(primes)) + 1;
+			}
+			n = limit;
+		}
+		size_t candidate = n | 1;
+		while (!isPrime(candidate)) {
+			candidate += 2;
+		}
+		return candidate;
+	}
+
+	static size_t mulmod(size_t a, size_t b, size_t m) {
+		return size_t((__uint128_t(a) * b) % m);
+	}
+
+	static size_t powmod(size_t base, size_t exponent, size_t m) {
+		size_t result = 1;
+		base %= m;
+		while (exponent > 0) {
+			if (exponent & 1) result = mulmod(result, base, m);
+			base = mulmod(base, base, m);
+			exponent >>= 1;
+		}
+		return result;
+	}
+
+	// Deterministic for all 64 bit inputs with these bases
+	static bool isPrime(size_t n) {
+		static const size_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+		for (size_t base : bases) {
+			if (n % base == 0) return n == base;
+		}
+		size_t d = n - 1;
+		size_t s = 0;
+		while (d % 2 == 0) {
+			d /= 2;
+			++s;
+		}
+		for (size_t base : bases) {
+			size_t x = powmod(base, d, n);
+			if (x == 1 || x == n - 1) continue;
+			bool witness = true;
+			for (size_t r = 1; r < s && witness; ++r) {
+				x = mulmod(x, x, n);
+				witness = x != n - 1;
+			}
+			if (witness) return false;
+		}
+		return true;
+	}
+};
+
+/*
+ * Universal hash families for the DPH tables. A family rounds table
+ * lengths to sizes it can address (length) and provides a function type
+ * that draws its parameters with randomize(randoms, size) and maps
+ * pre-hashed keys to [0, size), one at a time or a block of them at once
+ * with hashBlock(keys, slots, amount).
+ */
+
+/// Whether the CPU we run on has AVX2. Kernels that use it are compiled
+/// for it separately, so the rest of the build needs no -mavx2. Define
+/// NO_SIMD_HASHING to always use the scalar code.
+inline bool has_avx2() {
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(NO_SIMD_HASHING)
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	return avx2;
+#else
+	return false;
+#endif
+}
+
+/// ((a*x + b) mod p) mod size with a prime p >= size (Carter & Wegman)
+template <typename Modulo = fast_modulo>
+class prime_modulo_family {
+public:
+	static size_t length(size_t minLength) {
+		return prime_table::next(minLength);
+	}
+
+	class function {
+	private:
+		size_t _random;
+		size_t _random2;
+		Modulo _prime;
+		Modulo _size;
+		bool _reduce; // false if size is the prime itself
+
+	public:
+		function() : _random(1), _random2(0), _prime(1), _size(1), _reduce(false) { }
+
+		template <typename Random>
+		void randomize(Random &randoms, size_t size) {
+			size_t prime = prime_table::next(size);
+			_random = randoms(1, prime - 1);
+			_random2 = randoms(1, prime - 1);
+			_prime = Modulo(prime);
+			_size = Modulo(size);
+			_reduce = prime != size;
+		}
+
+		size_t operator()(size_t x) const {
+			size_t primed = _prime(_random * x + _random2);
+			return _reduce ? _size(primed) : primed;
+		}
+
+		/// There are no 64 bit high multiplications in AVX2, but the
+		/// independent iterations still overlap in the pipeline
+		void hashBlock(const size_t* keys, size_t* slots, size_t amount) const {
+			for (size_t i = 0; i < amount; ++i) {
+				slots[i] = (*this)(keys[i]);
+			}
+		}
+	};
+};
+
+/// Dietzfelbinger et al.'s multiply-shift: the top bits of a*x + b mod 2^64.
+/// Lengths are powers of two, so lookups in buckets need no reduction at all.
+/// Other sizes (bucket amounts) scale the top 32 bits into range instead.
+class multiply_shift_family {
+public:
+	static size_t length(size_t minLength) {
+		size_t length = 1;
+		while (length < minLength) length <<= 1;
+		return length;
+	}
+
+	class function {
+	private:
+		size_t _random;
+		size_t _random2;
+		size_t _size;
+
+	public:
+		function() : _random(1), _random2(0), _size(1) { }
+
+		template <typename Random>
+		void randomize(Random &randoms, size_t size) {
+			assert(size <= (size_t(1) << 32));
+			_random = randoms(0, ~size_t(0)) | 1;
+			_random2 = randoms(0, ~size_t(0));
+			_size = size;
+		}
+
+		size_t operator()(size_t x) const {
+			return (((_random * x + _random2) >> 32) * _size) >> 32;
+		}
+
+		/// Four keys per AVX2 instruction; a size of 2^32 doesn't fit the
+		/// 32 bit multiplication and stays scalar
+		void hashBlock(const size_t* keys, size_t* slots, size_t amount) const {
+			size_t i = 0;
+#if defined(__x86_64__) && defined(__GNUC__)
+			if (_size < (size_t(1) << 32) && has_avx2()) {
+				i = hashBlockAVX2(keys, slots, amount);
+			}
+#endif
+			for (; i < amount; ++i) {
+				slots[i] = (*this)(keys[i]);
+			}
+		}
+
+	private:
+#if defined(__x86_64__) && defined(__GNUC__)
+		/// Hashes the keys in groups of four and returns how many it hashed.
+		/// AVX2 only multiplies 32 bit halves, so the low 64 bits of a*x are
+		/// lo(a)lo(x) + ((lo(a)hi(x) + hi(a)lo(x)) << 32).
+		__attribute__((target("avx2")))
+		size_t hashBlockAVX2(const size_t* keys, size_t* slots, size_t amount) const {
+			const __m256i a = _mm256_set1_epi64x(_random);
+			const __m256i aHigh = _mm256_srli_epi64(a, 32);
+			const __m256i b = _mm256_set1_epi64x(_random2);
+			const __m256i size = _mm256_set1_epi64x(_size);
+			size_t i = 0;
+			for (; i + 4 <= amount; i += 4) {
+				__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+				__m256i cross = _mm256_add_epi64(_mm256_mul_epu32(aHigh, x),
+												 _mm256_mul_epu32(a, _mm256_srli_epi64(x, 32)));
+				__m256i product = _mm256_add_epi64(_mm256_mul_epu32(a, x), _mm256_slli_epi64(cross, 32));
+				__m256i top = _mm256_srli_epi64(_mm256_add_epi64(product, b), 32);
+				__m256i slot = _mm256_srli_epi64(_mm256_mul_epu32(top, size), 32);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(slots + i), slot);
+			}
+			return i;
+		}
+#endif
+	};
+};
+
+/// Simple tabulation hashing (Zobrist; Patrascu & Thorup 2011): xor of one
+/// random table entry per key byte. Needs no multiplication or division but
+/// 8KB of tables per function.
+class tabulation_family {
+public:
+	static size_t length(size_t minLength) {
+		return minLength;
+	}
+
+	class function {
+	private:
+		uint32_t _tables[sizeof(size_t)][256];
+		size_t _size;
+
+	public:
+		function() : _tables(), _size(1) { }
+
+		template <typename Random>
+		void randomize(Random &randoms, size_t size) {
+			assert(size <= (size_t(1) << 32));
+			for (auto &table : _tables) {
+				for (uint32_t &entry : table) {
+					entry = uint32_t(randoms());
+				}
+			}
+			_size = size;
+		}
+
+		size_t operator()(size_t x) const {
+			uint32_t hash = 0;
+			for (size_t i = 0; i < sizeof(size_t); ++i) {
+				hash ^= _tables[i][(x >> (8 * i)) & 0xFF];
+			}
+			return (size_t(hash) * _size) >> 32;
+		}
+
+		void hashBlock(const size_t* keys, size_t* slots, size_t amount) const {
+			for (size_t i = 0; i < amount; ++i) {
+				slots[i] = (*this)(keys[i]);
+			}
+		}
+	};
+};
+
+/// SplitMix64 (Steele, Lea & Flood 2014) for drawing hash function
+/// parameters. Every table owns one and seeds it once, so a run is
+/// reproducible for a given seed and no draw touches the OS entropy source.
+class random_generator {
+private:
+	uint64_t _state;
+
+public:
+	static const size_t default_seed = 0x5EED;
+
+	explicit random_generator(size_t seed = default_seed) : _state(seed) { }
+
+	void seed(size_t seed) {
+		_state = seed;
+	}
+
+	/// Uniform 64 bit value, also used to seed the generators of buckets
+	size_t operator()() {
+		uint64_t z = (_state += 0x9E3779B97F4A7C15);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+		return z ^ (z >> 31);
+	}
+
+	/// Uniform value in [from, to], unbiased by Lemire's multiply-and-reject
+	size_t operator()(size_t from, size_t to) {
+		size_t range = to - from + 1;
+		if (range == 0) {
+			return (*this)(); // [from, to] covers all 64 bit values
+		}
+		__uint128_t product = __uint128_t((*this)()) * range;
+		if (size_t(product) < range) {
+			size_t threshold = (0 - range) % range;
+			while (size_t(product) < threshold) {
+				product = __uint128_t((*this)()) * range;
+			}
+		}
+		return from + size_t(product >> 64);
+	}
+};
+
+template <typename Key, typename T>
+class bucket_entry {
+private:
+	Key _key;
+	T _value;
+	bool initialized;
+	bool deleteFlag;
+public:
+	bucket_entry() : _key(Key()), _value(T()), initialized(false), deleteFlag(false) {
+	}
+	bucket_entry(Key& key, T& value)  : _key(key), _value(value), initialized(false), deleteFlag(false)  {
+	}
+	
+	Key& getKey() {
+		return _key;
+	}
+
+	const Key& getKey() const {
+		return _key;
+	}
+	
+	T& getValue() {
+		return _value;
+	}
+
+	const T& getValue() const {
+		return _value;
+	}
+
+	maybe<T> find(const Key &requestedKey) const {
+		if (initialized && !deleteFlag && _key == requestedKey) {
+			return just<T>(_value);
+		} else {
+			return nothing<T>();
+		}
+	}
+
+	const T* find_ptr(const Key &requestedKey) const {
+		if (initialized && !deleteFlag && _key == requestedKey) {
+			return &_value;
+		} else {
+			return nullptr;
+		}
+	}
+
+	bool isInitialized() const {
+		return initialized;
+	}
+
+	void initialize(Key key) {
+		_key = key;
+		initialized = true;
+	}
+
+	bool isDeleted() const {
+		return deleteFlag;
+	}
+
+	void markDeleted() {
+		deleteFlag = true;
+	}
+};
+
+/*
+ * Storage layouts for the entries of a DPH bucket. A layout provides an
+ * array type whose operator[] yields a reference that behaves like a
+ * bucket_entry&, reset(length) to empty it, find(index, key) and
+ * find_ptr(index, key) for lookups and forEachLive(f) to visit the entries
+ * that are neither empty nor deleted. purgeDeleted() empties the deleted
+ * slots. For the space statistics, it counts its deleted entries
+ * (tombstones()) and the bytes it allocated (bytes()).
+ */
+
+/// An array of bucket_entry, each with its key, value and two flags, from
+/// the given allocator
+template <template <typename> class Allocator>
+class basic_entry_vector_storage {
+public:
+	template <typename Key, typename T>
+	class array : public std::vector<bucket_entry<Key, T>, Allocator<bucket_entry<Key, T>>> {
+	public:
+		array() { }
+		explicit array(size_t length) : std::vector<bucket_entry<Key, T>, Allocator<bucket_entry<Key, T>>>(length) { }
+
+		void reset(size_t length) {
+			this->assign(length, bucket_entry<Key, T>());
+		}
+
+		maybe<T> find(size_t index, const Key &key) const {
+			return (*this)[index].find(key);
+		}
+
+		const T* find_ptr(size_t index, const Key &key) const {
+			return (*this)[index].find_ptr(key);
+		}
+
+		template <typename F>
+		void forEachLive(F f) {
+			for (size_t i = 0; i < this->size(); ++i) {
+				bucket_entry<Key, T>& entry = (*this)[i];
+				if (entry.isInitialized() && !entry.isDeleted()) {
+					f(entry);
+				}
+			}
+		}
+
+		void purgeDeleted() {
+			for (size_t i = 0; i < this->size(); ++i) {
+				if ((*this)[i].isDeleted()) {
+					(*this)[i] = bucket_entry<Key, T>();
+				}
+			}
+		}
+
+		size_t tombstones() const {
+			size_t amount = 0;
+			for (size_t i = 0; i < this->size(); ++i) {
+				amount += (*this)[i].isInitialized() && (*this)[i].isDeleted();
+			}
+			return amount;
+		}
+
+		size_t bytes() const {
+			return this->capacity() * sizeof(bucket_entry<Key, T>);
+		}
+	};
+};
+
+using entry_vector_storage = basic_entry_vector_storage<std::allocator>;
+
+/// Entry arrays of 2MB and more on huge pages
+using hugepage_storage = basic_entry_vector_storage<common::hugepage_allocator>;
+
+/// Keys and values in separate arrays, the flags in two bitmaps. Entries
+/// need no padding, and forEachLive skips 64 slots per bitmap word.
+class bitmap_storage {
+public:
+	template <typename Key, typename T>
+	class array {
+	private:
+		std::vector<Key> keys;
+		std::vector<T> values;
+		std::vector<uint64_t> initialized;
+		std::vector<uint64_t> deleted;
+
+		static bool test(const std::vector<uint64_t> &bits, size_t index) {
+			return (bits[index >> 6] >> (index & 63)) & 1;
+		}
+
+		static void set(std::vector<uint64_t> &bits, size_t index, bool value) {
+			uint64_t mask = uint64_t(1) << (index & 63);
+			if (value) {
+				bits[index >> 6] |= mask;
+			} else {
+				bits[index >> 6] &= ~mask;
+			}
+		}
+
+	public:
+		/// Stands in for a bucket_entry& to one slot
+		class reference {
+		private:
+			array* _array;
+			size_t _index;
+
+		public:
+			reference(array* entries, size_t index) : _array(entries), _index(index) { }
+
+			Key& getKey() {
+				return _array->keys[_index];
+			}
+
+			T& getValue() {
+				return _array->values[_index];
+			}
+
+			maybe<T> find(const Key &requestedKey) const {
+				return _array->find(_index, requestedKey);
+			}
+
+			bool isInitialized() const {
+				return test(_array->initialized, _index);
+			}
+
+			void initialize(Key key) {
+				_array->keys[_index] = key;
+				set(_array->initialized, _index, true);
+			}
+
+			bool isDeleted() const {
+				return test(_array->deleted, _index);
+			}
+
+			void markDeleted() {
+				set(_array->deleted, _index, true);
+			}
+
+			reference& operator=(const bucket_entry<Key, T> &entry) {
+				_array->keys[_index] = entry.getKey();
+				_array->values[_index] = entry.getValue();
+				set(_array->initialized, _index, entry.isInitialized());
+				set(_array->deleted, _index, entry.isDeleted());
+				return *this;
+			}
+
+			reference& operator=(const reference &other) {
+				return *this = bucket_entry<Key, T>(other);
+			}
+
+			operator bucket_entry<Key, T>() const {
+				bucket_entry<Key, T> entry;
+				entry.getKey() = _array->keys[_index];
+				entry.getValue() = _array->values[_index];
+				if (isInitialized()) {
+					entry.initialize(entry.getKey());
+				}
+				if (isDeleted()) {
+					entry.markDeleted();
+				}
+				return entry;
+			}
+		};
+
+		array() { }
+		explicit array(size_t length) {
+			reset(length);
+		}
+
+		size_t size() const {
+			return keys.size();
+		}
+
+		void reset(size_t length) {
+			keys.assign(length, Key());
+			values.assign(length, T());
+			initialized.assign((length + 63) / 64, 0);
+			deleted.assign((length + 63) / 64, 0);
+		}
+
+		reference operator[](size_t index) {
+			return reference(this, index);
+		}
+
+		maybe<T> find(size_t index, const Key &key) const {
+			const T* value = find_ptr(index, key);
+			if (value == nullptr) {
+				return nothing<T>();
+			} else {
+				return just<T>(*value);
+			}
+		}
+
+		const T* find_ptr(size_t index, const Key &key) const {
+			if (test(initialized, index) && !test(deleted, index) && keys[index] == key) {
+				return &values[index];
+			} else {
+				return nullptr;
+			}
+		}
+
+		template <typename F>
+		void forEachLive(F f) {
+			for (size_t word = 0; word < initialized.size(); ++word) {
+				uint64_t live = initialized[word] & ~deleted[word];
+				while (live != 0) {
+					f((*this)[word * 64 + __builtin_ctzll(live)]);
+					live &= live - 1;
+				}
+			}
+		}
+
+		void purgeDeleted() {
+			for (size_t word = 0; word < initialized.size(); ++word) {
+				initialized[word] &= ~deleted[word];
+				deleted[word] = 0;
+			}
+		}
+
+		size_t tombstones() const {
+			size_t amount = 0;
+			for (size_t word = 0; word < initialized.size(); ++word) {
+				amount += __builtin_popcountll(initialized[word] & deleted[word]);
+			}
+			return amount;
+		}
+
+		size_t bytes() const {
+			return keys.capacity() * sizeof(Key) + values.capacity() * sizeof(T)
+				+ (initialized.capacity() + deleted.capacity()) * sizeof(uint64_t);
+		}
+	};
+};
+
+/*
+ * Deletion policies of the bucketed DPH tables. An erase leaves a tombstone
+ * in the key's slot either way; the policies differ in how they count it.
+ */
+
+/// Every erase is an update, like an insert: it counts towards the global
+/// rehash after M updates and towards growing its bucket. Tombstones stay
+/// until their bucket or the table is rebuilt.
+struct counting_deletion {
+	static const bool recycles = false;
+
+	static bool needsPurge(size_t, size_t) {
+		return false;
+	}
+};
+
+/// Erases don't count as updates, so erasing and reinserting at a constant
+/// live size never rebuilds anything. An insert into a tombstone reuses it
+/// without growing the bucket, and a bucket purges its tombstones in place
+/// once there are more than 1/Fraction of its capacity M.
+template <size_t Fraction = 4>
+struct recycling_deletion {
+	static const bool recycles = true;
+
+	static bool needsPurge(size_t tombstones, size_t bucketM) {
+		return tombstones * Fraction > bucketM;
+	}
+};
+
+/*
+ * Growth triggers of the bucketed DPH tables: when a bucket is full, when a
+ * bucket or the whole table is sparse enough to shrink, and when the table
+ * is rebuilt. A bucket that is full or sparse is resized by the bucket
+ * sizing policy, or the table is rebuilt if that breaks the global
+ * condition.
+ */
+
+/// Dietzfelbinger et al.: inserts (and erases, see the deletion policies)
+/// are updates. A bucket is full after more than M updates, the table
+/// after M updates since it was last rebuilt. Nothing ever shrinks.
+struct update_trigger {
+	template <typename Bucket>
+	static bool bucketIsFull(const Bucket &bucket) {
+		return bucket.b > bucket.M;
+	}
+
+	template <typename Bucket, typename Parameters>
+	static bool bucketIsSparse(const Bucket &, const Parameters &) {
+		return false;
+	}
+
+	/// Whether a bucket holds so many entries that the table is rebuilt
+	template <typename Bucket, typename Parameters>
+	static bool bucketIsOverloaded(const Bucket &, const Parameters &) {
+		return false;
+	}
+
+	template <typename Parameters>
+	static bool tableIsFull(size_t updates, size_t, size_t M, const Parameters &) {
+		return updates >= M;
+	}
+
+	template <typename Parameters>
+	static bool tableIsSparse(size_t, size_t, const Parameters &) {
+		return false;
+	}
+};
+
+/// By the live entries instead of the updates: a bucket is full when it
+/// holds more than M entries and sparse below M / (2 * bucketCapacityFactor),
+/// a bucket of more than elementAmountPerBucket entries rebuilds the table,
+/// and so does a table of more than M or fewer than M / (2 *
+/// tableCapacityFactor) entries. Churn alone never rebuilds anything.
+struct load_trigger {
+	template <typename Bucket>
+	static bool bucketIsFull(const Bucket &bucket) {
+		return bucket.elementAmount > bucket.M;
+	}
+
+	template <typename Bucket, typename Parameters>
+	static bool bucketIsSparse(const Bucket &bucket, const Parameters &parameters) {
+		return bucket.elementAmount <= bucket.M / (parameters.bucketCapacityFactor() * 2);
+	}
+
+	template <typename Bucket, typename Parameters>
+	static bool bucketIsOverloaded(const Bucket &bucket, const Parameters &parameters) {
+		return bucket.elementAmount > parameters.elementAmountPerBucket();
+	}
+
+	template <typename Parameters>
+	static bool tableIsFull(size_t, size_t live, size_t M, const Parameters &) {
+		return live > M;
+	}
+
+	template <typename Parameters>
+	static bool tableIsSparse(size_t live, size_t M, const Parameters &parameters) {
+		return live < M / (parameters.tableCapacityFactor() * 2);
+	}
+};
+
+/*
+ * Bucket sizing policies of the bucketed DPH tables: the capacity M of a
+ * resized bucket and of a rebuilt table.
+ */
+
+/// A full bucket grows by bucketCapacityFactor and a sparse one shrinks by
+/// it, the table gets room for tableCapacityFactor more updates than it has
+/// entries
+struct multiplicative_sizing {
+	/// Whether a resized bucket counts its live entries as its updates
+	static const bool restartsUpdates = false;
+
+	template <typename Bucket, typename Parameters>
+	static size_t bucketM(const Bucket &bucket, bool grows, const Parameters &parameters) {
+		return grows ? bucket.M * parameters.bucketCapacityFactor() : bucket.M / parameters.bucketCapacityFactor();
+	}
+
+	template <typename Parameters>
+	static size_t tableM(size_t elements, const Parameters &parameters) {
+		return (1 + parameters.tableCapacityFactor()) * std::max(elements, size_t(4));
+	}
+};
+
+/// Capacities in proportion to the live entries, so buckets and the table
+/// also shrink: bucketCapacityFactor times the bucket's entries and
+/// tableCapacityFactor times the table's. A resized bucket starts counting
+/// its updates afresh from its entries.
+struct proportional_sizing {
+	static const bool restartsUpdates = true;
+
+	template <typename Bucket, typename Parameters>
+	static size_t bucketM(const Bucket &bucket, bool, const Parameters &parameters) {
+		return std::max(bucket.elementAmount, size_t(1)) * parameters.bucketCapacityFactor();
+	}
+
+	template <typename Parameters>
+	static size_t tableM(size_t elements, const Parameters &parameters) {
+		return parameters.tableCapacityFactor() * std::max(elements, size_t(4));
+	}
+};
+
+/*
+ * Retry policies of the bucketed DPH tables. When bucketMaxRehashAttempts
+ * hash functions in a row are not injective on a bucket, its length grows
+ * by bucketRehashLengthFactor. The policy decides where the next rebuild
+ * of the bucket starts.
+ */
+
+/// A bucket keeps the length it grew to until it is resized, so an unlucky
+/// draw is paid for once
+struct sticky_retries {
+	static size_t startLength(size_t length, size_t) {
+		return length;
+	}
+};
+
+/// Every rebuild starts over from the length of the bucket's capacity, so
+/// buckets don't stay long after an unlucky draw
+struct resetting_retries {
+	static size_t startLength(size_t, size_t capacityLength) {
+		return capacityLength;
+	}
+};
+
+/*
+ * Tuning factors of the bucketed DPH tables. A parameter policy provides
+ * them through the accessors below, either stored (runtime_parameters) or
+ * as template arguments (static_parameters), in which case the arithmetic
+ * on them folds into constants and buckets don't store them.
+ */
+
+/// Tuning factors chosen when the table is constructed. The defaults are the
+/// hand-picked ones of the DPH-with-buckets contender.
+class runtime_parameters {
+private:
+	size_t _bucketCapacityFactor;
+	size_t _bucketLengthFactor;
+	size_t _bucketMaxRehashAttempts;
+	size_t _bucketRehashLengthFactor;
+	size_t _tableCapacityFactor;
+	size_t _elementAmountPerBucket;
+
+public:
+	explicit runtime_parameters(size_t bucketCapacityFactor = 7, size_t bucketLengthFactor = 2,
+								size_t bucketMaxRehashAttempts = 5, size_t bucketRehashLengthFactor = 2,
+								size_t tableCapacityFactor = 6, size_t elementAmountPerBucket = 3500) :
+		_bucketCapacityFactor(bucketCapacityFactor),
+		_bucketLengthFactor(bucketLengthFactor),
+		_bucketMaxRehashAttempts(bucketMaxRehashAttempts),
+		_bucketRehashLengthFactor(bucketRehashLengthFactor),
+		_tableCapacityFactor(tableCapacityFactor),
+		_elementAmountPerBucket(elementAmountPerBucket)
+	{ }
+
+	size_t bucketCapacityFactor() const { return _bucketCapacityFactor; }
+	size_t bucketLengthFactor() const { return _bucketLengthFactor; }
+	size_t bucketMaxRehashAttempts() const { return _bucketMaxRehashAttempts; }
+	size_t bucketRehashLengthFactor() const { return _bucketRehashLengthFactor; }
+	size_t tableCapacityFactor() const { return _tableCapacityFactor; }
+	size_t elementAmountPerBucket() const { return _elementAmountPerBucket; }
+};
+
+/// Tuning factors fixed at compile time
+template <size_t BucketCapacityFactor, size_t BucketLengthFactor,
+		  size_t BucketMaxRehashAttempts, size_t BucketRehashLengthFactor,
+		  size_t TableCapacityFactor, size_t ElementAmountPerBucket>
+class static_parameters {
+	static_assert(BucketCapacityFactor >= 2 && BucketLengthFactor >= 1 && BucketMaxRehashAttempts >= 1
+				  && BucketRehashLengthFactor >= 2 && TableCapacityFactor >= 1 && ElementAmountPerBucket >= 1,
+				  "DPH tuning factors out of range");
+public:
+	static constexpr size_t bucketCapacityFactor() { return BucketCapacityFactor; }
+	static constexpr size_t bucketLengthFactor() { return BucketLengthFactor; }
+	static constexpr size_t bucketMaxRehashAttempts() { return BucketMaxRehashAttempts; }
+	static constexpr size_t bucketRehashLengthFactor() { return BucketRehashLengthFactor; }
+	static constexpr size_t tableCapacityFactor() { return TableCapacityFactor; }
+	static constexpr size_t elementAmountPerBucket() { return ElementAmountPerBucket; }
+};
+
+/// Buffers for rebuilding buckets. They are reused across rehashes, so that
+/// rebuilding a bucket allocates nothing once they have grown to the largest
+/// bucket. There is one set per thread, as a parallel rehash rebuilds several
+/// buckets at once.
+template <typename Key, typename T>
+class rehash_scratch {
+private:
+	std::vector<uint64_t> takenSlots;
+	std::vector<size_t> preHashes;
+
+public:
+	/// Keys are hashed in blocks of this many before checking them
+	static const size_t block_size = 64;
+
+	/// The entries of the bucket being rebuilt
+	std::vector<bucket_entry<Key, T>> entries;
+
+	/// The slot of each entry under the last injective hash function
+	std::vector<size_t> slots;
+
+	static rehash_scratch& local() {
+		static thread_local rehash_scratch scratch;
+		return scratch;
+	}
+
+	/// Frees all slots of a bucket of the given length for an injectivity check
+	void freeSlots(size_t length) {
+		takenSlots.assign((length + 63) / 64, 0);
+	}
+
+	/// Takes a slot, returns false if it was taken already
+	bool takeSlot(size_t index) {
+		uint64_t mask = uint64_t(1) << (index & 63);
+		uint64_t &word = takenSlots[index >> 6];
+		if ((word & mask) != 0) {
+			return false;
+		}
+		word |= mask;
+		return true;
+	}
+
+	/// Pre-hashes the keys of a bucket once, for all its hash function attempts
+	template <typename PreHashFcn>
+	void preHash(const bucket_entry<Key, T>* bucketEntries, size_t amount, const PreHashFcn &preHashFunction) {
+		preHashes.resize(amount);
+		for (size_t i = 0; i < amount; ++i) {
+			preHashes[i] = preHashFunction(bucketEntries[i].getKey());
+		}
+	}
+
+	/// Whether hashFunction maps the pre-hashed keys to distinct slots of
+	/// [0, length). The keys are hashed a block at a time and each block is
+	/// checked against the taken slots, up to the first collision. If it is
+	/// injective, slots holds the slot of every key.
+	template <typename HashFunction>
+	bool isInjective(const HashFunction &hashFunction, size_t length) {
+		freeSlots(length);
+		slots.resize(preHashes.size());
+		for (size_t begin = 0; begin < preHashes.size(); begin += block_size) {
+			size_t end = std::min(begin + block_size, preHashes.size());
+			hashFunction.hashBlock(&preHashes[begin], &slots[begin], end - begin);
+			for (size_t i = begin; i < end; ++i) {
+				if (!takeSlot(slots[i])) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+};
+
+/// The elements of a table grouped by their bucket, as the first step of a
+/// global rehash. A counting sort places each bucket's elements next to each
+/// other, in their original order, so the result is the same for any number
+/// of threads. Tables keep their partition to reuse its buffers.
+template <typename Key, typename T>
+class bucket_partition {
+private:
+	std::vector<bucket_entry<Key, T>> entries;
+	std::vector<size_t> offsets;
+	std::vector<size_t> bucketIndices;
+	std::vector<std::vector<size_t>> blockOffsets;
+
+public:
+	/// Partitions elements into bucketAmount buckets, where bucketOf(entry)
+	/// is the bucket index of an entry
+	template <typename BucketOf>
+	void build(std::vector<bucket_entry<Key, T>>& elements, size_t bucketAmount, BucketOf bucketOf, size_t threads) {
+		size_t n = elements.size();
+		size_t blocks = std::max(size_t(1), std::min(threads, n));
+		bucketIndices.resize(n);
+		blockOffsets.resize(blocks);
+		for (size_t block = 0; block < blocks; ++block) {
+			blockOffsets[block].assign(bucketAmount, 0);
+		}
+
+		// Counting the elements of every bucket per block
+		common::parallel_blocks(blocks, n, [&](size_t block, size_t begin, size_t end) {
+			std::vector<size_t>& counts = blockOffsets[block];
+			for (size_t i = begin; i < end; ++i) {
+				bucketIndices[i] = bucketOf(elements[i]);
+				++counts[bucketIndices[i]];
+			}
+		});
+
+		// Turning the counts into the first position of every block in every bucket
+		offsets.assign(bucketAmount + 1, 0);
+		size_t offset = 0;
+		for (size_t bucket = 0; bucket < bucketAmount; ++bucket) {
+			offsets[bucket] = offset;
+			for (size_t block = 0; block < blocks; ++block) {
+				size_t count = blockOffsets[block][bucket];
+				blockOffsets[block][bucket] = offset;
+				offset += count;
+			}
+		}
+		offsets[bucketAmount] = offset;
+
+		// Scattering the elements
+		entries.resize(n);
+		common::parallel_blocks(blocks, n, [&](size_t block, size_t begin, size_t end) {
+			std::vector<size_t>& positions = blockOffsets[block];
+			for (size_t i = begin; i < end; ++i) {
+				entries[positions[bucketIndices[i]]++] = elements[i];
+			}
+		});
+	}
+
+	/// Merges elements with equal keys into the position of the first one,
+	/// with the value of the last one. Equal keys share a bucket, so every
+	/// bucket is merged on its own through a small linear probing index on
+	/// keyHash(key).
+	template <typename KeyHash>
+	void removeDuplicates(KeyHash keyHash) {
+		const size_t empty = std::numeric_limits<size_t>::max();
+		size_t kept = 0;
+		for (size_t bucket = 0; bucket + 1 < offsets.size(); ++bucket) {
+			size_t begin = offsets[bucket];
+			size_t end = offsets[bucket + 1];
+			offsets[bucket] = kept;
+			size_t bits = 1;
+			while ((size_t(1) << bits) < 2 * (end - begin)) {
+				++bits;
+			}
+			size_t mask = (size_t(1) << bits) - 1;
+			bucketIndices.assign(mask + 1, empty);
+
+			for (size_t i = begin; i < end; ++i) {
+				const Key& key = entries[i].getKey();
+				size_t slot = (uint64_t(keyHash(key)) * 0x9E3779B97F4A7C15ULL) >> (64 - bits);
+				while (bucketIndices[slot] != empty && !(entries[bucketIndices[slot]].getKey() == key)) {
+					slot = (slot + 1) & mask;
+				}
+				if (bucketIndices[slot] == empty) {
+					bucketIndices[slot] = kept;
+					entries[kept++] = entries[i];
+				} else {
+					entries[bucketIndices[slot]].getValue() = entries[i].getValue();
+				}
+			}
+		}
+		offsets.back() = kept;
+		entries.resize(kept);
+	}
+
+	size_t size() const {
+		return entries.size();
+	}
+
+	/// Replaces elements with the partitioned elements, bucket by bucket
+	void copyTo(std::vector<bucket_entry<Key, T>>& elements) const {
+		elements.assign(entries.begin(), entries.end());
+	}
+
+	/// The elements of one bucket
+	const bucket_entry<Key, T>* bucketEntries(size_t bucket) const {
+		return entries.data() + offsets[bucket];
+	}
+
+	size_t bucketSize(size_t bucket) const {
+		return offsets[bucket + 1] - offsets[bucket];
+	}
+};
+
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "../common/contenders.h"
+#include "hashtable.h"
+#include "DPH_with_buckets.h"
+
+namespace hashtable {
+
+/// The six tuning knobs of DPH_with_buckets, in constructor order
+struct DPH_parameters {
+	size_t bucketCapacityFactor;
+	size_t bucketLengthFactor;
+	size_t bucketMaxRehashAttempts;
+	size_t bucketRehashLengthFactor;
+	size_t tableCapacityFactor;
+	size_t elementAmountPerBucket;
+
+	/// The hand-picked values of the default contender
+	static DPH_parameters defaults() {
+		return DPH_parameters{7, 2, 5, 2, 6, 3500};
+	}
+
+	template <typename Key, typename T>
+	DPH_with_buckets<Key, T>* create(size_t initialElementAmount = 1000) const {
+		return new DPH_with_buckets<Key, T>(initialElementAmount,
+											bucketCapacityFactor, bucketLengthFactor, bucketMaxRehashAttempts, bucketRehashLengthFactor,
+											tableCapacityFactor, elementAmountPerBucket);
+	}
+
+	/// The values joined by dashes, e.g. 7-2-5-2-6-3500
+	std::string key() const {
+		std::ostringstream s;
+		s << bucketCapacityFactor << "-" << bucketLengthFactor << "-" << bucketMaxRehashAttempts << "-"
+		  << bucketRehashLengthFactor << "-" << tableCapacityFactor << "-" << elementAmountPerBucket;
+		return s.str();
+	}
+
+	bool operator<(const DPH_parameters &other) const {
+		return tie() < other.tie();
+	}
+
+	bool operator==(const DPH_parameters &other) const {
+		return tie() == other.tie();
+	}
+
+	/// Written as the six values separated by spaces, one set per line
+	friend std::ostream& operator<<(std::ostream &os, const DPH_parameters &p) {
+		return os << p.bucketCapacityFactor << " " << p.bucketLengthFactor << " " << p.bucketMaxRehashAttempts << " "
+				  << p.bucketRehashLengthFactor << " " << p.tableCapacityFactor << " " << p.elementAmountPerBucket;
+	}
+
+	friend std::istream& operator>>(std::istream &is, DPH_parameters &p) {
+		return is >> p.bucketCapacityFactor >> p.bucketLengthFactor >> p.bucketMaxRehashAttempts
+				  >> p.bucketRehashLengthFactor >> p.tableCapacityFactor >> p.elementAmountPerBucket;
+	}
+
+private:
+	std::tuple<size_t, size_t, size_t, size_t, size_t, size_t> tie() const {
+		return std::make_tuple(bucketCapacityFactor, bucketLengthFactor, bucketMaxRehashAttempts,
+							   bucketRehashLengthFactor, tableCapacityFactor, elementAmountPerBucket);
+	}
+};
+
+/// A measured parameter set: the summed benchmark time in ms and the
+/// largest peak memory in bytes
+struct DPH_tuning_point {
+	DPH_parameters parameters;
+	double time;
+	size_t peak;
+};
+
+/// The coarse grid the search starts from. Rehash attempts and the rehash
+/// length factor matter least, so only the refinement varies them.
+inline std::vector<DPH_parameters> DPH_tuning_grid() {
+	std::vector<DPH_parameters> grid;
+	for (size_t bucketCapacityFactor : {3, 7, 11}) {
+		for (size_t bucketLengthFactor : {1, 2, 4}) {
+			for (size_t tableCapacityFactor : {2, 6, 10}) {
+				for (size_t elementAmountPerBucket : {1000, 3500, 10000}) {
+					grid.push_back(DPH_parameters{bucketCapacityFactor, bucketLengthFactor, 5, 2,
+												  tableCapacityFactor, elementAmountPerBucket});
+				}
+			}
+		}
+	}
+	return grid;
+}
+
+/// The parameter sets that differ from p in one knob by one step, for the
+/// local refinement. Steps keep every knob in its valid range.
+inline std::vector<DPH_parameters> DPH_tuning_neighbours(const DPH_parameters &p) {
+	std::vector<DPH_parameters> neighbours;
+	auto vary = [&](size_t DPH_parameters::*knob, size_t minimum, size_t down, size_t up) {
+		DPH_parameters lower = p;
+		lower.*knob = down;
+		if (down >= minimum && down != p.*knob) {
+			neighbours.push_back(lower);
+		}
+		DPH_parameters higher = p;
+		higher.*knob = up;
+		neighbours.push_back(higher);
+	};
+	vary(&DPH_parameters::bucketCapacityFactor, 2, p.bucketCapacityFactor - 1, p.bucketCapacityFactor + 1);
+	vary(&DPH_parameters::bucketLengthFactor, 1, p.bucketLengthFactor - 1, p.bucketLengthFactor + 1);
+	vary(&DPH_parameters::bucketMaxRehashAttempts, 1, p.bucketMaxRehashAttempts - 1, p.bucketMaxRehashAttempts + 1);
+	vary(&DPH_parameters::bucketRehashLengthFactor, 2, p.bucketRehashLengthFactor - 1, p.bucketRehashLengthFactor + 1);
+	vary(&DPH_parameters::tableCapacityFactor, 1, p.tableCapacityFactor - 1, p.tableCapacityFactor + 1);
+	vary(&DPH_parameters::elementAmountPerBucket, 100,
+		 p.elementAmountPerBucket * 2 / 3, p.elementAmountPerBucket * 3 / 2);
+	return neighbours;
+}
+
+/// The points that no other point beats in both time and peak memory,
+/// ordered by time
+inline std::vector<DPH_tuning_point> DPH_pareto_front(std::vector<DPH_tuning_point> points) {
+	std::sort(points.begin(), points.end(), [](const DPH_tuning_point &a, const DPH_tuning_point &b) {
+		return a.time < b.time || (a.time == b.time && a.peak < b.peak);
+	});
+	std::vector<DPH_tuning_point> front;
+	for (const DPH_tuning_point &point : points) {
+		if (front.empty() || point.peak < front.back().peak) {
+			front.push_back(point);
+		}
+	}
+	return front;
+}
+
+/// Reads parameter sets as written by tune_hash, one per line
+inline std::vector<DPH_parameters> DPH_read_parameters(const std::string &filename) {
+	std::vector<DPH_parameters> parameters;
+	std::ifstream ifs(filename);
+	if (!ifs.good() || !ifs.is_open()) {
+		std::cerr << "Can't open file: " << filename << std::endl;
+		return parameters;
+	}
+	DPH_parameters p;
+	while (ifs >> p) {
+		parameters.push_back(p);
+	}
+	return parameters;
+}
+
+/// Registers a DPH_with_buckets contender for each parameter set
+template <typename Key, typename T>
+void register_tuned_contenders(common::contender_list<hashtable<Key, T>> &list,
+							   const std::vector<DPH_parameters> &parameters) {
+	using Factory = common::contender_factory<hashtable<Key, T>>;
+	for (const DPH_parameters &p : parameters) {
+		list.register_contender(Factory("DPH-with-buckets (tuned " + p.key() + ")", "DPH-with-buckets-tuned-" + p.key(),
+			[p](){
+				return p.create<Key, T>();
+			}
+		));
+	}
+}
+
+}
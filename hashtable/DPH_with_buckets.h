@@ -1,7 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <thread>
 
 #include "../common/contenders.h"
 #include "hashtable.h"
@@ -12,191 +16,249 @@ using namespace common::monad;
 namespace hashtable {
 
 template <typename Key, typename T,
-		  typename PreHashFcn = std::hash<Key>>
+		  typename PreHashFcn = std::hash<Key>,
+		  typename HashFamily = prime_modulo_family<>,
+		  typename Storage = entry_vector_storage,
+		  typename Parameters = runtime_parameters,
+		  typename Retry = sticky_retries>
 class bucket {
+public:
+	using Entries = typename Storage::template array<Key, T>;
+	using EntryRef = typename Entries::reference;
+
 private:
-	size_t _capacityFactor;
-	size_t _lengthFactor;
-	size_t _maxRehashAttempts;
-	size_t _rehashLengthFactor;
+	Parameters _parameters;
 
 public:
 	size_t M;
 	size_t b;
 	size_t length;
 	size_t elementAmount;
+	size_t tombstones; // only counted by recycling_deletion
 
 private:
-	prime_generator primes;
 	random_generator randoms;
 
 	PreHashFcn preHashFunction;
-	entry_hash_function hashFunction;
-	std::vector<bucket_entry<Key, T>> entries;
+	typename HashFamily::function hashFunction;
+	Entries entries;
 
 public:
 	bucket() : bucket(0) { }
 
-	bucket(std::vector<bucket_entry<Key, T>> initialEntries,
-		   size_t capacityFactor, size_t lengthFactor, size_t maxRehashAttempts, size_t rehashLengthFactor) :
-	bucket(initialEntries.size(),
-		   capacityFactor, lengthFactor, maxRehashAttempts, rehashLengthFactor)
+	bucket(const bucket_entry<Key, T>* initialEntries, size_t amount,
+		   const Parameters &parameters,
+		   size_t seed = random_generator::default_seed) :
+	bucket(amount, parameters, seed)
 	{
-		elementAmount = initialEntries.size();
-		insertAll(initialEntries);
+		elementAmount = amount;
+		insertAll(initialEntries, amount);
 	}
 
-	bucket(size_t initialSize) : bucket(initialSize,
-										2, 5, 10, 2) { }
-
 	bucket(size_t initialSize,
-		   size_t capacityFactor, size_t lengthFactor, size_t maxRehashAttempts, size_t rehashLengthFactor) :
-		_capacityFactor(capacityFactor),
-		_lengthFactor(lengthFactor),
-		_maxRehashAttempts(maxRehashAttempts),
-		_rehashLengthFactor(rehashLengthFactor),
+		   const Parameters &parameters = Parameters(),
+		   size_t seed = random_generator::default_seed) :
+		_parameters(parameters),
 
 		M(std::max(size_t(10), initialSize)),
 		b(0),
 		length(calculateBucketLength(M)),
 		elementAmount(0),
+		tombstones(0),
+		randoms(seed),
 		entries(length)
 	{
-		size_t random = randoms(1, length - 1);
-		size_t random2 = randoms(1, length - 1);
-		hashFunction.setParameters(random, random2, length);
+		hashFunction.randomize(randoms, length);
 	}
 
-	bucket_entry<Key, T>& operator[](size_t preHash) {
+	EntryRef operator[](size_t preHash) {
 		size_t index = hashFunction(preHash);
 		return entries[index];
 	}
 
     virtual ~bucket() = default;
 
-    std::vector<bucket_entry<Key, T>>& getEntries() {
+    Entries& getEntries() {
     	return entries;
     }
 
     maybe<T> find(size_t preHash, const Key &key) const {
     	size_t index = hashFunction(preHash);
-		return entries[index].find(key);
+		return entries.find(index, key);
+    }
+
+    const T* find_ptr(size_t preHash, const Key &key) const {
+    	size_t index = hashFunction(preHash);
+		return entries.find_ptr(index, key);
     }
 
     size_t size() const {
     	return elementAmount;
     }
 
-	void resizeAndRehash(const Key& key) {
-		M *= _capacityFactor;
+	void inspect(common::structure_stats &stats) const {
+		stats.add_bucket(length, elementAmount, entries.tombstones());
+		stats.bytes += entries.bytes();
+	}
+
+	/// Empties the slots of the counted tombstones. They no longer occupy
+	/// the bucket, so b doesn't count them any more.
+	void purge() {
+		entries.purgeDeleted();
+		forgetTombstones();
+	}
+
+	/// Reseeds the bucket's generator and redraws its hash function
+	void seed(size_t seed) {
+		randoms.seed(seed);
+		rebuild();
+	}
+
+	/// Resizes the bucket to hold bucketM elements
+	void reserve(size_t bucketM) {
+		common::rehash_trace::bucket_resize();
+		M = bucketM;
+		length = calculateBucketLength(M);
+		rebuild();
+	}
+
+	/// Resizes the bucket to hold bucketM elements and adds key
+	void resizeAndRehash(const Key& key, size_t bucketM) {
+		common::rehash_trace::bucket_resize();
+		M = bucketM;
 		length = calculateBucketLength(M);
 		rehash(key);
 	}
 
 	void rehash(const Key& key) {
+		common::rehash_trace::scope trace;
+		common::rehash_trace::bucket_rehash();
+
 		// Collecting entries of the bucket
-		std::vector<bucket_entry<Key, T>> bucketEntries(elementAmount + 1);
-		size_t j = 0;
+		std::vector<bucket_entry<Key, T>>& bucketEntries = rehash_scratch<Key, T>::local().entries;
+		bucketEntries.clear();
 		bool includesNewKey = false;
-		for (size_t i = 0; i < entries.size(); ++i) {
-			bucket_entry<Key, T>& entry = entries[i];
-			if (entry.isInitialized() && !entry.isDeleted()) {
-				if (entry.getKey() == key) {
-					includesNewKey = true;
-				}
-				bucketEntries[j] = entry;
-				++j;
+		entries.forEachLive([&](EntryRef entry) {
+			if (entry.getKey() == key) {
+				includesNewKey = true;
 			}
-			entries[i] = bucket_entry<Key, T>();
-		}
+			bucketEntries.push_back(entry);
+		});
 		if (!includesNewKey) {
-			bucketEntries[j].initialize(key);
+			bucket_entry<Key, T> newEntry;
+			newEntry.initialize(key);
+			bucketEntries.push_back(newEntry);
 			++elementAmount;
 			++b;
-		} else {
-			bucketEntries.pop_back();
 		}
 
-		entries.clear();
-		entries.resize(length);
-		insertAll(bucketEntries);
+		length = Retry::startLength(length, calculateBucketLength(M));
+		entries.reset(length);
+		forgetTombstones();
+		insertAll(bucketEntries.data(), bucketEntries.size());
 	}
 
 	size_t calculateBucketLength(size_t bucketM) {
-		size_t minLength = _lengthFactor * bucketM;
-		return primes(minLength);
+		size_t minLength = _parameters.bucketLengthFactor() * bucketM;
+		return HashFamily::length(minLength);
 	}
 
 private:
-	void insertAll(std::vector<bucket_entry<Key, T>> bucketEntries) {
+	void forgetTombstones() {
+		b -= std::min(b, tombstones);
+		tombstones = 0;
+	}
+
+	/// Reinserts the live entries with a fresh hash function
+	void rebuild() {
+		std::vector<bucket_entry<Key, T>>& bucketEntries = rehash_scratch<Key, T>::local().entries;
+		bucketEntries.clear();
+		entries.forEachLive([&](EntryRef entry) {
+			bucketEntries.push_back(entry);
+		});
+		length = Retry::startLength(length, calculateBucketLength(M));
+		entries.reset(length);
+		forgetTombstones();
+		insertAll(bucketEntries.data(), bucketEntries.size());
+	}
+
+	void insertAll(const bucket_entry<Key, T>* bucketEntries, size_t amount) {
+		rehash_scratch<Key, T>& scratch = rehash_scratch<Key, T>::local();
+		scratch.preHash(bucketEntries, amount, preHashFunction);
 		// Choose a new injective hash function randomly
 		size_t rehashAttempts = 0;
 		bool isInjective;
 		do {
 			++rehashAttempts;
 
-			isInjective = true;
-			size_t random = randoms(1, length - 1);
-			size_t random2 = randoms(1, length - 1);
-			hashFunction.setParameters(random, random2, length);
-
-			std::vector<size_t> indices = std::vector<size_t>(length);
-			for(size_t i = 0; i < bucketEntries.size(); ++i) {
-				bucket_entry<Key, T>& entry = bucketEntries[i];
-				if (entry.isInitialized()) {
-					size_t preHash = preHashFunction(entry.getKey());
-					size_t index = hashFunction(preHash);
-					if (indices[index] != 0) {
-						isInjective = false;
-						break;
-					} else {
-						indices[index] = 1;
-					}
-				}
+			hashFunction.randomize(randoms, length);
+			isInjective = scratch.isInjective(hashFunction, length);
+			if (!isInjective) {
+				common::rehash_trace::retry();
 			}
 
-			if (rehashAttempts > _maxRehashAttempts) {
-				length *= _rehashLengthFactor;
-				entries.clear();
-				entries.resize(length);
+			if (rehashAttempts > _parameters.bucketMaxRehashAttempts()) {
+				length = HashFamily::length(length * _parameters.bucketRehashLengthFactor());
+				entries.reset(length);
 				rehashAttempts = 0;
 			}
 		} while (!isInjective);
 
 		// Inserting the entries in the table
-		for(size_t i = 0; i < bucketEntries.size(); ++i) {
-			bucket_entry<Key, T>& entry = bucketEntries[i];
-			size_t preHash = preHashFunction(entry.getKey());
-			size_t index = hashFunction(preHash);
-			entries[index] = entry;
+		for(size_t i = 0; i < amount; ++i) {
+			entries[scratch.slots[i]] = bucketEntries[i];
 		}
 
 	}
 };
 
+/// Dynamic perfect hashing with buckets. The rehash strategy is made of
+/// three policies from DPH_Common.h: the growth trigger, the bucket sizing
+/// and the retries. The defaults are the update counting of Dietzfelbinger
+/// et al.; DPH_with_buckets_2 rehashes by load instead.
 template <typename Key, typename T,
-		  typename PreHashFcn = std::hash<Key>>
+		  typename PreHashFcn = std::hash<Key>,
+		  typename HashFamily = prime_modulo_family<>,
+		  typename Storage = entry_vector_storage,
+		  typename Parameters = runtime_parameters,
+		  typename Deletion = counting_deletion,
+		  typename Trigger = update_trigger,
+		  typename Sizing = multiplicative_sizing,
+		  typename Retry = sticky_retries>
 class DPH_with_buckets : public hashtable<Key, T> { // DPH = Dynamic Perfect Hashing
 private:
-	size_t capacityFactor;
-	size_t _elementAmountPerBucket;
+	using Bucket = bucket<Key, T, PreHashFcn, HashFamily, Storage, Parameters, Retry>;
+	using EntryRef = typename Bucket::EntryRef;
 
-	size_t _bucketCapacityFactor;
-	size_t _bucketLengthFactor;
-	size_t _bucketMaxRehashAttempts;
-	size_t _bucketRehashLengthFactor;
+	Parameters _parameters;
+	size_t _migrationRate;
+	size_t _rehashThreads;
 
 	size_t M;
 	size_t count;
+	size_t live;
 	
 	size_t bucketAmount;
 
-	prime_generator primes;
 	random_generator randoms;
 	
 	PreHashFcn preHashFunction;
-	bucket_hash_function bucketHashFunction;
-	std::vector<bucket<Key, T>> buckets;
+	typename HashFamily::function bucketHashFunction;
+	std::vector<Bucket> buckets;
+
+	// Buffers of rehashAll, kept so that later rehashes reuse their memory
+	std::vector<bucket_entry<Key, T>> rehashEntries;
+	bucket_partition<Key, T> partition;
+	std::vector<size_t> seeds;
+
+	// Incremental rehashing keeps the previous generation of buckets and
+	// migrates _migrationRate of its slots per operation. Every key lives in
+	// exactly one generation, new keys always go to the current one.
+	typename HashFamily::function oldBucketHashFunction;
+	std::vector<Bucket> oldBuckets;
+	size_t migrationBucket;
+	size_t migrationSlot;
+	size_t migrationBucketM;
 	
 public:
     virtual ~DPH_with_buckets() = default;
@@ -208,77 +270,207 @@ public:
             [](){
 				return new DPH_with_buckets(1000);
 			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (incremental rehash)", "DPH-with-buckets-incremental",
+            [](){
+				return new DPH_with_buckets(1000,
+											7, 2, 5, 2,
+											6, 3500, 16);
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (parallel rehash)", "DPH-with-buckets-parallel",
+            [](){
+				return new DPH_with_buckets(1000,
+											7, 2, 5, 2,
+											6, 3500, 0,
+											std::max(1u, std::thread::hardware_concurrency()));
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (recycling tombstones)", "DPH-with-buckets-recycle",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, prime_modulo_family<>, entry_vector_storage,
+											runtime_parameters, recycling_deletion<>>(1000);
+			}
+        ));
+        // The rehash strategies: the growth trigger by updates or by live
+        // entries, combined with either bucket sizing, and the retries that
+        // restart from the capacity's length
+        list.register_contender(Factory("DPH-with-buckets (load trigger)", "DPH-with-buckets-load",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, prime_modulo_family<>, entry_vector_storage,
+											runtime_parameters, counting_deletion, load_trigger>(1000);
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (proportional sizing)", "DPH-with-buckets-proportional",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, prime_modulo_family<>, entry_vector_storage,
+											runtime_parameters, counting_deletion, update_trigger, proportional_sizing>(1000);
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (load trigger, proportional sizing)", "DPH-with-buckets-load-proportional",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, prime_modulo_family<>, entry_vector_storage,
+											runtime_parameters, counting_deletion, load_trigger, proportional_sizing>(1000);
+			}
+        ));
+        // The fastest trigger with the most compact sizing, and the factors
+        // of DPH-with-buckets-2
+        list.register_contender(Factory("DPH-with-buckets (update trigger, proportional sizing 2-2-5-2-2-3000)", "DPH-with-buckets-update-proportional",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, prime_modulo_family<>, entry_vector_storage,
+											runtime_parameters, counting_deletion, update_trigger, proportional_sizing>(1000,
+											runtime_parameters(2, 2, 5, 2, 2, 3000));
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (resetting retries)", "DPH-with-buckets-resetting",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, prime_modulo_family<>, entry_vector_storage,
+											runtime_parameters, counting_deletion, update_trigger, multiplicative_sizing,
+											resetting_retries>(1000);
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (bitmap storage)", "DPH-with-buckets-bitmap",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, prime_modulo_family<>, bitmap_storage>(1000);
+			}
+        ));
+        // Buckets smaller than a huge page still come from operator new, so
+        // only the largest buckets are backed by huge pages
+        list.register_contender(Factory("DPH-with-buckets (huge pages)", "DPH-with-buckets-hugepages",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, prime_modulo_family<>, hugepage_storage>(1000);
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (hardware modulo)", "DPH-with-buckets-hwmod",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, prime_modulo_family<hardware_modulo>>(1000);
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (multiply-shift)", "DPH-with-buckets-multshift",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, multiply_shift_family>(1000);
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (tabulation)", "DPH-with-buckets-tabulation",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, tabulation_family>(1000);
+			}
+        ));
+        // The tuning factors as template arguments: the defaults, the defaults
+        // with power of two bucket lengths, and a memory-lean set found by
+        // tune_hash
+        list.register_contender(Factory("DPH-with-buckets (compile-time parameters)", "DPH-with-buckets-static",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, prime_modulo_family<>, entry_vector_storage,
+											static_parameters<7, 2, 5, 2, 6, 3500>>(1000);
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (compile-time parameters, multiply-shift)", "DPH-with-buckets-static-multshift",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, multiply_shift_family, entry_vector_storage,
+											static_parameters<7, 2, 5, 2, 6, 3500>>(1000);
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets (compile-time parameters 3-1-4-2-2-15000)", "DPH-with-buckets-static-3-1-4-2-2-15000",
+            [](){
+				return new DPH_with_buckets<Key, T, PreHashFcn, prime_modulo_family<>, entry_vector_storage,
+											static_parameters<3, 1, 4, 2, 2, 15000>>(1000);
+			}
         ));
     }
 	
-    DPH_with_buckets(size_t initialElementAmount) : DPH_with_buckets(initialElementAmount,
-    																 7, 2, 5, 2,
-																	 6, 3500) { }
-
+    /// A migrationRate of 0 rehashes the whole table at once, otherwise
+    /// that many slots are migrated to a new generation per operation.
+    /// A global rehash builds the buckets on rehashThreads threads.
     DPH_with_buckets(size_t initialElementAmount,
-    				 size_t bucketCapacityFactor, size_t bucketLengthFactor, size_t bucketMaxRehashAttempts, size_t bucketRehashLengthFactor,
-					 size_t tableCapacityFactor, size_t elementAmountPerBucket) :
+					 const Parameters &parameters = Parameters(),
+					 size_t migrationRate = 0, size_t rehashThreads = 1) :
     	hashtable<Key, T>(),
-		capacityFactor(tableCapacityFactor),
-		_elementAmountPerBucket(elementAmountPerBucket),
-
-		_bucketCapacityFactor(bucketCapacityFactor),
-		_bucketLengthFactor(bucketLengthFactor),
-		_bucketMaxRehashAttempts(bucketMaxRehashAttempts),
-		_bucketRehashLengthFactor(bucketRehashLengthFactor),
+		_parameters(parameters),
+		_migrationRate(migrationRate),
+		_rehashThreads(rehashThreads),
 
 		M(calculateM(initialElementAmount)),
 		count(0),
+		live(0),
 		bucketAmount(calculateBucketAmount(initialElementAmount)),
-		primes(),
 		randoms(),
-    	buckets(bucketAmount, bucket<Key, T>(_elementAmountPerBucket,
-    										 _bucketCapacityFactor, _bucketLengthFactor, _bucketMaxRehashAttempts, _bucketRehashLengthFactor))
+		migrationBucket(0),
+		migrationSlot(0),
+		migrationBucketM(0)
 	{
-		size_t prime = primes(bucketAmount);
-		size_t random = randoms(1, prime - 1);
-		size_t random2 = randoms(1, prime - 1);
-		bucketHashFunction.setParameters(random, random2, prime, bucketAmount);
+		bucketHashFunction.randomize(randoms, bucketAmount);
+		createBuckets(_parameters.elementAmountPerBucket());
     }
+
+    /// The tuning factors one by one, for runtime_parameters
+    DPH_with_buckets(size_t initialElementAmount,
+    				 size_t bucketCapacityFactor, size_t bucketLengthFactor, size_t bucketMaxRehashAttempts, size_t bucketRehashLengthFactor,
+					 size_t tableCapacityFactor, size_t elementAmountPerBucket,
+					 size_t migrationRate = 0, size_t rehashThreads = 1) :
+		DPH_with_buckets(initialElementAmount,
+						 Parameters(bucketCapacityFactor, bucketLengthFactor, bucketMaxRehashAttempts, bucketRehashLengthFactor,
+									tableCapacityFactor, elementAmountPerBucket),
+						 migrationRate, rehashThreads) { }
 		
+    /// Builds the table from a range of key/value pairs in one pass
+    template <typename InputIt>
+    DPH_with_buckets(InputIt first, InputIt last) : DPH_with_buckets(0) {
+		insertRange(first, last);
+    }
+
     T& operator[](const Key &key) override {
 		size_t preHash = preHashFunction(key);
+		if (isMigrating()) {
+			Bucket* oldBucket = migrationStep(preHash, key);
+			if (oldBucket != nullptr) {
+				return (*oldBucket)[preHash].getValue();
+			}
+		}
 		size_t bucketIndex = bucketHashFunction(preHash);
-		bucket<Key, T>& _bucket = buckets[bucketIndex];
-		bucket_entry<Key, T>& entry = _bucket[preHash];
+		Bucket& _bucket = buckets[bucketIndex];
+		EntryRef entry = _bucket[preHash];
+		live += !entry.isInitialized() || entry.isDeleted() || entry.getKey() != key;
 		if (!entry.isInitialized()) {
 			entry.initialize(key);
-			++count;
-			++_bucket.b;
-			++_bucket.elementAmount;
+			countInsert(_bucket, false);
 		} else if (entry.isDeleted()) {
 			entry = bucket_entry<Key, T>();
 			entry.initialize(key);
+			countInsert(_bucket, true);
+		} else if (entry.getKey() != key) {
+			// The colliding key is added by one of the rehashes below
 			++count;
-			++_bucket.b;
-			++_bucket.elementAmount;
 		}
 		bool wasRehashed = false;
-		if (count >= M) {
+		if (Trigger::tableIsFull(count, live, M, _parameters) || Trigger::bucketIsOverloaded(_bucket, _parameters)) {
 			rehashAll(key);
 			wasRehashed = true;
-		} else if (_bucket.b <= _bucket.M and entry.getKey() != key) {
+		} else if (!Trigger::bucketIsFull(_bucket) and entry.getKey() != key) {
 			_bucket.rehash(key);
 			wasRehashed= true;
-		} else if (_bucket.b > _bucket.M) {
-			size_t newBucketM = _bucket.M * _bucketCapacityFactor;
+		} else if (Trigger::bucketIsFull(_bucket) && isMigrating()) {
+			// Migrated entries count as updates too, so grow like migrateEntry
+			_bucket.reserve(migrationGrowth(_bucket));
+			if (_bucket[preHash].getKey() != key) {
+				_bucket.rehash(key);
+			}
+			wasRehashed = true;
+		} else if (Trigger::bucketIsFull(_bucket) || Trigger::bucketIsSparse(_bucket, _parameters)) {
+			size_t newBucketM = Sizing::bucketM(_bucket, Trigger::bucketIsFull(_bucket), _parameters);
 			size_t newBucketLength = _bucket.calculateBucketLength(newBucketM);
 			if (globalConditionIsSatisfied(newBucketLength, bucketIndex)) {
-				_bucket.resizeAndRehash(key);
+				_bucket.resizeAndRehash(key, newBucketM);
+				if (Sizing::restartsUpdates) {
+					_bucket.b = _bucket.elementAmount;
+				}
 			} else {
-				rehashAll();
+				rehashAll(key);
 			}
 			wasRehashed = true;
 		}
 		if (wasRehashed) {
-			bucketIndex = bucketHashFunction(preHash);
-			bucket<Key, T>& rehashedBucket = buckets[bucketIndex];
-			bucket_entry<Key, T>& newEntry = rehashedBucket[preHash];
+			EntryRef newEntry = currentBucket(preHash, key)[preHash];
 			// If this is not the case something with the dynamic rehashing didn't work out
 			assert(newEntry.getKey() == key);
 			return newEntry.getValue();
@@ -294,55 +486,287 @@ public:
     }
 
     maybe<T> find(const Key &key) const override {
+		const T* value = find_ptr(key);
+		if (value == nullptr) {
+			return nothing<T>();
+		}
+		return just<T>(*value);
+    }
+
+    const T* find_ptr(const Key &key) const override {
 		size_t preHash = preHashFunction(key);
+		if (isMigrating()) {
+			size_t oldIndex = oldBucketHashFunction(preHash);
+			if (oldIndex >= migrationBucket) {
+				const T* value = oldBuckets[oldIndex].find_ptr(preHash, key);
+				if (value != nullptr) {
+					return value;
+				}
+			}
+		}
 		size_t bucketIndex = bucketHashFunction(preHash);
-		return buckets[bucketIndex].find(preHash, key);
+		return buckets[bucketIndex].find_ptr(preHash, key);
     }
 
     size_t erase(const Key &key) override {
 		size_t preHash = preHashFunction(std::move(key));
+		if (isMigrating()) {
+			Bucket* oldBucket = migrationStep(preHash, key);
+			if (oldBucket != nullptr) {
+				(*oldBucket)[preHash].markDeleted();
+				--oldBucket->elementAmount;
+				--live;
+				countErase();
+				return 1;
+			}
+		}
 		size_t bucketIndex = bucketHashFunction(preHash);
-		bucket<Key, T>& bucket = buckets[bucketIndex];
-		bucket_entry<Key, T>& entry = bucket[preHash];
+		Bucket& bucket = buckets[bucketIndex];
+		EntryRef entry = bucket[preHash];
 
-		if (entry.isInitialized() and !entry.isDeleted()) {
-			// If this is not the case something with the dynamic rehashing didn't work out
-			assert(entry.getKey() == key);
+		if (entry.isInitialized() and !entry.isDeleted() and entry.getKey() == key) {
 			entry.markDeleted();
-			++count;
-			++bucket.b;
 			--bucket.elementAmount;
+			--live;
+			countErase();
+			if (Deletion::recycles) {
+				++bucket.tombstones;
+				if (Deletion::needsPurge(bucket.tombstones, bucket.M)) {
+					bucket.purge();
+				}
+			} else {
+				++bucket.b;
+			}
 			return 1;
 		}
-		if (count >= M) {
+		if (Trigger::tableIsFull(count, live, M, _parameters) || Trigger::tableIsSparse(live, M, _parameters)) {
 			rehashAll();
 		}
 		return 0;
     }
 
     size_t size() const override {
-    	size_t _size = 0;
-    	for (size_t i = 0; i < buckets.size(); ++i) {
-    		_size += buckets[i].size();
-    	}
-		return _size;
+		return live;
+	}
+
+    void inspect(common::structure_stats &stats) const override {
+		for (size_t i = 0; i < buckets.size(); ++i) {
+			buckets[i].inspect(stats);
+		}
+		for (size_t i = 0; i < oldBuckets.size(); ++i) {
+			oldBuckets[i].inspect(stats);
+		}
+		stats.bytes += sizeof(*this) + (buckets.capacity() + oldBuckets.capacity()) * sizeof(Bucket);
 	}
 
     void clear() override {
 		M = calculateM(0);
 		count = 0;
+		live = 0;
 		bucketAmount = calculateBucketAmount(0);
-		buckets.clear();
-    	buckets.resize(bucketAmount, bucket<Key, T>(0, _bucketCapacityFactor, _bucketLengthFactor, _bucketMaxRehashAttempts, _bucketRehashLengthFactor));
+		oldBuckets.clear();
+		bucketHashFunction.randomize(randoms, bucketAmount);
+		createBuckets(_parameters.elementAmountPerBucket());
+	}
+
+    void seed(size_t seed) override {
+		randoms.seed(seed);
+		if (size() == 0) {
+			oldBuckets.clear();
+			bucketHashFunction.randomize(randoms, bucketAmount);
+			for (size_t i = 0; i < buckets.size(); ++i) {
+				buckets[i].seed(randoms());
+			}
+		} else {
+			rehashAll();
+		}
+    }
+
+    void bulk_insert(const std::pair<Key, T>* first, const std::pair<Key, T>* last) override {
+		insertRange(first, last);
+    }
+
+	/// Adds a range of key/value pairs with a single global rehash, instead of
+	/// growing the buckets while inserting them one by one. A later pair
+	/// overwrites an earlier one with the same key.
+	template <typename InputIt>
+	void insertRange(InputIt first, InputIt last) {
+		if (first == last) {
+			return;
+		}
+		common::rehash_trace::scope trace;
+		while (isMigrating()) {
+			migrateSlots(std::numeric_limits<size_t>::max());
+		}
+		std::vector<bucket_entry<Key, T>>& entries = collectEntries();
+		for (; first != last; ++first) {
+			bucket_entry<Key, T> entry;
+			entry.initialize(first->first);
+			entry.getValue() = first->second;
+			entries.push_back(entry);
+		}
+		rehashAll(entries, true);
 	}
 
 private:
+	void createBuckets(size_t initialBucketSize) {
+		buckets.clear();
+		buckets.reserve(bucketAmount);
+		for (size_t i = 0; i < bucketAmount; ++i) {
+			buckets.push_back(Bucket(initialBucketSize, _parameters, randoms()));
+		}
+	}
+
+	bool isMigrating() const {
+		return !oldBuckets.empty();
+	}
+
+	/// The old bucket that still holds key, or nullptr if there is none
+	Bucket* oldBucketOf(size_t preHash, const Key &key) {
+		size_t oldIndex = oldBucketHashFunction(preHash);
+		if (oldIndex < migrationBucket) {
+			return nullptr;
+		}
+		Bucket& oldBucket = oldBuckets[oldIndex];
+		EntryRef entry = oldBucket[preHash];
+		if (entry.isInitialized() && !entry.isDeleted() && entry.getKey() == key) {
+			return &oldBucket;
+		}
+		return nullptr;
+	}
+
+	/// The bucket of a stored key, in whichever generation holds it
+	Bucket& currentBucket(size_t preHash, const Key &key) {
+		if (isMigrating()) {
+			Bucket* oldBucket = oldBucketOf(preHash, key);
+			if (oldBucket != nullptr) {
+				return *oldBucket;
+			}
+		}
+		return buckets[bucketHashFunction(preHash)];
+	}
+
+	/// Migrates the next slots for an operation on key. Returns the old
+	/// bucket of key if it still holds key.
+	Bucket* migrationStep(size_t preHash, const Key &key) {
+		migrateSlots(_migrationRate);
+		if (isMigrating()) {
+			return oldBucketOf(preHash, key);
+		}
+		return nullptr;
+	}
+
+	/// Moves the current buckets to the old generation and starts over with
+	/// small ones, which grow while the old slots are migrated into them
+	void startMigration() {
+		common::rehash_trace::rehash();
+		while (isMigrating()) {
+			migrateSlots(std::numeric_limits<size_t>::max());
+		}
+
+		count = size();
+		M = calculateM(count);
+		bucketAmount = calculateBucketAmount(M);
+		// The expected elements per bucket with three standard deviations slack
+		size_t expectedBucketM = count / bucketAmount;
+		migrationBucketM = expectedBucketM + 3 * size_t(std::sqrt(double(expectedBucketM)));
+
+		oldBucketHashFunction = bucketHashFunction;
+		oldBuckets.swap(buckets);
+		migrationBucket = 0;
+		migrationSlot = 0;
+
+		bucketHashFunction.randomize(randoms, bucketAmount);
+		createBuckets(0);
+	}
+
+	void migrateSlots(size_t amount) {
+		common::rehash_trace::scope trace;
+		while (amount > 0 && isMigrating()) {
+			Bucket& oldBucket = oldBuckets[migrationBucket];
+			typename Bucket::Entries& oldEntries = oldBucket.getEntries();
+			if (migrationSlot == oldEntries.size()) {
+				oldEntries = typename Bucket::Entries();
+				migrationSlot = 0;
+				if (++migrationBucket == oldBuckets.size()) {
+					finishMigration();
+				}
+				continue;
+			}
+			EntryRef entry = oldEntries[migrationSlot++];
+			if (entry.isInitialized() && !entry.isDeleted()) {
+				migrateEntry(entry);
+				entry = bucket_entry<Key, T>();
+				--oldBucket.elementAmount;
+			}
+			--amount;
+		}
+	}
+
+	void migrateEntry(const bucket_entry<Key, T>& migrating) {
+		size_t preHash = preHashFunction(migrating.getKey());
+		Bucket& bucket = buckets[bucketHashFunction(preHash)];
+		if (bucket.b >= bucket.M) {
+			bucket.reserve(migrationGrowth(bucket));
+		}
+		EntryRef entry = bucket[preHash];
+		if (!entry.isInitialized() || entry.isDeleted()) {
+			bool reusesTombstone = entry.isDeleted();
+			entry = migrating;
+			occupy(bucket, reusesTombstone);
+		} else {
+			bucket.rehash(migrating.getKey());
+			bucket[preHash] = migrating;
+		}
+	}
+
+	void countInsert(Bucket& bucket, bool reusesTombstone) {
+		++count;
+		occupy(bucket, reusesTombstone);
+	}
+
+	/// Counts an entry that took an empty or deleted slot of bucket.
+	/// Recycling a tombstone doesn't occupy another slot, so the bucket's b
+	/// only grows for empty slots.
+	void occupy(Bucket& bucket, bool reusesTombstone) {
+		++bucket.elementAmount;
+		if (Deletion::recycles && reusesTombstone) {
+			--bucket.tombstones;
+		} else {
+			++bucket.b;
+		}
+	}
+
+	/// An erase is an update for counting_deletion. With recycling_deletion
+	/// count holds the live entries instead, so the table only rehashes
+	/// globally when it grows.
+	void countErase() {
+		if (!Deletion::recycles) {
+			++count;
+		} else if (count > 0) {
+			--count;
+		}
+	}
+
+	/// Buckets grow to the expected size at once, then by doubling
+	size_t migrationGrowth(const Bucket& bucket) const {
+		return std::max(2 * bucket.M, migrationBucketM);
+	}
+
+	void finishMigration() {
+		oldBuckets.clear();
+		// The migration counts as one rebuild, so the buckets start afresh
+		for (size_t i = 0; i < buckets.size(); ++i) {
+			buckets[i].b = 0;
+		}
+	}
+
 	size_t calculateM(size_t elementAmount) {
-		return (1 + capacityFactor) * std::max(elementAmount, size_t(4));
+		return Sizing::tableM(elementAmount, _parameters);
 	}
 
 	size_t calculateBucketAmount(size_t elementAmount) {
-		return std::max(size_t(10), elementAmount / _elementAmountPerBucket);
+		return std::max(size_t(10), elementAmount / _parameters.elementAmountPerBucket());
 	}
 
 	bool globalConditionIsSatisfied(size_t bucketLengthOfBucketToResize,
@@ -371,102 +795,101 @@ private:
 	}
 
 	void rehashAll(const Key &key) {
+		common::rehash_trace::scope trace;
 		size_t preHash = preHashFunction(key);
 		size_t bucketIndex = bucketHashFunction(preHash);
-		bucket<Key, T>& keyBucket = buckets[bucketIndex];
-		bucket_entry<Key, T>& entry = keyBucket[preHash];
+		Bucket& keyBucket = buckets[bucketIndex];
+		EntryRef entry = keyBucket[preHash];
 		bool hadCollision = entry.getKey() != key;
-
-		// Collecting entries of the bucket
-		std::vector<bucket_entry<Key, T>> entries(hadCollision ? size() + 1 : size());
-		size_t j = 0;
-		for (size_t b = 0; b < buckets.size(); ++b) {
-			bucket<Key, T>& bucket = buckets[b];
-			std::vector<bucket_entry<Key, T>>& bucketEntries = bucket.getEntries();
-			for (size_t i = 0; i < bucketEntries.size(); ++i) {
-				bucket_entry<Key, T>& entry = bucketEntries[i];
-				if (entry.isInitialized() && !entry.isDeleted()) {
-					entries[j] = entry;
-					++j;
-				}
+		if (_migrationRate > 0) {
+			if (hadCollision) {
+				keyBucket.rehash(key);
 			}
+			startMigration();
+			return;
 		}
+
+		// Collecting entries of the bucket
+		std::vector<bucket_entry<Key, T>>& entries = collectEntries();
 		if (hadCollision) {
 			//there was a collision. append current inserted element
 			bucket_entry<Key, T> entry = bucket_entry<Key, T>();
 			entry.initialize(key);
-			entries[j] = entry;
+			entries.push_back(entry);
 		}
 		rehashAll(entries);
 	}
 
 	void rehashAll() {
-		// Collecting entries of the bucket
-		std::vector<bucket_entry<Key, T>> entries(size());
-		size_t j = 0;
+		common::rehash_trace::scope trace;
+		if (_migrationRate > 0) {
+			startMigration();
+			return;
+		}
+		rehashAll(collectEntries());
+	}
+
+	/// The live entries of the current buckets, in the rehash buffer
+	std::vector<bucket_entry<Key, T>>& collectEntries() {
+		std::vector<bucket_entry<Key, T>>& entries = rehashEntries;
+		entries.clear();
+		entries.reserve(live);
 		for (size_t b = 0; b < buckets.size(); ++b) {
-			bucket<Key, T>& bucket = buckets[b];
-			std::vector<bucket_entry<Key, T>>& bucketEntries = bucket.getEntries();
-			for (size_t i = 0; i < bucketEntries.size(); ++i) {
-				bucket_entry<Key, T>& entry = bucketEntries[i];
-				if (entry.isInitialized() && !entry.isDeleted()) {
-					entries[j] = entry;
-					++j;
-				}
-			}
+			buckets[b].getEntries().forEachLive([&](EntryRef entry) {
+				entries.push_back(entry);
+			});
 		}
-		rehashAll(entries);
+		return entries;
 	}
 
-	void rehashAll(std::vector<bucket_entry<Key, T>>& elements) {
+	/// Rebuilds the table from elements. Only elements from outside the table
+	/// may contain the same key more than once, which mergeDuplicates handles.
+	void rehashAll(std::vector<bucket_entry<Key, T>>& elements, bool mergeDuplicates = false) {
+		common::rehash_trace::scope trace;
+		common::rehash_trace::rehash();
+
+		if (mergeDuplicates) {
+			// Merging first, so that the table is sized for the distinct keys
+			bucketAmount = calculateBucketAmount(calculateM(elements.size()));
+			bucketHashFunction.randomize(randoms, bucketAmount);
+			partition.build(elements, bucketAmount, [this](bucket_entry<Key, T>& entry) {
+				return bucketHashFunction(preHashFunction(entry.getKey()));
+			}, _rehashThreads);
+			partition.removeDuplicates(preHashFunction);
+			partition.copyTo(elements);
+		}
+
 		count = elements.size();
 		M = calculateM(count);
 		bucketAmount = calculateBucketAmount(M);
 
-		std::vector<std::vector<bucket_entry<Key, T>>> bucketedEntries;
-		size_t lengthSum = 0;
+		bool isBalanced;
 		do {
-			size_t prime = primes(bucketAmount);
-			size_t random = randoms(1, prime - 1);
-			size_t random2 = randoms(1, prime - 1);
-			bucketHashFunction.setParameters(random, random2, prime, bucketAmount);
-
-			//Initializing helper vectors
-			bucketedEntries.clear();
-			bucketedEntries.resize(bucketAmount, std::vector<bucket_entry<Key, T>>(elements.size() / bucketAmount));
-			std::vector<size_t> bucketIndices(bucketAmount);
+			bucketHashFunction.randomize(randoms, bucketAmount);
 
 			//Collecting elements for the buckets with new bucket hash Function
-			for (size_t i = 0; i < elements.size(); ++i) {
-				bucket_entry<Key, T>& entry = elements[i];
-				size_t preHash = preHashFunction(entry.getKey());
-				size_t bucketIndex = bucketHashFunction(preHash);
-				std::vector<bucket_entry<Key, T>>& entriesForBucket = bucketedEntries[bucketIndex];
-				size_t& elementIndex = bucketIndices[bucketIndex];
-				if (elementIndex < entriesForBucket.size()) {
-					entriesForBucket[elementIndex] = entry;
-					++elementIndex;
-				} else {
-					entriesForBucket.push_back(entry);
-					++elementIndex;
-				}
-			}
+			partition.build(elements, bucketAmount, [this](bucket_entry<Key, T>& entry) {
+				return bucketHashFunction(preHashFunction(entry.getKey()));
+			}, _rehashThreads);
 
-			lengthSum = 0;
-			for (size_t i = 0; i < bucketAmount; ++i) {
-				bucketedEntries[i].resize(bucketIndices[i]);
-				lengthSum += bucketedEntries[i].size();
+			isBalanced = globalConditionIsSatisfied(partition.size());
+			if (!isBalanced) {
+				common::rehash_trace::retry();
 			}
-		} while (!globalConditionIsSatisfied(lengthSum));
+		} while (!isBalanced);
+		live = partition.size();
 
-		//Updating the buckets
-		buckets.clear();
-		buckets.resize(bucketAmount);
+		//Updating the buckets, which are independent of each other now. The
+		//seeds are drawn up front to keep the result independent of the threads.
+		seeds.resize(bucketAmount);
 		for (size_t i = 0; i < bucketAmount; ++i) {
-			std::vector<bucket_entry<Key, T>>& bucketEntries = bucketedEntries[i];
-			buckets[i] = bucket<Key, T>(bucketEntries,
-					 	 	 	 	 	_bucketCapacityFactor, _bucketLengthFactor, _bucketMaxRehashAttempts, _bucketRehashLengthFactor);
+			seeds[i] = randoms();
 		}
+		buckets.clear();
+		buckets.resize(bucketAmount);
+		common::parallel_for(_rehashThreads, bucketAmount, [&](size_t i) {
+			buckets[i] = Bucket(partition.bucketEntries(i), partition.bucketSize(i), _parameters, seeds[i]);
+		});
 	}
 };
 
@@ -1,200 +1,29 @@
 #pragma once
 
-#include <cassert>
-#include <iostream>
+#include <thread>
 
 #include "../common/contenders.h"
 #include "hashtable.h"
-#include "DPH_Common.h"
-
-using namespace common::monad;
+#include "DPH_with_buckets.h"
 
 namespace hashtable {
 
+/// DPH_with_buckets that rehashes by load: buckets and the table are sized
+/// by their live entries and shrink again when they become sparse, see
+/// load_trigger and proportional_sizing. The tuning factors default to
+/// 2, 2, 5, 2, 2 and 3000.
 template <typename Key, typename T,
-		  typename PreHashFcn = std::hash<Key>>
-class bucket_2 {
-private:
-	size_t _capacityFactor;
-	size_t _lengthFactor;
-	size_t _maxRehashAttempts;
-	size_t _rehashLengthFactor;
-
-public:
-	size_t capacity;
-	size_t length;
-	size_t elementAmount;
-
+		  typename PreHashFcn = std::hash<Key>,
+		  typename HashFamily = prime_modulo_family<>>
+class DPH_with_buckets_2 : public DPH_with_buckets<Key, T, PreHashFcn, HashFamily, entry_vector_storage,
+												   runtime_parameters, counting_deletion,
+												   load_trigger, proportional_sizing> {
 private:
-	prime_generator primes;
-	random_generator randoms;
-
-	PreHashFcn preHashFunction;
-	entry_hash_function hashFunction;
-	std::vector<bucket_entry<Key, T>> entries;
+	using Base = DPH_with_buckets<Key, T, PreHashFcn, HashFamily, entry_vector_storage,
+								  runtime_parameters, counting_deletion,
+								  load_trigger, proportional_sizing>;
 
 public:
-	bucket_2() : bucket_2(0) { }
-
-	bucket_2(std::vector<bucket_entry<Key, T>> initialEntries,
-		     size_t capacityFactor, size_t lengthFactor, size_t maxRehashAttempts, size_t rehashLengthFactor) :
-	bucket_2(initialEntries.size(),
-		     capacityFactor, lengthFactor, maxRehashAttempts, rehashLengthFactor)
-	{
-		elementAmount = initialEntries.size();
-		insertAll(initialEntries);
-	}
-
-	bucket_2(size_t initialSize) : bucket_2(initialSize,
-											2, 5, 5, 2) { }
-
-	bucket_2(size_t initialSize,
-		     size_t capacityFactor, size_t lengthFactor, size_t maxRehashAttempts, size_t rehashLengthFactor) :
-		_capacityFactor(capacityFactor),
-		_lengthFactor(lengthFactor),
-		_maxRehashAttempts(maxRehashAttempts),
-		_rehashLengthFactor(rehashLengthFactor),
-		capacity(std::max(size_t(10), initialSize)),
-		length(calculateLength(capacity)),
-		elementAmount(0),
-		entries(length)
-	{
-		size_t random = randoms(1, length - 1);
-		size_t random2 = randoms(1, length - 1);
-		hashFunction.setParameters(random, random2, length);
-	}
-
-	bucket_entry<Key, T>& operator[](size_t preHash) {
-		size_t index = hashFunction(preHash);
-		return entries[index];
-	}
-
-    virtual ~bucket_2() = default;
-
-    std::vector<bucket_entry<Key, T>>& getEntries() {
-    	return entries;
-    }
-
-    maybe<T> find(size_t preHash, const Key &key) const {
-    	size_t index = hashFunction(preHash);
-		return entries[index].find(key);
-    }
-
-    size_t size() const {
-    	return elementAmount;
-    }
-
-	void resizeAndRehash(const Key& key) {
-		capacity = elementAmount * _capacityFactor;
-		length = calculateLength(capacity);
-		rehash(key);
-	}
-
-	void rehash(const Key& key) {
-		// Collecting entries of the bucket
-		std::vector<bucket_entry<Key, T>> bucketEntries(elementAmount + 1);
-		size_t j = 0;
-		bool includesNewKey = false;
-		for (size_t i = 0; i < entries.size(); ++i) {
-			bucket_entry<Key, T>& entry = entries[i];
-			if (entry.isInitialized() && !entry.isDeleted()) {
-				if (entry.getKey() == key) {
-					includesNewKey = true;
-				}
-				bucketEntries[j] = entry;
-				++j;
-			}
-			entries[i] = bucket_entry<Key, T>();
-		}
-		if (!includesNewKey) {
-			bucketEntries[j].initialize(key);
-			++elementAmount;
-		} else {
-			bucketEntries.pop_back();
-		}
-
-		entries.clear();
-		entries.resize(length);
-		insertAll(bucketEntries);
-	}
-
-	size_t calculateLength(size_t bucketCapacity) {
-		size_t minLength = _lengthFactor * bucketCapacity;
-		return primes(minLength);
-	}
-
-private:
-	void insertAll(std::vector<bucket_entry<Key, T>> bucketEntries) {
-		// Choose a new injective hash function randomly
-		size_t rehashAttempts = 0;
-		bool isInjective;
-		do {
-			++rehashAttempts;
-
-			isInjective = true;
-			size_t random = randoms(1, length - 1);
-			size_t random2 = randoms(1, length - 1);
-			hashFunction.setParameters(random, random2, length);
-
-			std::vector<size_t> indices = std::vector<size_t>(length);
-			for(size_t i = 0; i < bucketEntries.size(); ++i) {
-				bucket_entry<Key, T>& entry = bucketEntries[i];
-				if (entry.isInitialized()) {
-					size_t preHash = preHashFunction(entry.getKey());
-					size_t index = hashFunction(preHash);
-					if (indices[index] != 0) {
-						isInjective = false;
-						break;
-					} else {
-						indices[index] = 1;
-					}
-				}
-			}
-
-			if (rehashAttempts > _maxRehashAttempts) {
-				length *= _rehashLengthFactor;
-				entries.clear();
-				entries.resize(length);
-				rehashAttempts = 0;
-			}
-		} while (!isInjective);
-
-		// Inserting the entries in the table
-		for(size_t i = 0; i < bucketEntries.size(); ++i) {
-			bucket_entry<Key, T>& entry = bucketEntries[i];
-			size_t preHash = preHashFunction(entry.getKey());
-			size_t index = hashFunction(preHash);
-			entries[index] = entry;
-		}
-
-	}
-};
-
-template <typename Key, typename T,
-		  typename PreHashFcn = std::hash<Key>>
-class DPH_with_buckets_2 : public hashtable<Key, T> { // DPH = Dynamic Perfect Hashing
-private:
-	size_t _capacityFactor;
-	size_t _elementAmountPerBucket;
-
-	size_t _bucketCapacityFactor;
-	size_t _bucketLengthFactor;
-	size_t _bucketMaxRehashAttempts;
-	size_t _bucketRehashLengthFactor;
-
-	size_t capacity;
-	size_t bucketAmount;
-
-	prime_generator primes;
-	random_generator randoms;
-	
-	PreHashFcn preHashFunction;
-	bucket_hash_function bucketHashFunction;
-	std::vector<bucket_2<Key, T>> buckets;
-	
-public:
-    virtual ~DPH_with_buckets_2() = default;
-
     // Register all contenders in the list
     static void register_contenders(common::contender_list<hashtable<Key, T>> &list) {
         using Factory = common::contender_factory<hashtable<Key, T>>;
@@ -202,253 +31,51 @@ public:
             [](){
 				return new DPH_with_buckets_2(1000);
 			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets-2 (parallel rehash)", "DPH-with-buckets-2-parallel",
+            [](){
+				return new DPH_with_buckets_2(1000,
+											  2, 2, 5, 2,
+											  2, 3000,
+											  std::max(1u, std::thread::hardware_concurrency()));
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets-2 (hardware modulo)", "DPH-with-buckets-2-hwmod",
+            [](){
+				return new DPH_with_buckets_2<Key, T, PreHashFcn, prime_modulo_family<hardware_modulo>>(1000);
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets-2 (multiply-shift)", "DPH-with-buckets-2-multshift",
+            [](){
+				return new DPH_with_buckets_2<Key, T, PreHashFcn, multiply_shift_family>(1000);
+			}
+        ));
+        list.register_contender(Factory("DPH-with-buckets-2 (tabulation)", "DPH-with-buckets-2-tabulation",
+            [](){
+				return new DPH_with_buckets_2<Key, T, PreHashFcn, tabulation_family>(1000);
+			}
         ));
     }
-	
+
     DPH_with_buckets_2(size_t initialElementAmount) : DPH_with_buckets_2(initialElementAmount,
     																	 2, 2, 5, 2,
 																	     2, 3000) { }
 
+    /// A global rehash builds the buckets on rehashThreads threads
     DPH_with_buckets_2(size_t initialElementAmount,
     				   size_t bucketCapacityFactor, size_t bucketLengthFactor, size_t bucketMaxRehashAttempts, size_t bucketRehashLengthFactor,
-					   size_t tableCapacityFactor, size_t elementAmountPerBucket) :
-    	hashtable<Key, T>(),
-		_capacityFactor(tableCapacityFactor),
-		_elementAmountPerBucket(elementAmountPerBucket),
-
-		_bucketCapacityFactor(bucketCapacityFactor),
-		_bucketLengthFactor(bucketLengthFactor),
-		_bucketMaxRehashAttempts(bucketMaxRehashAttempts),
-		_bucketRehashLengthFactor(bucketRehashLengthFactor),
-
-		capacity(initialElementAmount),
-		bucketAmount(calculateBucketAmount(initialElementAmount)),
-		primes(),
-		randoms(),
-    	buckets(bucketAmount, bucket_2<Key, T>(_elementAmountPerBucket,
-    										   _bucketCapacityFactor, _bucketLengthFactor, _bucketMaxRehashAttempts, _bucketRehashLengthFactor))
-	{
-		size_t prime = primes(bucketAmount);
-		size_t random = randoms(1, prime - 1);
-		size_t random2 = randoms(1, prime - 1);
-		bucketHashFunction.setParameters(random, random2, prime, bucketAmount);
+					   size_t tableCapacityFactor, size_t elementAmountPerBucket,
+					   size_t rehashThreads = 1) :
+		Base(initialElementAmount,
+			 runtime_parameters(bucketCapacityFactor, bucketLengthFactor, bucketMaxRehashAttempts, bucketRehashLengthFactor,
+								tableCapacityFactor, elementAmountPerBucket),
+			 0, rehashThreads) { }
+
+    /// Builds the table from a range of key/value pairs in one pass
+    template <typename InputIt>
+    DPH_with_buckets_2(InputIt first, InputIt last) : DPH_with_buckets_2(0) {
+		this->insertRange(first, last);
     }
-		
-    T& operator[](const Key &key) override {
-		size_t preHash = preHashFunction(key);
-		size_t bucketIndex = bucketHashFunction(preHash);
-		bucket_2<Key, T>& _bucket = buckets[bucketIndex];
-		bucket_entry<Key, T>& entry = _bucket[preHash];
-		if (!entry.isInitialized()) {
-			entry.initialize(key);
-			++_bucket.elementAmount;
-		} else if (entry.isDeleted()) {
-			entry = bucket_entry<Key, T>();
-			entry.initialize(key);
-			++_bucket.elementAmount;
-		}
-		bool wasRehashed = false;
-		if (size() > capacity || _bucket.elementAmount > _elementAmountPerBucket) {
-			rehashAll(key);
-			wasRehashed = true;
-		} else if (_bucket.elementAmount <= _bucket.capacity and entry.getKey() != key) {
-			_bucket.rehash(key);
-			wasRehashed= true;
-		} else if (_bucket.elementAmount > _bucket.capacity or _bucket.elementAmount <= _bucket.capacity / (_bucketCapacityFactor * 2)) {
-			size_t newBucketCapacity = _bucket.elementAmount * _bucketCapacityFactor;
-			size_t newBucketLength = _bucket.calculateLength(newBucketCapacity);
-			if (globalConditionIsSatisfied(newBucketLength, bucketIndex)) {
-				_bucket.resizeAndRehash(key);
-			} else {
-				rehashAll();
-			}
-			wasRehashed = true;
-		}
-		if (wasRehashed) {
-			bucketIndex = bucketHashFunction(preHash);
-			bucket_2<Key, T>& rehashedBucket = buckets[bucketIndex];
-			bucket_entry<Key, T>& newEntry = rehashedBucket[preHash];
-			// If this is not the case something with the dynamic rehashing didn't work out
-			assert(newEntry.getKey() == key);
-			return newEntry.getValue();
-		}
-		// If this is not the case something with the dynamic rehashing didn't work out
-		assert(entry.getKey() == key);
-		return entry.getValue();
-	}
-
-    T& operator[](Key&& key) override {
-		Key movedKey = std::move(key);
-		return (*this)[movedKey];
-    }
-
-    maybe<T> find(const Key &key) const override {
-		size_t preHash = preHashFunction(key);
-		size_t bucketIndex = bucketHashFunction(preHash);
-		return buckets[bucketIndex].find(preHash, key);
-    }
-
-    size_t erase(const Key &key) override {
-		size_t preHash = preHashFunction(std::move(key));
-		size_t bucketIndex = bucketHashFunction(preHash);
-		bucket_2<Key, T>& bucket = buckets[bucketIndex];
-		bucket_entry<Key, T>& entry = bucket[preHash];
-
-		if (entry.isInitialized() and !entry.isDeleted()) {
-			// If this is not the case something with the dynamic rehashing didn't work out
-			assert(entry.getKey() == key);
-			entry.markDeleted();
-			--bucket.elementAmount;
-			return 1;
-		}
-		if (size() < capacity / (_capacityFactor * 2)) {
-			rehashAll();
-		}
-		return 0;
-    }
-
-    size_t size() const override {
-    	size_t _size = 0;
-    	for (size_t i = 0; i < buckets.size(); ++i) {
-    		_size += buckets[i].size();
-    	}
-		return _size;
-	}
-
-    void clear() override {
-		capacity = size() * _capacityFactor;
-		bucketAmount = calculateBucketAmount(0);
-		buckets.clear();
-    	buckets.resize(bucketAmount, bucket_2<Key, T>(0, _bucketCapacityFactor, _bucketLengthFactor, _bucketMaxRehashAttempts, _bucketRehashLengthFactor));
-	}
-
-private:
-	size_t calculateBucketAmount(size_t elementAmount) {
-		return std::max(size_t(10), elementAmount / _elementAmountPerBucket);
-	}
-
-	bool globalConditionIsSatisfied(size_t bucketLengthOfBucketToResize,
-	                        		size_t bucketIndexOfBucketToResize) {
-		size_t lengthSum = 0;
-		for (size_t i = 0; i < bucketAmount; ++i) {
-			if (i == bucketIndexOfBucketToResize) {
-				lengthSum += bucketLengthOfBucketToResize;
-			} else {
-				lengthSum += buckets[i].length;
-			}
-		}
-		return globalConditionIsSatisfied(lengthSum);
-	}
-
-	bool globalConditionIsSatisfied() {
-		size_t lengthSum = 0;
-		for (size_t i = 0; i < bucketAmount; ++i) {
-			lengthSum += buckets[i].length;
-		}
-		return globalConditionIsSatisfied(lengthSum);
-	}
-
-	bool globalConditionIsSatisfied(size_t lengthSum) {
-		return lengthSum <= ((32 * capacity * capacity) / bucketAmount) + 4 * capacity;
-	}
-
-	void rehashAll(const Key &key) {
-		size_t preHash = preHashFunction(key);
-		size_t bucketIndex = bucketHashFunction(preHash);
-		bucket_2<Key, T>& keyBucket = buckets[bucketIndex];
-		bucket_entry<Key, T>& entry = keyBucket[preHash];
-		bool hadCollision = entry.getKey() != key;
-
-		// Collecting entries of the bucket
-		std::vector<bucket_entry<Key, T>> entries(hadCollision ? size() + 1 : size());
-		size_t j = 0;
-		for (size_t b = 0; b < buckets.size(); ++b) {
-			bucket_2<Key, T>& bucket = buckets[b];
-			std::vector<bucket_entry<Key, T>>& bucketEntries = bucket.getEntries();
-			for (size_t i = 0; i < bucketEntries.size(); ++i) {
-				bucket_entry<Key, T>& entry = bucketEntries[i];
-				if (entry.isInitialized() && !entry.isDeleted()) {
-					entries[j] = entry;
-					++j;
-				}
-			}
-		}
-		if (hadCollision) {
-			//there was a collision. append current inserted element
-			bucket_entry<Key, T> entry = bucket_entry<Key, T>();
-			entry.initialize(key);
-			entries[j] = entry;
-		}
-		rehashAll(entries);
-	}
-
-	void rehashAll() {
-		// Collecting entries of the bucket
-		std::vector<bucket_entry<Key, T>> entries(size());
-		size_t j = 0;
-		for (size_t b = 0; b < buckets.size(); ++b) {
-			bucket_2<Key, T>& bucket = buckets[b];
-			std::vector<bucket_entry<Key, T>>& bucketEntries = bucket.getEntries();
-			for (size_t i = 0; i < bucketEntries.size(); ++i) {
-				bucket_entry<Key, T>& entry = bucketEntries[i];
-				if (entry.isInitialized() && !entry.isDeleted()) {
-					entries[j] = entry;
-					++j;
-				}
-			}
-		}
-		rehashAll(entries);
-	}
-
-	void rehashAll(std::vector<bucket_entry<Key, T>>& elements) {
-		capacity = elements.size() * _capacityFactor;
-		bucketAmount = calculateBucketAmount(capacity);
-
-		std::vector<std::vector<bucket_entry<Key, T>>> bucketedEntries;
-		size_t lengthSum = 0;
-		do {
-			size_t prime = primes(bucketAmount);
-			size_t random = randoms(1, prime - 1);
-			size_t random2 = randoms(1, prime - 1);
-			bucketHashFunction.setParameters(random, random2, prime, bucketAmount);
-
-			//Initializing helper vectors
-			bucketedEntries.clear();
-			bucketedEntries.resize(bucketAmount, std::vector<bucket_entry<Key, T>>(elements.size() / bucketAmount));
-			std::vector<size_t> bucketIndices(bucketAmount);
-
-			//Collecting elements for the buckets with new bucket hash Function
-			for (size_t i = 0; i < elements.size(); ++i) {
-				bucket_entry<Key, T>& entry = elements[i];
-				size_t preHash = preHashFunction(entry.getKey());
-				size_t bucketIndex = bucketHashFunction(preHash);
-				std::vector<bucket_entry<Key, T>>& entriesForBucket = bucketedEntries[bucketIndex];
-				size_t& elementIndex = bucketIndices[bucketIndex];
-				if (elementIndex < entriesForBucket.size()) {
-					entriesForBucket[elementIndex] = entry;
-					++elementIndex;
-				} else {
-					entriesForBucket.push_back(entry);
-					++elementIndex;
-				}
-			}
-
-			lengthSum = 0;
-			for (size_t i = 0; i < bucketAmount; ++i) {
-				bucketedEntries[i].resize(bucketIndices[i]);
-				lengthSum += bucketedEntries[i].size();
-			}
-		} while (!globalConditionIsSatisfied(lengthSum));
-
-		//Updating the buckets
-		buckets.clear();
-		buckets.resize(bucketAmount);
-		for (size_t i = 0; i < bucketAmount; ++i) {
-			std::vector<bucket_entry<Key, T>>& bucketEntries = bucketedEntries[i];
-			buckets[i] = bucket_2<Key, T>(bucketEntries,
-					 	 	 	 	 	_bucketCapacityFactor, _bucketLengthFactor, _bucketMaxRehashAttempts, _bucketRehashLengthFactor);
-		}
-	}
 };
 
 }
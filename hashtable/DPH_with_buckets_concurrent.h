@@ -0,0 +1,483 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "../common/contenders.h"
+#include "../common/epoch.h"
+#include "hashtable.h"
+#include "DPH_Common.h"
+
+using namespace common::monad;
+
+namespace hashtable {
+
+/// A slot of a concurrent bucket. The writer fills an empty slot and then
+/// publishes it through its state. Key and value of a published slot are
+/// never written again, an erase only changes the state.
+template <typename Key, typename T>
+struct concurrent_slot {
+	enum : uint8_t { empty = 0, live = 1, deleted = 2 };
+
+	std::atomic<uint8_t> state;
+	Key key;
+	T value;
+
+	concurrent_slot() : state(empty), key(), value() { }
+
+	bool holds(const Key &requestedKey) const {
+		return state.load(std::memory_order_acquire) == live && key == requestedKey;
+	}
+};
+
+/// A DPH bucket whose hash function and slots are fixed for its lifetime:
+/// rehashing or growing it builds a replacement. Only the writer touches
+/// the counters.
+template <typename Key, typename T,
+		  typename PreHashFcn = std::hash<Key>,
+		  typename HashFamily = prime_modulo_family<>,
+		  typename Parameters = runtime_parameters>
+class concurrent_bucket {
+public:
+	using Slot = concurrent_slot<Key, T>;
+
+	size_t M;
+	size_t b;
+	size_t length;
+	size_t elementAmount;
+	size_t tombstones;
+
+private:
+	typename HashFamily::function hashFunction;
+	std::vector<Slot> slots;
+
+public:
+	/// A bucket of capacity bucketM holding the given entries, which have
+	/// already caused b updates
+	concurrent_bucket(const bucket_entry<Key, T>* entries, size_t amount, size_t bucketM, size_t updates,
+					  const Parameters &parameters, size_t seed) :
+		M(std::max(size_t(10), bucketM)),
+		b(updates),
+		length(calculateBucketLength(M, parameters)),
+		elementAmount(amount),
+		tombstones(0)
+	{
+		random_generator randoms(seed);
+		rehash_scratch<Key, T>& scratch = rehash_scratch<Key, T>::local();
+		scratch.preHash(entries, amount, PreHashFcn());
+
+		// Choose an injective hash function before allocating the slots
+		size_t rehashAttempts = 0;
+		bool isInjective;
+		do {
+			++rehashAttempts;
+			hashFunction.randomize(randoms, length);
+			isInjective = scratch.isInjective(hashFunction, length);
+			if (!isInjective) {
+				common::rehash_trace::retry();
+			}
+			if (rehashAttempts > parameters.bucketMaxRehashAttempts()) {
+				length = HashFamily::length(length * parameters.bucketRehashLengthFactor());
+				rehashAttempts = 0;
+			}
+		} while (!isInjective);
+
+		// The bucket is not published yet, so the slots need no ordering
+		slots = std::vector<Slot>(length);
+		for (size_t i = 0; i < amount; ++i) {
+			Slot& slot = slots[scratch.slots[i]];
+			slot.key = entries[i].getKey();
+			slot.value = entries[i].getValue();
+			slot.state.store(Slot::live, std::memory_order_relaxed);
+		}
+	}
+
+	concurrent_bucket(const concurrent_bucket &) = delete;
+	concurrent_bucket& operator=(const concurrent_bucket &) = delete;
+
+	static size_t calculateBucketLength(size_t bucketM, const Parameters &parameters) {
+		return HashFamily::length(parameters.bucketLengthFactor() * bucketM);
+	}
+
+	Slot& slot(size_t preHash) {
+		return slots[hashFunction(preHash)];
+	}
+
+	const T* find_ptr(size_t preHash, const Key &key) const {
+		const Slot& slot = slots[hashFunction(preHash)];
+		return slot.holds(key) ? &slot.value : nullptr;
+	}
+
+	/// Copies the live entries, for the writer only
+	void collect(std::vector<bucket_entry<Key, T>> &entries) const {
+		for (const Slot& slot : slots) {
+			if (slot.state.load(std::memory_order_relaxed) == Slot::live) {
+				bucket_entry<Key, T> entry;
+				entry.initialize(slot.key);
+				entry.getValue() = slot.value;
+				entries.push_back(entry);
+			}
+		}
+	}
+
+	void inspect(common::structure_stats &stats) const {
+		stats.add_bucket(length, elementAmount, tombstones);
+		stats.bytes += sizeof(*this) + slots.capacity() * sizeof(Slot);
+	}
+};
+
+/// DPH_with_buckets for one writer thread and any number of reader threads.
+/// find and contains take no locks and never wait: they announce the epoch
+/// (common::epoch), load the published table and bucket and probe one slot.
+///
+/// The writer fills empty slots in place and publishes them through the
+/// slot state. Everything else that readers could observe half-done is
+/// built off to the side and published with an atomic pointer swap: a
+/// bucket that is rehashed, grows or changes a value is replaced, and a
+/// global rehash replaces the whole bucket array. Replaced buckets and
+/// arrays are freed once no reader can hold them any more. Tombstones are
+/// not reused in place, as a reader may still be reading the erased key.
+///
+/// operator[] hands out a reference into the slot; writing through it races
+/// with readers of the same key, so writers that share the table with
+/// readers change values with insert_or_assign(). size() and all
+/// modifications belong to the writer thread.
+template <typename Key, typename T,
+		  typename PreHashFcn = std::hash<Key>,
+		  typename HashFamily = prime_modulo_family<>>
+class DPH_with_buckets_concurrent : public hashtable<Key, T> {
+private:
+	using Parameters = runtime_parameters;
+	using Bucket = concurrent_bucket<Key, T, PreHashFcn, HashFamily, Parameters>;
+	using Slot = typename Bucket::Slot;
+
+	/// The bucket hash function and the buckets, replaced as a whole by a
+	/// global rehash. It owns the buckets it points to.
+	struct table {
+		typename HashFamily::function bucketHashFunction;
+		std::vector<std::atomic<Bucket*>> buckets;
+
+		explicit table(size_t bucketAmount) : buckets(bucketAmount) { }
+
+		~table() {
+			for (std::atomic<Bucket*> &bucket : buckets) {
+				delete bucket.load(std::memory_order_relaxed);
+			}
+		}
+
+		Bucket* bucket(size_t index) const {
+			return buckets[index].load(std::memory_order_relaxed);
+		}
+	};
+
+	Parameters _parameters;
+
+	size_t M;
+	size_t count;
+	size_t bucketAmount;
+	size_t elementAmount;
+
+	random_generator randoms;
+
+	PreHashFcn preHashFunction;
+	std::atomic<table*> current;
+	common::epoch::limbo retired;
+
+	// Buffers of rehashAll, kept so that later rehashes reuse their memory
+	std::vector<bucket_entry<Key, T>> rehashEntries;
+	bucket_partition<Key, T> partition;
+
+public:
+	// Register all contenders in the list
+	static void register_contenders(common::contender_list<hashtable<Key, T>> &list) {
+		using Factory = common::contender_factory<hashtable<Key, T>>;
+		list.register_contender(Factory("DPH-with-buckets (concurrent readers)", "DPH-with-buckets-concurrent",
+			[](){
+				return new DPH_with_buckets_concurrent(1000);
+			}
+		));
+	}
+
+	explicit DPH_with_buckets_concurrent(size_t initialElementAmount,
+										 const Parameters &parameters = Parameters()) :
+		hashtable<Key, T>(),
+		_parameters(parameters),
+
+		M(calculateM(initialElementAmount)),
+		count(0),
+		bucketAmount(calculateBucketAmount(initialElementAmount)),
+		elementAmount(0),
+		randoms(),
+		current(nullptr)
+	{
+		current.store(createTable(_parameters.elementAmountPerBucket()));
+	}
+
+	/// The caller guarantees that no reader is left
+	~DPH_with_buckets_concurrent() {
+		delete current.load();
+	}
+
+	bool concurrent_reads() const override {
+		return true;
+	}
+
+	T& operator[](const Key &key) override {
+		size_t preHash = preHashFunction(key);
+		Slot& slot = writerTable().bucket(bucketIndexOf(preHash))->slot(preHash);
+		if (slot.holds(key)) {
+			return slot.value;
+		}
+		bucket_entry<Key, T> entry;
+		entry.initialize(key);
+		return insertNew(preHash, entry);
+	}
+
+	T& operator[](Key &&key) override {
+		Key movedKey = std::move(key);
+		return (*this)[movedKey];
+	}
+
+	/// Sets the value of key. Readers see either the old or the new value:
+	/// changing a stored value replaces its bucket.
+	void insert_or_assign(const Key &key, const T &value) override {
+		size_t preHash = preHashFunction(key);
+		size_t bucketIndex = bucketIndexOf(preHash);
+		Bucket* bucket = writerTable().bucket(bucketIndex);
+		bucket_entry<Key, T> entry;
+		entry.initialize(key);
+		entry.getValue() = value;
+		if (!bucket->slot(preHash).holds(key)) {
+			insertNew(preHash, entry);
+			return;
+		}
+		std::vector<bucket_entry<Key, T>>& entries = rehash_scratch<Key, T>::local().entries;
+		entries.clear();
+		bucket->collect(entries);
+		for (bucket_entry<Key, T> &stored : entries) {
+			if (stored.getKey() == key) {
+				stored.getValue() = value;
+			}
+		}
+		replaceBucket(bucketIndex, new Bucket(entries.data(), entries.size(), bucket->M, bucket->b,
+											  _parameters, randoms()));
+	}
+
+	/// Safe on any thread, concurrently with the writer
+	maybe<T> find(const Key &key) const override {
+		common::epoch::guard guard;
+		const T* value = find_ptr(key);
+		if (value == nullptr) {
+			return nothing<T>();
+		}
+		return just<T>(*value);
+	}
+
+	/// Readers other than the writer must hold a common::epoch::guard while
+	/// they use the pointer
+	const T* find_ptr(const Key &key) const override {
+		size_t preHash = preHashFunction(key);
+		const table* t = current.load();
+		const Bucket* bucket = t->buckets[t->bucketHashFunction(preHash)].load();
+		return bucket->find_ptr(preHash, key);
+	}
+
+	/// Safe on any thread, concurrently with the writer
+	bool contains(const Key &key) const override {
+		common::epoch::guard guard;
+		return find_ptr(key) != nullptr;
+	}
+
+	size_t erase(const Key &key) override {
+		size_t preHash = preHashFunction(key);
+		Bucket* bucket = writerTable().bucket(bucketIndexOf(preHash));
+		Slot& slot = bucket->slot(preHash);
+		if (slot.holds(key)) {
+			slot.state.store(Slot::deleted, std::memory_order_release);
+			--elementAmount;
+			--bucket->elementAmount;
+			++bucket->tombstones;
+			++bucket->b;
+			if (++count >= M) {
+				rehashAll(nullptr);
+			}
+			return 1;
+		}
+		return 0;
+	}
+
+	size_t size() const override {
+		return elementAmount;
+	}
+
+	void inspect(common::structure_stats &stats) const override {
+		const table& t = writerTable();
+		for (size_t i = 0; i < t.buckets.size(); ++i) {
+			t.bucket(i)->inspect(stats);
+		}
+		stats.bytes += sizeof(*this) + sizeof(table) + t.buckets.capacity() * sizeof(std::atomic<Bucket*>);
+	}
+
+	void clear() override {
+		M = calculateM(0);
+		count = 0;
+		elementAmount = 0;
+		bucketAmount = calculateBucketAmount(0);
+		publish(createTable(0));
+	}
+
+	void seed(size_t seed) override {
+		randoms.seed(seed);
+		if (size() == 0) {
+			publish(createTable(writerTable().bucket(0)->M));
+		} else {
+			rehashAll(nullptr);
+		}
+	}
+
+private:
+	/// Only the writer replaces the table, so it needs no ordering itself
+	table& writerTable() const {
+		return *current.load(std::memory_order_relaxed);
+	}
+
+	size_t bucketIndexOf(size_t preHash) const {
+		return writerTable().bucketHashFunction(preHash);
+	}
+
+	table* createTable(size_t bucketM) {
+		table* t = new table(bucketAmount);
+		t->bucketHashFunction.randomize(randoms, bucketAmount);
+		for (size_t i = 0; i < bucketAmount; ++i) {
+			t->buckets[i].store(new Bucket(nullptr, 0, bucketM, 0, _parameters, randoms()),
+								std::memory_order_relaxed);
+		}
+		return t;
+	}
+
+	/// Swaps in a new table and retires the old one with its buckets
+	void publish(table* t) {
+		retired.retire(current.exchange(t));
+	}
+
+	void replaceBucket(size_t bucketIndex, Bucket* replacement) {
+		retired.retire(writerTable().buckets[bucketIndex].exchange(replacement));
+	}
+
+	/// Inserts a key that is not in the table. An empty slot is filled in
+	/// place, any other slot makes the bucket be replaced.
+	T& insertNew(size_t preHash, const bucket_entry<Key, T> &entry) {
+		++elementAmount;
+		if (++count >= M) {
+			rehashAll(&entry);
+			return writerTable().bucket(bucketIndexOf(preHash))->slot(preHash).value;
+		}
+		size_t bucketIndex = bucketIndexOf(preHash);
+		Bucket* bucket = writerTable().bucket(bucketIndex);
+		Slot& slot = bucket->slot(preHash);
+		const bucket_entry<Key, T>* added = &entry;
+		if (slot.state.load(std::memory_order_relaxed) == Slot::empty) {
+			slot.key = entry.getKey();
+			slot.value = entry.getValue();
+			slot.state.store(Slot::live, std::memory_order_release);
+			++bucket->elementAmount;
+			if (++bucket->b <= bucket->M) {
+				return slot.value;
+			}
+			added = nullptr;
+		} else {
+			++bucket->b;
+		}
+
+		// A collision or a full bucket: rebuild it, larger if it is full
+		common::rehash_trace::bucket_rehash();
+		size_t bucketM = bucket->M;
+		if (bucket->b > bucket->M) {
+			common::rehash_trace::bucket_resize();
+			bucketM *= _parameters.bucketCapacityFactor();
+			if (!globalConditionIsSatisfied(Bucket::calculateBucketLength(bucketM, _parameters), bucketIndex)) {
+				rehashAll(added);
+				return writerTable().bucket(bucketIndexOf(preHash))->slot(preHash).value;
+			}
+		}
+		std::vector<bucket_entry<Key, T>>& entries = rehash_scratch<Key, T>::local().entries;
+		entries.clear();
+		bucket->collect(entries);
+		if (added != nullptr) {
+			entries.push_back(*added);
+		}
+		replaceBucket(bucketIndex, new Bucket(entries.data(), entries.size(), bucketM, bucket->b,
+											  _parameters, randoms()));
+		return writerTable().bucket(bucketIndex)->slot(preHash).value;
+	}
+
+	size_t calculateM(size_t elements) {
+		return (1 + _parameters.tableCapacityFactor()) * std::max(elements, size_t(4));
+	}
+
+	size_t calculateBucketAmount(size_t elements) {
+		return std::max(size_t(10), elements / _parameters.elementAmountPerBucket());
+	}
+
+	bool globalConditionIsSatisfied(size_t bucketLengthOfBucketToResize,
+									size_t bucketIndexOfBucketToResize) {
+		const table& t = writerTable();
+		size_t lengthSum = 0;
+		for (size_t i = 0; i < t.buckets.size(); ++i) {
+			if (i == bucketIndexOfBucketToResize) {
+				lengthSum += bucketLengthOfBucketToResize;
+			} else {
+				lengthSum += t.bucket(i)->length;
+			}
+		}
+		return globalConditionIsSatisfied(lengthSum);
+	}
+
+	bool globalConditionIsSatisfied(size_t lengthSum) {
+		return lengthSum <= ((32 * M * M) / bucketAmount) + 4 * M;
+	}
+
+	/// Builds a new table from the live entries and added, if any, and
+	/// publishes it
+	void rehashAll(const bucket_entry<Key, T>* added) {
+		common::rehash_trace::scope trace;
+		common::rehash_trace::rehash();
+
+		std::vector<bucket_entry<Key, T>>& entries = rehashEntries;
+		entries.clear();
+		const table& old = writerTable();
+		for (size_t i = 0; i < old.buckets.size(); ++i) {
+			old.bucket(i)->collect(entries);
+		}
+		if (added != nullptr) {
+			entries.push_back(*added);
+		}
+
+		count = entries.size();
+		M = calculateM(count);
+		bucketAmount = calculateBucketAmount(M);
+
+		table* t = new table(bucketAmount);
+		bool isBalanced;
+		do {
+			t->bucketHashFunction.randomize(randoms, bucketAmount);
+			partition.build(entries, bucketAmount, [this, t](bucket_entry<Key, T>& entry) {
+				return t->bucketHashFunction(preHashFunction(entry.getKey()));
+			}, 1);
+			isBalanced = globalConditionIsSatisfied(partition.size());
+			if (!isBalanced) {
+				common::rehash_trace::retry();
+			}
+		} while (!isBalanced);
+
+		for (size_t i = 0; i < bucketAmount; ++i) {
+			t->buckets[i].store(new Bucket(partition.bucketEntries(i), partition.bucketSize(i), partition.bucketSize(i), 0,
+										   _parameters, randoms()), std::memory_order_relaxed);
+		}
+		publish(t);
+	}
+};
+
+}
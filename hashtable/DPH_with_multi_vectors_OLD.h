@@ -90,6 +90,14 @@ public:
 		}
 	}
 
+	const T* find_ptr(const Key &requestedKey) const {
+		if (initialized && !deleted && requestedKey == key) {
+			return &t;
+		} else {
+			return nullptr;
+		}
+	}
+
 	bool isInitialized() {
 		return initialized;
 	}
@@ -131,6 +139,10 @@ public:
 		size_t innerIndex = innerHashFcn(preHash);
 		return innerTable[innerIndex].find(key);
 	}
+	const T* find_ptr(size_t preHash, const Key &key) const {
+		size_t innerIndex = innerHashFcn(preHash);
+		return innerTable[innerIndex].find_ptr(key);
+	}
 	void increaseB() {
 		b++;
 	}
@@ -232,6 +244,12 @@ public:
 		return outerTable[subTableIndex].find(preHash, key);
     }
 
+    const T* find_ptr(const Key &key) const override {
+        size_t preHash = preHashFcn(key);
+		size_t subTableIndex = outerHashFcn(preHash);
+		return outerTable[subTableIndex].find_ptr(preHash, key);
+    }
+
     size_t erase(const Key &key) override {
 		count++;
 		size_t preHash = preHashFcn(key);
@@ -1,9 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
 #include "../common/contenders.h"
+#include "../common/hugepage_allocator.h"
 #include "hashtable.h"
 #include "DPH_Common.h"
 
@@ -11,6 +13,7 @@ using namespace common::monad;
 
 namespace hashtable {
 
+template <typename HashFamily = prime_modulo_family<>>
 class bucket_info {
 public:
 	size_t M;
@@ -18,17 +21,18 @@ public:
 	size_t start;
 	size_t length;
 	size_t elementAmount;
-	bucket_hash_function hashFunction;
+	typename HashFamily::function hashFunction;
 
-	bucket_info() : bucket_info(0, 0, 0, 0, 0, 0) { }
+	bucket_info() : M(0), b(0), start(0), length(0), elementAmount(0) { }
 
-	bucket_info(size_t bucketM, size_t bucketStart, size_t bucketLength, size_t random,  size_t random2, size_t prime) {
+	template <typename Random>
+	bucket_info(size_t bucketM, size_t bucketStart, size_t bucketLength, Random &randoms) {
 		M = bucketM;
 		b = 0;
 		start = bucketStart;
 		length = bucketLength;
 		elementAmount = 0;
-		hashFunction.setParameters(random, random2, prime, length);
+		hashFunction.randomize(randoms, length);
 	}
 
 	size_t index(size_t preHash) const {
@@ -39,12 +43,15 @@ public:
 };
 
 template <typename Key, typename T,
-		  typename PreHashFcn = std::hash<Key>>
+		  typename PreHashFcn = std::hash<Key>,
+		  typename HashFamily = prime_modulo_family<>,
+		  typename Allocator = std::allocator<bucket_entry<Key, T>>>
 class DPH_with_single_vector : public hashtable<Key, T> { // DPH = Dynamic Perfect Hashing
 private:
-	static const size_t c = 5;
+	using bucket_info = ::hashtable::bucket_info<HashFamily>;
+	using Entries = std::vector<bucket_entry<Key, T>, Allocator>;
 
-	rehash_counters rehashCounters;
+	static const size_t c = 5;
 
 	size_t M;
 	size_t count;
@@ -52,13 +59,22 @@ private:
 	size_t bucketAmount;
 	size_t _elementAmount;
 
-	prime_generator primes;
+	// Growing buckets that aren't at the end of entries move there instead
+	// of shifting every bucket behind them. Their old slots stay unused
+	// until the next global rehash.
+	bool _relocateGrowingBuckets;
+	size_t unusedLength;
+
 	random_generator randoms;
 	
 	PreHashFcn preHashFunction;
-	bucket_hash_function bucketHashFunction;
+	typename HashFamily::function bucketHashFunction;
 	std::vector<bucket_info> bucketInfos;
-	std::vector< bucket_entry< Key, T > > entries;
+	Entries entries;
+
+	// Buffers of rehashAll, kept so that later rehashes reuse their memory
+	std::vector<bucket_entry<Key, T>> rehashEntries;
+	bucket_partition<Key, T> partition;
 	
 public:
     virtual ~DPH_with_single_vector() = default;
@@ -72,36 +88,61 @@ public:
 				return new DPH_with_single_vector(initialElementAmount); 
 			}
         ));
+        list.register_contender(Factory("DPH_with_single_vector (relocating growth)", "DPH_with_single_vector-relocate",
+            [](){
+				size_t initialElementAmount = 1000;
+				return new DPH_with_single_vector(initialElementAmount, true);
+			}
+        ));
+        list.register_contender(Factory("DPH_with_single_vector (huge pages)", "DPH_with_single_vector-hugepages",
+            [](){
+				size_t initialElementAmount = 1000;
+				return new DPH_with_single_vector<Key, T, PreHashFcn, prime_modulo_family<>,
+												  common::hugepage_allocator<bucket_entry<Key, T>>>(initialElementAmount);
+			}
+        ));
+        list.register_contender(Factory("DPH_with_single_vector (hardware modulo)", "DPH_with_single_vector-hwmod",
+            [](){
+				size_t initialElementAmount = 1000;
+				return new DPH_with_single_vector<Key, T, PreHashFcn, prime_modulo_family<hardware_modulo>>(initialElementAmount);
+			}
+        ));
+        list.register_contender(Factory("DPH_with_single_vector (multiply-shift)", "DPH_with_single_vector-multshift",
+            [](){
+				size_t initialElementAmount = 1000;
+				return new DPH_with_single_vector<Key, T, PreHashFcn, multiply_shift_family>(initialElementAmount);
+			}
+        ));
+        list.register_contender(Factory("DPH_with_single_vector (tabulation)", "DPH_with_single_vector-tabulation",
+            [](){
+				size_t initialElementAmount = 1000;
+				return new DPH_with_single_vector<Key, T, PreHashFcn, tabulation_family>(initialElementAmount);
+			}
+        ));
     }
 	
-    DPH_with_single_vector(size_t initialElementAmount) :
+    DPH_with_single_vector(size_t initialElementAmount, bool relocateGrowingBuckets = false) :
     	hashtable<Key, T>(),
 		M(calculateM(initialElementAmount)),
 		count(0),
 		bucketAmount(calculateBucketAmount(initialElementAmount)),
 		_elementAmount(0),
-		primes(),
+		_relocateGrowingBuckets(relocateGrowingBuckets),
+		unusedLength(0),
 		randoms(),
     	bucketInfos(bucketAmount)
 	{
-		size_t prime = primes(initialElementAmount);
-		size_t random = randoms(1, prime - 1);
-		size_t random2 = randoms(1, prime - 1);
-		bucketHashFunction.setParameters(random, random2, prime, bucketAmount);
+		bucketHashFunction.randomize(randoms, bucketAmount);
 
 		size_t initialElementPerBucketAmount = initialElementAmount / bucketAmount;
 		size_t bucketM = std::max(size_t(10), initialElementPerBucketAmount);
 		size_t bucketLength = calculateBucketLength(bucketM);
-		size_t bucketPrime = primes(bucketLength);
 		for(size_t i = 0; i < bucketAmount; ++i) {
 			size_t bucketStart = i == 0 ? 0 : i * bucketLength;
-			size_t random = randoms(1, bucketPrime - 1);
-			size_t random2 = randoms(1, bucketPrime - 1);
-
-			bucketInfos[i] = bucket_info(bucketM, bucketStart, bucketLength, random, random2, bucketPrime);
+			bucketInfos[i] = bucket_info(bucketM, bucketStart, bucketLength, randoms);
 		}
 
-		entries = std::vector< bucket_entry< Key, T > >(bucketAmount * bucketLength);
+		entries = Entries(bucketAmount * bucketLength);
     }
 		
     T& operator[](const Key &key) override {
@@ -126,49 +167,21 @@ public:
 		}
 		bool wasRehashed = false;
 		if (count >= M) {
-			std::cout << "Rehash all count>=M: " << count << ">="<< M << "\n";
 			rehashAll(key);
 			wasRehashed = true;
 		} else if (bucket.b <= bucket.M and entry.getKey() != key) {
-			std::cout << "Rehashing bucket bucket.b <= bucket.M: " << bucket.b << "<="<< bucket.M << "\n";
 			rehashBucket(bucket, key);
 			wasRehashed= true;
 		} else if (bucket.b > bucket.M) {
 			size_t newBucketM = bucket.M * 2;
 			size_t newBucketLength = calculateBucketLength(newBucketM);
-			size_t lengthAddition = newBucketLength - bucket.length;
-			if (globalConditionIsSatisfied(newBucketLength, bucketIndex)) {
-				std::cout << "Resizing bucket bucket.b > bucket.M: " << bucket.b << ">"<< bucket.M << "\n";
-				++rehashCounters.resizeAndRehashBucketCounter;
-
-				size_t newEntriesLength = entries.size() + lengthAddition;
-				if (bucketIndex == bucketAmount - 1) {
-					// Special case for the last bucket, because no copying is necessary
-					entries.resize(newEntriesLength);
-					bucket.length = newBucketLength;
-					bucket.M = newBucketM;
-				} else {
-					// Resize the entries vector
-					std::vector<bucket_entry<Key, T>> tmp(std::make_move_iterator(entries.begin() + bucket.start + bucket.length + 1),
-														  std::make_move_iterator(entries.end()));
-					entries.erase(entries.begin() + bucket.start + bucket.length + 1,
-								  entries.end());
-					entries.resize(newEntriesLength);
-					std::copy(std::make_move_iterator(tmp.begin()), std::make_move_iterator(tmp.end()),
-							  entries.begin() + bucket.start + newBucketLength + 1);
-
-					// Updating the bucket infos
-					for (size_t i = bucketIndex + 1; i < bucketInfos.size(); ++i) {
-						bucket_info& info = bucketInfos[i];
-						info.start = info.start + lengthAddition;
-					}
-					bucket.length = newBucketLength;
-					bucket.M = newBucketM;
-				}
+			if (globalConditionIsSatisfied(newBucketLength, bucketIndex) && !tooManyUnusedSlots(bucket)) {
+				common::rehash_trace::bucket_resize();
+				growBucket(bucketIndex, newBucketLength);
+				bucket.M = newBucketM;
 				rehashBucket(bucket, key);
 			} else {
-				std::cout << "Rehash all instead of bucket resize\n";
-				rehashAll();
+				rehashAll(key);
 			}
 			wasRehashed = true;
 		}
@@ -195,13 +208,14 @@ public:
 		size_t preHash = preHashFunction(key);
 		size_t bucketIndex = bucketHashFunction(preHash);
 		size_t elementIndex = bucketInfos[bucketIndex].index(preHash);
-		bucket_entry<Key, T> entry = entries[elementIndex];
-		if (entry.isInitialized() and !entry.isDeleted()) {
-			// If this is not the case something with the dynamic rehashing didn't work out
-			assert(entry.getKey() == key);
-			return just<T>(entry.getValue());
-		}
-		return nothing<T>();
+		return entries[elementIndex].find(key);
+    }
+
+    const T* find_ptr(const Key &key) const override {
+		size_t preHash = preHashFunction(key);
+		size_t bucketIndex = bucketHashFunction(preHash);
+		size_t elementIndex = bucketInfos[bucketIndex].index(preHash);
+		return entries[elementIndex].find_ptr(key);
     }
 
     size_t erase(const Key &key) override {
@@ -211,9 +225,8 @@ public:
 		size_t elementIndex = bucket.index(preHash);
 		bucket_entry<Key, T>& entry = entries[elementIndex];
 
-		if (entry.isInitialized() and !entry.isDeleted()) {
-			// If this is not the case something with the dynamic rehashing didn't work out
-			assert(entry.getKey() == key);
+		// The slot may hold another key that the absent key's hash collides with
+		if (entry.isInitialized() and !entry.isDeleted() and entry.getKey() == key) {
 			entry.markDeleted();
 			--_elementAmount;
 			++count;
@@ -231,16 +244,42 @@ public:
 		return _elementAmount;
 	}
 
+    void inspect(common::structure_stats &stats) const override {
+		size_t lengthSum = 0;
+		for (size_t i = 0; i < bucketInfos.size(); ++i) {
+			const bucket_info& bucket = bucketInfos[i];
+			size_t tombstones = 0;
+			for (size_t j = bucket.start; j < bucket.start + bucket.length; ++j) {
+				tombstones += entries[j].isInitialized() && entries[j].isDeleted();
+			}
+			stats.add_bucket(bucket.length, bucket.elementAmount, tombstones);
+			lengthSum += bucket.length;
+		}
+		// Slots left behind by relocated buckets
+		stats.slots += entries.size() - lengthSum;
+		stats.bytes += sizeof(*this) + entries.capacity() * sizeof(bucket_entry<Key, T>)
+			+ bucketInfos.capacity() * sizeof(bucket_info);
+	}
+
     void clear() override { 
 		size_t entriesCapacity = entries.capacity();
-		entries = std::vector< bucket_entry< Key, T > >(entriesCapacity);
+		entries = Entries(entriesCapacity);
 		_elementAmount = 0;
 	}
 
-    rehash_counters& getRehashCounter() {
-    	return rehashCounters;
-    }
-
+    void seed(size_t seed) override {
+		randoms.seed(seed);
+		if (_elementAmount == 0) {
+			bucketHashFunction.randomize(randoms, bucketAmount);
+			for (size_t i = 0; i < bucketAmount; ++i) {
+				bucketInfos[i].hashFunction.randomize(randoms, bucketInfos[i].length);
+			}
+			entries.assign(entries.size(), bucket_entry<Key, T>());
+		} else {
+			rehashAll();
+		}
+    }
+
 private:
 	static size_t calculateM(size_t elementAmount) {
 		return (1 + c) * std::max(elementAmount, size_t(4));
@@ -251,7 +290,53 @@ private:
 	}
 
 	size_t calculateBucketLength(size_t bucketM) {
-		return bucketM * (bucketM - 1);
+		return HashFamily::length(bucketM * (bucketM - 1));
+	}
+
+	bool isAtEnd(const bucket_info& bucket) const {
+		return bucket.start + bucket.length == entries.size();
+	}
+
+	/// Whether relocating the bucket would leave more than half of the
+	/// entries unused, so that a global rehash should compact them instead
+	bool tooManyUnusedSlots(const bucket_info& bucket) const {
+		return _relocateGrowingBuckets && !isAtEnd(bucket)
+			&& 2 * (unusedLength + bucket.length) > entries.size();
+	}
+
+	/// Gives a bucket newBucketLength slots, keeping its entries within them.
+	/// The bucket at the end of the entries grows in place.
+	void growBucket(size_t bucketIndex, size_t newBucketLength) {
+		bucket_info& bucket = bucketInfos[bucketIndex];
+		size_t lengthAddition = newBucketLength - bucket.length;
+		if (isAtEnd(bucket)) {
+			entries.resize(entries.size() + lengthAddition);
+		} else if (_relocateGrowingBuckets) {
+			size_t newStart = entries.size();
+			entries.resize(newStart + newBucketLength);
+			auto oldEntries = entries.begin() + bucket.start;
+			std::move(oldEntries, oldEntries + bucket.length, entries.begin() + newStart);
+			std::fill(oldEntries, oldEntries + bucket.length, bucket_entry<Key, T>());
+			unusedLength += bucket.length;
+			bucket.start = newStart;
+		} else {
+			// Moving the entries behind the bucket
+			size_t newEntriesLength = entries.size() + lengthAddition;
+			std::vector<bucket_entry<Key, T>> tmp(std::make_move_iterator(entries.begin() + bucket.start + bucket.length),
+												  std::make_move_iterator(entries.end()));
+			entries.erase(entries.begin() + bucket.start + bucket.length,
+						  entries.end());
+			entries.resize(newEntriesLength);
+			std::copy(std::make_move_iterator(tmp.begin()), std::make_move_iterator(tmp.end()),
+					  entries.begin() + bucket.start + newBucketLength);
+
+			// Updating the bucket infos
+			for (size_t i = bucketIndex + 1; i < bucketInfos.size(); ++i) {
+				bucket_info& info = bucketInfos[i];
+				info.start = info.start + lengthAddition;
+			}
+		}
+		bucket.length = newBucketLength;
 	}
 
 	bool globalConditionIsSatisfied(size_t bucketLengthOfBucketToResize,
@@ -276,10 +361,12 @@ private:
 	}
 
 	void rehashBucket(bucket_info& bucket, const Key& key) {
-		++rehashCounters.rehashBucketCounter;
+		common::rehash_trace::scope trace;
+		common::rehash_trace::bucket_rehash();
+
 		// Collecting entries of the bucket
-		std::vector<bucket_entry<Key, T>> bucketEntries(bucket.elementAmount + 1);
-		size_t j = 0;
+		std::vector<bucket_entry<Key, T>>& bucketEntries = rehash_scratch<Key, T>::local().entries;
+		bucketEntries.clear();
 		bool includesNewKey = false;
 		for (size_t i = bucket.start; i < bucket.start + bucket.length; ++i) {
 			bucket_entry<Key, T>& entry = entries[i];
@@ -287,56 +374,44 @@ private:
 				if (entry.getKey() == key) {
 					includesNewKey = true;
 				}
-				bucketEntries[j] = entry;
-				++j;
+				bucketEntries.push_back(entry);
 			}
 			entries[i] = bucket_entry<Key, T>();
 		}
 		if (!includesNewKey) {
 			bucket_entry<Key, T> entry = bucket_entry<Key, T>();
 			entry.initialize(key);
-			bucketEntries[j] = entry;
-		} else {
-			bucketEntries.pop_back();
+			bucketEntries.push_back(entry);
+			++_elementAmount;
+			++count;
+			++bucket.b;
+			++bucket.elementAmount;
 		}
 
-		// Choose a new injective hash function randomly
+		insertBucket(bucket, bucketEntries.data(), bucketEntries.size());
+	}
+
+	/// Draws hash functions for the bucket until one is injective on its
+	/// entries, then places them
+	void insertBucket(bucket_info& bucket, const bucket_entry<Key, T>* bucketEntries, size_t amount) {
+		rehash_scratch<Key, T>& scratch = rehash_scratch<Key, T>::local();
+		scratch.preHash(bucketEntries, amount, preHashFunction);
 		bool isInjective;
 		do {
-			++rehashCounters.rehashBucketNewFunctionCounter;
-			std::cout << "rehashBucket: Creating new entry hash function" << "\n";
-
-			isInjective = true;
-			size_t prime = primes(bucket.length);
-			size_t random = randoms(1, prime - 1);
-			size_t random2 = randoms(1, prime - 1);
-			bucket.hashFunction.setParameters(random, random2, prime, bucket.length);
-
-			std::vector<size_t> indices = std::vector<size_t>(bucket.length);
-			for(size_t i = 0; i < bucketEntries.size(); ++i) {
-				bucket_entry<Key, T>& entry = bucketEntries[i];
-				if (entry.isInitialized()) {
-					size_t preHash = preHashFunction(entry.getKey());
-					size_t index = bucket.hashFunction(preHash);
-					if (indices[index] != 0) {
-						isInjective = false;
-						break;
-					} else {
-						indices[index] = 1;
-					}
-				}
+			bucket.hashFunction.randomize(randoms, bucket.length);
+			isInjective = scratch.isInjective(bucket.hashFunction, bucket.length);
+			if (!isInjective) {
+				common::rehash_trace::retry();
 			}
 		} while (!isInjective);
 		// Inserting the entries in the table
-		for(size_t i = 0; i < bucketEntries.size(); ++i) {
-			bucket_entry<Key, T> entry = bucketEntries[i];
-			size_t preHash = preHashFunction(entry.getKey());
-			size_t index = bucket.index(preHash);
-			entries[index] = entry;
+		for(size_t i = 0; i < amount; ++i) {
+			entries[bucket.start + scratch.slots[i]] = bucketEntries[i];
 		}
 	}
 
 	void rehashAll(const Key &key) {
+		common::rehash_trace::scope trace;
 		size_t preHash = preHashFunction(key);
 		size_t bucketIndex = bucketHashFunction(preHash);
 		bucket_info& bucket = bucketInfos[bucketIndex];
@@ -344,135 +419,84 @@ private:
 		bool hadCollision = entries[elementIndex].getKey() != key;
 
 		// Collecting entries of the bucket
-		std::vector<bucket_entry<Key, T>> elements(hadCollision ? _elementAmount + 1 : _elementAmount);
-		size_t j = 0;
-		for (size_t i = 0; i < entries.size(); ++i) {
-			bucket_entry<Key, T>& entry = entries[i];
-			if (entry.isInitialized() && !entry.isDeleted()) {
-				elements[j] = entry;
-				++j;
-			}
-		}
+		std::vector<bucket_entry<Key, T>>& elements = collectEntries();
 		if (hadCollision) {
 			//there was a collision. append current inserted element
 			bucket_entry<Key, T> entry = bucket_entry<Key, T>();
 			entry.initialize(key);
-			elements[j] = entry;
+			elements.push_back(entry);
 		}
 		rehashAll(elements);
 	}
 
 	void rehashAll() {
-		// Collecting entries of the bucket
-		std::vector<bucket_entry<Key, T>> elements(_elementAmount);
-		size_t j = 0;
+		common::rehash_trace::scope trace;
+		rehashAll(collectEntries());
+	}
+
+	/// The live entries of the table, in the rehash buffer
+	std::vector<bucket_entry<Key, T>>& collectEntries() {
+		std::vector<bucket_entry<Key, T>>& elements = rehashEntries;
+		elements.clear();
+		elements.reserve(_elementAmount + 1);
 		for (size_t i = 0; i < entries.size(); ++i) {
 			bucket_entry<Key, T>& entry = entries[i];
 			if (entry.isInitialized() && !entry.isDeleted()) {
-				elements[j] = entry;
-				++j;
+				elements.push_back(entry);
 			}
 		}
-		rehashAll(elements);
+		return elements;
 	}
 
 	void rehashAll(std::vector<bucket_entry<Key, T>>& elements) {
-		++rehashCounters.rehashAllCounter;
+		common::rehash_trace::scope trace;
+		common::rehash_trace::rehash();
 
+		_elementAmount = elements.size();
 		count = elements.size();
+		unusedLength = 0;
 		M = calculateM(count);
 		bucketAmount = calculateBucketAmount(M);
 
 		size_t lengthSum;
-		std::vector<std::vector<bucket_entry<Key, T>>> bucketedEntries;
+		bool isBalanced;
 		do {
-			++rehashCounters.rehashAllNewFunctionCounter;
-			std::cout << "rehashAll: Creating new bucket hash function" << "\n";
-
 			lengthSum = 0;
-			size_t prime = primes(count);
-			size_t random = randoms(1, prime - 1);
-			size_t random2 = randoms(1, prime - 1);
-			bucketHashFunction.setParameters(random, random2, prime, bucketAmount);
-
-			//Initializing helper vectors
-			bucketedEntries.clear();
-			bucketedEntries.resize(bucketAmount, std::vector<bucket_entry<Key, T>>(elements.size() / bucketAmount));
-			std::vector<size_t> bucketIndices(bucketAmount);
+			bucketHashFunction.randomize(randoms, bucketAmount);
 
 			//Collecting elements for the buckets with new bucket hash Function
-			for (size_t i = 0; i < elements.size(); ++i) {
-				bucket_entry<Key, T>& entry = elements[i];
-				size_t preHash = preHashFunction(entry.getKey());
-				size_t bucketIndex = bucketHashFunction(preHash);
-				std::vector<bucket_entry<Key, T>>& entriesForBucket = bucketedEntries[bucketIndex];
-				size_t& elementIndex = bucketIndices[bucketIndex];
-				if (elementIndex < entriesForBucket.size()) {
-					entriesForBucket[elementIndex] = entry;
-					++elementIndex;
-				} else {
-					entriesForBucket.push_back(entry);
-					++elementIndex;
-				}
-			}
+			partition.build(elements, bucketAmount, [this](bucket_entry<Key, T>& entry) {
+				return bucketHashFunction(preHashFunction(entry.getKey()));
+			}, 1);
 
 			//Updating the bucket infos
 			bucketInfos.clear();
 			bucketInfos.resize(bucketAmount);
 			for (size_t i = 0; i < bucketAmount; ++i) {
 				bucket_info& bucket = bucketInfos[i];
-				bucketedEntries[i].resize(bucketIndices[i]);
-				bucket.elementAmount = bucketedEntries[i].size();
+				bucket.elementAmount = partition.bucketSize(i);
 				if (i == 0) {
 					bucket.start = 0;
 				} else {
 					bucket.start = bucketInfos[i-1].start + bucketInfos[i-1].length;
 				}
-				bucket.b = bucketedEntries[i].size();
-				bucket.M = 2 * bucket.b;
+				bucket.b = partition.bucketSize(i);
+				bucket.M = std::max(size_t(2), 2 * bucket.b);
 				bucket.length = calculateBucketLength(bucket.M);
 				lengthSum += bucket.length;
 			}
-		} while (!globalConditionIsSatisfied());
+			isBalanced = globalConditionIsSatisfied();
+			if (!isBalanced) {
+				common::rehash_trace::retry();
+			}
+		} while (!isBalanced);
 
 		entries.clear();
 		entries.resize(lengthSum);
 
 		//Updating the buckets
 		for (size_t bucketIndex = 0; bucketIndex < bucketAmount; ++bucketIndex) {
-			bucket_info& bucket = bucketInfos[bucketIndex];
-			std::vector<bucket_entry<Key, T>>& entriesForBucket = bucketedEntries[bucketIndex];
-			// Choose a new injective hash function randomly
-			bool isInjective;
-			do {
-				++rehashCounters.rehashAllNewBucketFunctionCounter;
-				std::cout << "rehashAll: Creating new entry hash function for bucket " << bucketIndex << "\n";
-
-				isInjective = true;
-				size_t prime = primes(bucket.length);
-				size_t random = randoms(1, prime - 1);
-				size_t random2 = randoms(1, prime - 1);
-				bucket.hashFunction.setParameters(random, random2, prime, bucket.length);
-				std::vector<size_t> indices(bucket.length);
-				for(size_t i = 0; i < entriesForBucket.size(); ++i) {
-					bucket_entry<Key, T>& entry = entriesForBucket[i];
-					size_t preHash = preHashFunction(entry.getKey());
-					size_t index = bucket.hashFunction(preHash);
-					if (indices[index] != 0) {
-						isInjective = false;
-						break;
-					} else {
-						indices[index] = 1;
-					}
-				}
-			} while (!isInjective);
-			// Inserting the entries in the table
-			for(size_t i = 0; i < entriesForBucket.size(); ++i) {
-				bucket_entry<Key, T>& entry = entriesForBucket[i];
-				size_t preHash = preHashFunction(entry.getKey());
-				size_t index = bucket.index(preHash);
-				entries[index] = entry;
-			}
+			insertBucket(bucketInfos[bucketIndex], partition.bucketEntries(bucketIndex), partition.bucketSize(bucketIndex));
 		}
 	}
 };
@@ -0,0 +1,364 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "../common/contenders.h"
+#include "../common/rehash_stats.h"
+#include "hashtable.h"
+
+namespace hashtable {
+
+/// Cuckoo hashing (Pagh and Rodler 2001) with d choices (Fotakis et al.
+/// 2003) and a stash (Kirsch, Mitzenmacher and Wieder 2008). Every key lives
+/// in one of the Choices slots its hash functions pick, or in the small
+/// stash, so a lookup probes at most Choices slots and the stash.
+///
+/// An insert into a full set of slots searches breadth-first for the
+/// shortest chain of entries that can each move to another of their slots,
+/// ending at a free one, and shifts the chain along. If the search gives up,
+/// the key goes to the stash. A full stash rebuilds the table with new hash
+/// functions, at twice the size unless it is less than half full.
+///
+/// Displacements and stashed keys are reported through rehash_trace, next to
+/// the rebuilds.
+template <typename Key, typename T, size_t Choices = 2, typename PreHashFcn = std::hash<Key>>
+class cuckoo : public hashtable<Key, T> {
+    static_assert(Choices >= 2 && Choices <= 4, "cuckoo hashing needs 2 to 4 hash functions");
+private:
+    struct slot {
+        Key key;
+        T value;
+        bool used;
+
+        slot() : key(), value(), used(false) {}
+    };
+
+    /// A slot reached by the insertion search, and the node it came from
+    struct node {
+        size_t pos;
+        size_t parent;
+    };
+
+    static const size_t npos = size_t(-1);
+    static const size_t minCapacity = 8;
+    static const size_t stashCapacity = 4;
+    /// Slots the insertion search visits before the key goes to the stash
+    static const size_t maxSearch = 512;
+    /// Rebuilds at one capacity before it doubles anyway
+    static const size_t maxAttempts = 4;
+
+    PreHashFcn preHashFcn;
+    double maxLoad;
+    size_t initialCapacity;
+    std::mt19937_64 randoms;
+    std::array<uint64_t, Choices> multipliers, addends;
+
+    std::vector<slot> slots;
+    std::vector<slot> stash;
+    unsigned shift;
+    size_t live;
+    size_t maxUsed;
+    std::vector<node> search;
+
+public:
+    /// The load each number of choices sustains with few stashed keys
+    static constexpr double defaultMaxLoad() {
+        return Choices == 2 ? 0.45 : Choices == 3 ? 0.85 : 0.93;
+    }
+
+    cuckoo(size_t initialElementAmount = 0, double maxLoad = defaultMaxLoad()) :
+        preHashFcn(),
+        maxLoad(maxLoad),
+        initialCapacity(calculateCapacity(initialElementAmount)),
+        randoms(),
+        live(0) {
+        stash.reserve(stashCapacity);
+        drawFunctions();
+        allocate(initialCapacity);
+    }
+    virtual ~cuckoo() = default;
+
+    // Register all contenders in the list
+    static void register_contenders(common::contender_list<hashtable<Key, T>> &list) {
+        using Factory = common::contender_factory<hashtable<Key, T>>;
+        list.register_contender(Factory("cuckoo (2 choices)", "cuckoo-2",
+            [](){ return new cuckoo<Key, T, 2, PreHashFcn>(); }
+        ));
+        list.register_contender(Factory("cuckoo (3 choices)", "cuckoo-3",
+            [](){ return new cuckoo<Key, T, 3, PreHashFcn>(); }
+        ));
+        list.register_contender(Factory("cuckoo (4 choices)", "cuckoo-4",
+            [](){ return new cuckoo<Key, T, 4, PreHashFcn>(); }
+        ));
+    }
+
+    T& operator[](const Key &key) override {
+        slot* s = locate(key);
+        if (s == nullptr) {
+            s = insert(key);
+        }
+        return s->value;
+    }
+
+    T& operator[](Key &&key) override {
+        return (*this)[static_cast<const Key&>(key)];
+    }
+
+    maybe<T> find(const Key &key) const override {
+        const T* value = find_ptr(key);
+        if (value == nullptr) {
+            return nothing<T>();
+        }
+        return just<T>(*value);
+    }
+
+    const T* find_ptr(const Key &key) const override {
+        const slot* s = locate(key);
+        return s != nullptr ? &s->value : nullptr;
+    }
+
+    size_t erase(const Key &key) override {
+        slot* s = locate(key);
+        if (s == nullptr) {
+            return 0;
+        }
+        if (s >= stash.data() && s < stash.data() + stash.size()) {
+            if (s != &stash.back()) {
+                *s = std::move(stash.back());
+            }
+            stash.pop_back();
+        } else {
+            s->used = false;
+        }
+        --live;
+        return 1;
+    }
+
+    size_t size() const override {
+        return live;
+    }
+
+    void clear() override {
+        live = 0;
+        stash.clear();
+        allocate(initialCapacity);
+    }
+
+    /// Reseeds the generator and rebuilds the table with new hash functions
+    void seed(size_t seed) override {
+        randoms.seed(seed);
+        rehash(slots.size(), false);
+    }
+
+    void inspect(common::structure_stats &stats) const override {
+        stats.slots += slots.size() + stashCapacity;
+        stats.entries += live;
+        stats.bytes += sizeof(*this) + (slots.size() + stashCapacity) * sizeof(slot)
+            + search.capacity() * sizeof(node);
+    }
+
+private:
+    size_t calculateCapacity(size_t elementAmount) const {
+        size_t capacity = minCapacity;
+        while (capacity * maxLoad < elementAmount + 1) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    void allocate(size_t capacity) {
+        slots.assign(capacity, slot());
+        shift = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) {
+            --shift;
+        }
+        maxUsed = static_cast<size_t>(capacity * maxLoad);
+    }
+
+    /// Multiply-add-shift hash functions, one per choice
+    void drawFunctions() {
+        for (size_t i = 0; i < Choices; ++i) {
+            multipliers[i] = randoms() | 1;
+            addends[i] = randoms();
+        }
+    }
+
+    size_t position(size_t i, uint64_t preHash) const {
+        return static_cast<size_t>((preHash * multipliers[i] + addends[i]) >> shift);
+    }
+
+    const slot* locate(const Key &key) const {
+        uint64_t preHash = preHashFcn(key);
+        for (size_t i = 0; i < Choices; ++i) {
+            const slot &s = slots[position(i, preHash)];
+            if (s.used && s.key == key) {
+                return &s;
+            }
+        }
+        for (const slot &s : stash) {
+            if (s.key == key) {
+                return &s;
+            }
+        }
+        return nullptr;
+    }
+
+    slot* locate(const Key &key) {
+        return const_cast<slot*>(static_cast<const cuckoo*>(this)->locate(key));
+    }
+
+    slot* insert(const Key &key) {
+        if (live + 1 > maxUsed) {
+            rehash(2 * slots.size(), false);
+        }
+        slot entry;
+        entry.key = key;
+        entry.used = true;
+        ++live;
+        slot* s = place(entry);
+        if (s == nullptr) {
+            if (stash.size() < stashCapacity) {
+                common::rehash_trace::stash();
+                stash.push_back(std::move(entry));
+                return &stash.back();
+            }
+            rehash(2 * slots.size(), true, &entry);
+            s = locate(key);
+        }
+        return s;
+    }
+
+    /// Moves entry into one of its slots, shifting the shortest chain of
+    /// other entries found by breadth-first search. Returns the slot, or
+    /// nullptr if the search gave up and entry is untouched.
+    slot* place(slot &entry) {
+        uint64_t preHash = preHashFcn(entry.key);
+        search.clear();
+        for (size_t i = 0; i < Choices; ++i) {
+            size_t pos = position(i, preHash);
+            if (!slots[pos].used) {
+                slots[pos] = std::move(entry);
+                return &slots[pos];
+            }
+            search.push_back(node{pos, npos});
+        }
+        for (size_t n = 0; n < search.size(); ++n) {
+            size_t pos = search[n].pos;
+            uint64_t occupantHash = preHashFcn(slots[pos].key);
+            for (size_t i = 0; i < Choices; ++i) {
+                size_t next = position(i, occupantHash);
+                if (onChain(n, next)) {
+                    continue;
+                }
+                if (!slots[next].used) {
+                    return shiftChain(n, next, entry);
+                }
+                if (search.size() < maxSearch) {
+                    search.push_back(node{next, n});
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    /// Whether pos is on the chain from the key to search node n. A chain
+    /// must not visit a slot twice, as its entry would move twice.
+    bool onChain(size_t n, size_t pos) const {
+        for (; n != npos; n = search[n].parent) {
+            if (search[n].pos == pos) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Moves every entry on the chain ending in search node n one step on,
+    /// the last one into the free slot, and entry into the first
+    slot* shiftChain(size_t n, size_t free, slot &entry) {
+        size_t moved = 0;
+        for (; n != npos; n = search[n].parent) {
+            slots[free] = std::move(slots[search[n].pos]);
+            free = search[n].pos;
+            ++moved;
+        }
+        common::rehash_trace::displace(moved);
+        slots[free] = std::move(entry);
+        return &slots[free];
+    }
+
+    /// Rebuilds the table with new hash functions from its entries and
+    /// pending, if given. grow asks for twice the capacity, which is only
+    /// taken if the table is at least half full. Throws, leaving the table
+    /// empty, if the keys don't fit into a table far larger than they need.
+    void rehash(size_t capacity, bool grow, slot* pending = nullptr) {
+        common::rehash_trace::scope scope;
+        common::rehash_trace::rehash();
+        if (grow && live <= maxUsed / 2) {
+            capacity = slots.size();
+        }
+        std::vector<slot> entries;
+        entries.reserve(live);
+        for (slot &s : slots) {
+            if (s.used) {
+                entries.push_back(std::move(s));
+            }
+        }
+        for (slot &s : stash) {
+            entries.push_back(std::move(s));
+        }
+        if (pending != nullptr) {
+            entries.push_back(std::move(*pending));
+        }
+        stash.clear();
+        for (size_t attempt = 1; ; ++attempt) {
+            drawFunctions();
+            allocate(capacity);
+            if (placeAll(entries)) {
+                return;
+            }
+            // Too many failed: take everything back and try other functions
+            common::rehash_trace::retry();
+            for (slot &s : slots) {
+                if (s.used) {
+                    entries.push_back(std::move(s));
+                }
+            }
+            for (slot &s : stash) {
+                entries.push_back(std::move(s));
+            }
+            stash.clear();
+            if (live > maxUsed / 2 || attempt % maxAttempts == 0) {
+                capacity *= 2;
+            }
+            if (capacity / maxSearch > live) {
+                live = 0;
+                allocate(initialCapacity);
+                throw std::length_error("cuckoo: the hash functions cannot tell the keys apart");
+            }
+        }
+    }
+
+    /// Places the entries, stashing the ones that don't fit. Returns false,
+    /// with the entries not placed left in entries, if the stash overflows.
+    bool placeAll(std::vector<slot> &entries) {
+        while (!entries.empty()) {
+            slot &entry = entries.back();
+            if (place(entry) == nullptr) {
+                if (stash.size() == stashCapacity) {
+                    return false;
+                }
+                stash.push_back(std::move(entry));
+            }
+            entries.pop_back();
+        }
+        return true;
+    }
+};
+
+}
@@ -0,0 +1,520 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "../common/aligned_allocator.h"
+#include "../common/contenders.h"
+#include "../common/rehash_stats.h"
+#include "hashtable.h"
+
+namespace hashtable {
+
+/// Cuckoo hashing with pages (Dietzfelbinger, Mitzenmacher and Rink 2011).
+/// The table is an array of pages of PageLines cache lines, each holding
+/// buckets of SlotsPerBucket entries. A key has a primary page and two
+/// buckets on it, so most lookups touch a single page: with one-line pages a
+/// single cache line, with 64-line pages a single 4 KiB TLB page.
+///
+/// Inserts that find both buckets full move other entries between their two
+/// buckets of the same page, along the shortest chain a breadth-first search
+/// finds. If the page is too full, the key goes to two buckets on its backup
+/// page, and its primary page counts it, so that lookups only visit the
+/// backup page of pages that overflowed. If that is full too, a random walk
+/// moves entries to their other page, and the key it ends with goes to a
+/// small stash. A full stash rebuilds the table at twice the size.
+///
+/// Each bucket keeps its size, keys and values together, so a lookup reads
+/// one or two lines of the page for each bucket.
+template <typename Key, typename T,
+          size_t PageLines = 1,
+          size_t SlotsPerBucket = 3,
+          typename PreHashFcn = std::hash<Key>>
+class cuckoo_pages : public hashtable<Key, T> {
+    static_assert((PageLines & (PageLines - 1)) == 0, "pages must be a power of two of cache lines");
+    static_assert(SlotsPerBucket >= 1 && SlotsPerBucket < 256, "bucket sizes are stored in a byte");
+private:
+    struct bucket {
+        uint8_t count;
+        Key keys[SlotsPerBucket];
+        T values[SlotsPerBucket];
+
+        bucket() : count(0), keys(), values() {}
+    };
+
+public:
+    static const size_t lineSize = 64;
+    static const size_t pageSize = PageLines * lineSize;
+    /// The buckets that fit on a page next to its overflow count
+    static const size_t bucketsPerPage = (pageSize - 1) / sizeof(bucket);
+
+    static_assert(bucketsPerPage >= 2, "a page needs room for at least two buckets");
+
+private:
+    /// Pages start on a boundary of their size, up to a 4 KiB page
+    static const size_t pageAlignment = pageSize < 4096 ? pageSize : 4096;
+
+    struct alignas(pageAlignment) page {
+        bucket buckets[bucketsPerPage];
+        uint8_t overflow; ///< keys of this page that live on their backup page, saturating
+
+        page() : buckets(), overflow(0) {}
+    };
+    static_assert(sizeof(page) <= pageSize, "a page must fit into its cache lines");
+
+    struct entry {
+        Key key;
+        T value;
+    };
+
+    /// A key's page and its two buckets there
+    struct choice {
+        size_t page;
+        size_t first, second;
+    };
+
+    /// Where the insertion search reached a bucket from: the bucket and
+    /// slot of the entry that would move into it
+    struct step {
+        size_t bucket;
+        size_t slot;
+    };
+
+    static const size_t npos = size_t(-1);
+    static const size_t minPages = 2;
+    static const size_t stashCapacity = 4;
+    static const uint8_t saturated = 255;
+    /// Entries the insertion moves between pages before it gives up
+    static const size_t maxWalk = 64;
+
+    using Pages = std::vector<page, common::aligned_allocator<page, pageAlignment>>;
+
+    PreHashFcn preHashFcn;
+    double maxLoad;
+    size_t initialPages;
+    std::mt19937_64 randoms;
+    /// Per side (primary, backup): the multipliers for the page and buckets
+    std::array<uint64_t, 2> pageMultipliers, bucketMultipliers;
+
+    Pages pages;
+    std::vector<entry> stash;
+    unsigned pageShift;
+    size_t live;
+    size_t maxUsed;
+
+    std::vector<step> from;
+    std::vector<size_t> queue;
+
+public:
+    /// The load the pages sustain with few stashed keys. Pages of one line
+    /// have room for a handful of entries, so they overflow earlier.
+    static constexpr double defaultMaxLoad() {
+        return PageLines == 1 ? 0.85 : 0.95;
+    }
+
+    cuckoo_pages(size_t initialElementAmount = 0, double maxLoad = defaultMaxLoad()) :
+        preHashFcn(),
+        maxLoad(maxLoad),
+        initialPages(calculatePages(initialElementAmount)),
+        randoms(),
+        live(0) {
+        stash.reserve(stashCapacity);
+        drawFunctions();
+        allocate(initialPages);
+    }
+    virtual ~cuckoo_pages() = default;
+
+    // Register all contenders in the list
+    static void register_contenders(common::contender_list<hashtable<Key, T>> &list) {
+        using Factory = common::contender_factory<hashtable<Key, T>>;
+        list.register_contender(Factory("cuckoo with pages (1 cache line, 3 slots per bucket)", "cuckoo-pages-1-3",
+            [](){ return new cuckoo_pages<Key, T, 1, 3, PreHashFcn>(); }
+        ));
+        list.register_contender(Factory("cuckoo with pages (8 cache lines, 3 slots per bucket)", "cuckoo-pages-8-3",
+            [](){ return new cuckoo_pages<Key, T, 8, 3, PreHashFcn>(); }
+        ));
+        list.register_contender(Factory("cuckoo with pages (64 cache lines, 4 slots per bucket)", "cuckoo-pages-64-4",
+            [](){ return new cuckoo_pages<Key, T, 64, 4, PreHashFcn>(); }
+        ));
+    }
+
+    T& operator[](const Key &key) override {
+        T* value = const_cast<T*>(find_ptr(key));
+        if (value == nullptr) {
+            value = insert(key);
+        }
+        return *value;
+    }
+
+    T& operator[](Key &&key) override {
+        return (*this)[static_cast<const Key&>(key)];
+    }
+
+    maybe<T> find(const Key &key) const override {
+        const T* value = find_ptr(key);
+        if (value == nullptr) {
+            return nothing<T>();
+        }
+        return just<T>(*value);
+    }
+
+    const T* find_ptr(const Key &key) const override {
+        uint64_t preHash = preHashFcn(key);
+        choice primary = choose(0, preHash);
+        const page &p = pages[primary.page];
+        const T* value = findOnPage(p, primary, key);
+        if (value == nullptr && p.overflow != 0) {
+            choice backup = choose(1, preHash);
+            value = findOnPage(pages[backup.page], backup, key);
+        }
+        if (value == nullptr) {
+            for (const entry &e : stash) {
+                if (e.key == key) {
+                    return &e.value;
+                }
+            }
+        }
+        return value;
+    }
+
+    size_t erase(const Key &key) override {
+        uint64_t preHash = preHashFcn(key);
+        for (size_t side = 0; side < 2; ++side) {
+            choice c = choose(side, preHash);
+            page &p = pages[c.page];
+            for (size_t b : {c.first, c.second}) {
+                bucket &bucket = p.buckets[b];
+                for (size_t s = 0; s < bucket.count; ++s) {
+                    if (bucket.keys[s] == key) {
+                        removeFromBucket(bucket, s);
+                        if (side == 1) {
+                            countBackup(preHash, false);
+                        }
+                        --live;
+                        return 1;
+                    }
+                }
+            }
+            if (p.overflow == 0) {
+                break;
+            }
+        }
+        for (entry &e : stash) {
+            if (e.key == key) {
+                if (&e != &stash.back()) {
+                    e = std::move(stash.back());
+                }
+                stash.pop_back();
+                --live;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    size_t size() const override {
+        return live;
+    }
+
+    void clear() override {
+        live = 0;
+        stash.clear();
+        allocate(initialPages);
+    }
+
+    /// Reseeds the generator and rebuilds the table with new hash functions
+    void seed(size_t seed) override {
+        randoms.seed(seed);
+        rehash(pages.size());
+    }
+
+    /// Every bucket counts as a bucket, the stash as slots without one
+    void inspect(common::structure_stats &stats) const override {
+        for (const page &p : pages) {
+            for (const bucket &b : p.buckets) {
+                stats.add_bucket(SlotsPerBucket, b.count, 0);
+            }
+        }
+        stats.slots += stashCapacity;
+        stats.entries += stash.size();
+        stats.bytes += sizeof(*this) + pages.size() * sizeof(page) + stashCapacity * sizeof(entry);
+    }
+
+private:
+    size_t calculatePages(size_t elementAmount) const {
+        size_t amount = minPages;
+        while (amount * bucketsPerPage * SlotsPerBucket * maxLoad < elementAmount + 1) {
+            amount *= 2;
+        }
+        return amount;
+    }
+
+    void allocate(size_t amount) {
+        pages.assign(amount, page());
+        pageShift = 64;
+        for (size_t a = amount; a > 1; a >>= 1) {
+            --pageShift;
+        }
+        maxUsed = static_cast<size_t>(amount * bucketsPerPage * SlotsPerBucket * maxLoad);
+    }
+
+    void drawFunctions() {
+        for (size_t side = 0; side < 2; ++side) {
+            pageMultipliers[side] = randoms() | 1;
+            bucketMultipliers[side] = randoms() | 1;
+        }
+    }
+
+    /// The page and buckets of a key on its primary (0) or backup (1) side.
+    /// The backup page always differs from the primary one, and the two
+    /// buckets on a page differ.
+    choice choose(size_t side, uint64_t preHash) const {
+        choice c;
+        c.page = static_cast<size_t>((preHash * pageMultipliers[side]) >> pageShift);
+        if (side == 1) {
+            size_t primary = static_cast<size_t>((preHash * pageMultipliers[0]) >> pageShift);
+            if (c.page == primary) {
+                c.page ^= 1;
+            }
+        }
+        uint64_t h = preHash * bucketMultipliers[side];
+        c.first = static_cast<size_t>(((h >> 48) * bucketsPerPage) >> 16);
+        c.second = static_cast<size_t>((((h >> 32) & 0xffff) * bucketsPerPage) >> 16);
+        if (c.second == c.first) {
+            c.second = (c.first + 1) % bucketsPerPage;
+        }
+        return c;
+    }
+
+    /// Fetches the second bucket while the first is scanned, as on pages of
+    /// several lines it is mostly on another line
+    const T* findOnPage(const page &p, const choice &c, const Key &key) const {
+        __builtin_prefetch(&p.buckets[c.second]);
+        const T* value = findInBucket(p.buckets[c.first], key);
+        return value != nullptr ? value : findInBucket(p.buckets[c.second], key);
+    }
+
+    const T* findInBucket(const bucket &b, const Key &key) const {
+        for (size_t s = 0; s < b.count; ++s) {
+            if (b.keys[s] == key) {
+                return &b.values[s];
+            }
+        }
+        return nullptr;
+    }
+
+    /// Fills the gap with the last entry of the bucket
+    void removeFromBucket(bucket &b, size_t s) {
+        size_t last = b.count - 1;
+        if (s != last) {
+            b.keys[s] = std::move(b.keys[last]);
+            b.values[s] = std::move(b.values[last]);
+        }
+        --b.count;
+    }
+
+    T* insert(const Key &key) {
+        if (live + 1 > maxUsed) {
+            rehash(2 * pages.size());
+        }
+        entry e;
+        e.key = key;
+        e.value = T();
+        ++live;
+        if (!place(e)) {
+            if (stash.size() < stashCapacity) {
+                common::rehash_trace::stash();
+                stash.push_back(std::move(e));
+            } else {
+                rehash(2 * pages.size(), &e);
+            }
+        }
+        // The walk may have left another key homeless, so look ours up
+        return const_cast<T*>(find_ptr(key));
+    }
+
+    /// Moves e onto its primary page, or else its backup page. If both are
+    /// full, e takes the place of an entry on one of them, which moves on to
+    /// its other page, and so on for up to maxWalk steps. Returns false,
+    /// with the entry left homeless in e, if the walk gives up.
+    bool place(entry &e) {
+        uint64_t preHash = preHashFcn(e.key);
+        if (placeOnPage(choose(0, preHash), e)) {
+            return true;
+        }
+        for (size_t side = 1, step = 0; ; ++step) {
+            choice c = choose(side, preHash);
+            if (placeOnPage(c, e)) {
+                if (side == 1) {
+                    countBackup(preHash, true);
+                }
+                return true;
+            }
+            if (step == maxWalk) {
+                return false;
+            }
+            // Both buckets are full: swap e with a random entry of them
+            bucket &b = pages[c.page].buckets[(randoms() & 1) ? c.first : c.second];
+            size_t s = randoms() % SlotsPerBucket;
+            std::swap(e.key, b.keys[s]);
+            std::swap(e.value, b.values[s]);
+            common::rehash_trace::displace(1);
+            if (side == 1) {
+                countBackup(preHash, true);
+            }
+            preHash = preHashFcn(e.key);
+            if (choose(0, preHash).page == c.page) {
+                side = 1;
+            } else {
+                countBackup(preHash, false);
+                side = 0;
+            }
+        }
+    }
+
+    /// Counts a key of the primary page of preHash moving to or away from
+    /// its backup page. A saturated count stays, as it lost track.
+    void countBackup(uint64_t preHash, bool added) {
+        page &p = pages[choose(0, preHash).page];
+        if (p.overflow != saturated) {
+            p.overflow += added ? 1 : -1;
+        }
+    }
+
+    /// Moves e into one of its buckets on the page, if need be after moving
+    /// other entries to their other bucket there. Returns false, with e
+    /// untouched, if no bucket the entries can move to has room.
+    bool placeOnPage(const choice &c, entry &e) {
+        page &p = pages[c.page];
+        size_t b = p.buckets[c.second].count < p.buckets[c.first].count ? c.second : c.first;
+        if (p.buckets[b].count < SlotsPerBucket) {
+            store(p.buckets[b], p.buckets[b].count++, e);
+            return true;
+        }
+        // Both buckets are full: search the page for the closest bucket with
+        // room that the entries can be moved towards
+        const step root{npos, 0}, unvisited{npos, npos};
+        from.assign(bucketsPerPage, unvisited);
+        from[c.first] = from[c.second] = root;
+        queue.clear();
+        queue.push_back(c.first);
+        queue.push_back(c.second);
+        for (size_t q = 0; q < queue.size(); ++q) {
+            b = queue[q];
+            for (size_t s = 0; s < SlotsPerBucket; ++s) {
+                size_t next = alternative(p.buckets[b].keys[s], c.page, b);
+                if (from[next].bucket != npos || from[next].slot != npos) {
+                    continue;
+                }
+                from[next] = step{b, s};
+                if (p.buckets[next].count < SlotsPerBucket) {
+                    shiftChain(p, next, e);
+                    return true;
+                }
+                queue.push_back(next);
+            }
+        }
+        return false;
+    }
+
+    /// The other bucket of key, which is in bucket b of page pageIndex
+    size_t alternative(const Key &key, size_t pageIndex, size_t b) const {
+        uint64_t preHash = preHashFcn(key);
+        choice c = choose(0, preHash);
+        if (c.page != pageIndex) {
+            c = choose(1, preHash);
+        }
+        return c.first == b ? c.second : c.first;
+    }
+
+    /// Moves the entries on the chain to bucket b one bucket on, the last
+    /// one into b's free slot, and e into the gap left in its own bucket
+    void shiftChain(page &p, size_t b, entry &e) {
+        size_t s = p.buckets[b].count++;
+        size_t moved = 0;
+        while (from[b].bucket != npos) {
+            bucket &source = p.buckets[from[b].bucket];
+            p.buckets[b].keys[s] = std::move(source.keys[from[b].slot]);
+            p.buckets[b].values[s] = std::move(source.values[from[b].slot]);
+            s = from[b].slot;
+            b = from[b].bucket;
+            ++moved;
+        }
+        common::rehash_trace::displace(moved);
+        store(p.buckets[b], s, e);
+    }
+
+    void store(bucket &b, size_t s, entry &e) {
+        b.keys[s] = std::move(e.key);
+        b.values[s] = std::move(e.value);
+    }
+
+    /// Rebuilds the table with new hash functions from its entries and
+    /// pending, if given, doubling the pages until the stash holds what
+    /// doesn't fit. Throws, leaving the table empty, if the keys don't fit
+    /// into a table far larger than they need.
+    void rehash(size_t amount, entry* pending = nullptr) {
+        common::rehash_trace::scope scope;
+        common::rehash_trace::rehash();
+        std::vector<entry> entries;
+        entries.reserve(live);
+        if (pending != nullptr) {
+            entries.push_back(std::move(*pending));
+        }
+        for (;;) {
+            takeEntries(entries);
+            drawFunctions();
+            allocate(amount);
+            if (placeAll(entries)) {
+                return;
+            }
+            common::rehash_trace::retry();
+            amount *= 2;
+            if (amount * bucketsPerPage * SlotsPerBucket / 1024 > live) {
+                live = 0;
+                stash.clear();
+                allocate(initialPages);
+                throw std::length_error("cuckoo_pages: the hash functions cannot tell the keys apart");
+            }
+        }
+    }
+
+    /// Moves all entries of the pages and the stash to entries
+    void takeEntries(std::vector<entry> &entries) {
+        for (page &p : pages) {
+            for (bucket &b : p.buckets) {
+                for (size_t s = 0; s < b.count; ++s) {
+                    entries.push_back(entry{std::move(b.keys[s]), std::move(b.values[s])});
+                }
+                b.count = 0;
+            }
+        }
+        for (entry &e : stash) {
+            entries.push_back(std::move(e));
+        }
+        stash.clear();
+    }
+
+    /// Places the entries, stashing the ones that don't fit. Returns false,
+    /// with the entries not placed left in entries, if the stash overflows.
+    bool placeAll(std::vector<entry> &entries) {
+        while (!entries.empty()) {
+            entry &e = entries.back();
+            if (!place(e)) {
+                if (stash.size() == stashCapacity) {
+                    return false;
+                }
+                stash.push_back(std::move(e));
+            }
+            entries.pop_back();
+        }
+        return true;
+    }
+};
+
+}
@@ -5,6 +5,7 @@
 #include <sparsehash/dense_hash_map>
 
 #include "../common/contenders.h"
+#include "../common/hugepage_allocator.h"
 #include "hashtable.h"
 
 namespace hashtable {
@@ -30,6 +31,10 @@ public:
         list.register_contender(Factory("dense_hash_map", "dense-hash-map",
             [](){ return new dense_hash_map<Key, T>(); }
         ));
+        list.register_contender(Factory("dense_hash_map with huge pages", "dense-hash-map-hugepages",
+            [](){ return new dense_hash_map<Key, T, std::hash<Key>, std::equal_to<Key>,
+                                            common::hugepage_allocator<std::pair<const Key, T>>>(); }
+        ));
         //list.register_contender(Factory("dense_hash_map with std::allocator", "dense_hash_map std_allocator",
         //    [](){ return new dense_hash_map<Key, T, std::hash<Key>, std::equal_to<Key>, std::allocator<std::pair<const Key, T>>>(); }
         //));
@@ -53,6 +58,15 @@ public:
         }
     }
 
+    const T* find_ptr(const Key &key) const override {
+        auto it = map.find(key);
+        if (it == map.end()) {
+            return nullptr;
+        } else {
+            return &it->second;
+        }
+    }
+
     size_t erase(const Key &key) override {
         return map.erase(key);
     }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../common/maybe.h"
+#include "../common/structure_stats.h"
 
 using namespace common::monad;
 
@@ -22,9 +23,40 @@ public:
     /// Retrieve a key's value by rvalue reference, or insert a default-constructed value if not found
     virtual T& operator[](Key &&key) = 0;
 
+    /// Insert the key/value pairs of a range, a later pair overwriting an
+    /// earlier one with the same key. Tables that can build themselves in one
+    /// pass override this.
+    virtual void bulk_insert(const value_type* first, const value_type* last) {
+        for (; first != last; ++first) {
+            (*this)[first->first] = first->second;
+        }
+    }
+
+    /// Set a key's value, inserting the key if not found. Tables that
+    /// support concurrent_reads override this, as writing through
+    /// operator[]'s reference may race with their readers.
+    virtual void insert_or_assign(const Key &key, const T &value) {
+        (*this)[key] = value;
+    }
+
     /// Find a key in the hash table
     virtual maybe<T> find(const Key &key) const = 0;
 
+    /// Find a key's value without copying it, nullptr if not found. The
+    /// pointer is invalidated by the next modification of the table.
+    virtual const T* find_ptr(const Key &key) const = 0;
+
+    /// Whether the hash table contains a key
+    virtual bool contains(const Key &key) const {
+        return find_ptr(key) != nullptr;
+    }
+
+    /// Whether find and contains may run on other threads while one thread
+    /// modifies the table. The concurrent benchmarks lock all other tables.
+    virtual bool concurrent_reads() const {
+        return false;
+    }
+
     /// Erases all elements with the given key
     /// Returns the number of elements removed
     virtual size_t erase(const Key &key) = 0;
@@ -35,6 +67,17 @@ public:
     /// Clear the hash table
     virtual void clear() = 0;
 
+    /// Seed the random generator that draws the table's hash functions, so
+    /// that runs are reproducible. Tables without one ignore the seed.
+    virtual void seed(size_t) {}
+
+    /// Report where the table's space goes: slots, live entries, tombstones,
+    /// bytes and the bucket sizes. Tables that don't break it down only
+    /// report their entries.
+    virtual void inspect(common::structure_stats &stats) const {
+        stats.entries += size();
+    }
+
     /// Virtual destructor to allow destruction through derived pointer
     virtual ~hashtable() {}
 };
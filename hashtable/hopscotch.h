@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../common/contenders.h"
+#include "hashtable.h"
+
+namespace hashtable {
+
+/// Hopscotch hashing (Herlihy, Shavit and Tzafrir 2008). Every key lives
+/// within Neighborhood slots of its home slot, and the home slot keeps a
+/// bitmap of which of them hold its keys, so a lookup only compares the
+/// keys the bitmap names and never probes further. An insert takes the
+/// closest free slot; if that is too far from home, entries between the two
+/// hop closer to the free slot, within their own neighborhoods, until the
+/// free slot is in reach. If no entry can hop, the table doubles.
+///
+/// The last home slot's neighborhood runs into Neighborhood - 1 extra slots
+/// at the end, instead of wrapping around.
+template <typename Key, typename T,
+          size_t Neighborhood = 32,
+          typename PreHashFcn = std::hash<Key>>
+class hopscotch : public hashtable<Key, T> {
+    static_assert(Neighborhood == 32 || Neighborhood == 64, "neighborhoods have 32 or 64 slots");
+private:
+    using Bitmap = typename std::conditional<Neighborhood == 32, uint32_t, uint64_t>::type;
+
+    struct slot {
+        Bitmap hops; ///< bit i: slot home + i holds a key of this home
+        bool full;
+        Key key;
+        T value;
+
+        slot() : hops(0), full(false), key(), value() {}
+    };
+
+    struct entry {
+        Key key;
+        T value;
+    };
+
+    static const size_t npos = size_t(-1);
+    static const size_t minCapacity = 8;
+    /// How far an insert looks for a free slot before it grows the table
+    static const size_t maxProbe = 8 * Neighborhood;
+
+    PreHashFcn preHashFcn;
+    double maxLoad;
+    size_t initialCapacity;
+    uint64_t multiplier;
+
+    std::vector<slot> slots;
+    unsigned shift;
+    size_t live;
+    size_t maxUsed;
+
+public:
+    hopscotch(size_t initialElementAmount = 0, double maxLoad = 0.9) :
+        preHashFcn(),
+        maxLoad(maxLoad),
+        initialCapacity(calculateCapacity(initialElementAmount)),
+        multiplier(0x9e3779b97f4a7c15ULL),
+        live(0) {
+        allocate(initialCapacity);
+    }
+    virtual ~hopscotch() = default;
+
+    // Register all contenders in the list
+    static void register_contenders(common::contender_list<hashtable<Key, T>> &list) {
+        using Factory = common::contender_factory<hashtable<Key, T>>;
+        list.register_contender(Factory("hopscotch (neighborhood 32)", "hopscotch-32",
+            [](){ return new hopscotch<Key, T, 32, PreHashFcn>(); }
+        ));
+        list.register_contender(Factory("hopscotch (neighborhood 64)", "hopscotch-64",
+            [](){ return new hopscotch<Key, T, 64, PreHashFcn>(); }
+        ));
+    }
+
+    T& operator[](const Key &key) override {
+        return slots[insert(key)].value;
+    }
+
+    T& operator[](Key &&key) override {
+        return slots[insert(key)].value;
+    }
+
+    maybe<T> find(const Key &key) const override {
+        const T* value = find_ptr(key);
+        if (value == nullptr) {
+            return nothing<T>();
+        }
+        return just<T>(*value);
+    }
+
+    const T* find_ptr(const Key &key) const override {
+        size_t pos = locate(key, home(key));
+        return pos != npos ? &slots[pos].value : nullptr;
+    }
+
+    size_t erase(const Key &key) override {
+        size_t h = home(key);
+        size_t pos = locate(key, h);
+        if (pos == npos) {
+            return 0;
+        }
+        slots[pos].full = false;
+        slots[h].hops &= ~(Bitmap(1) << (pos - h));
+        --live;
+        return 1;
+    }
+
+    size_t size() const override {
+        return live;
+    }
+
+    void clear() override {
+        live = 0;
+        allocate(initialCapacity);
+    }
+
+    /// Draws a new multiplier and rehashes the entries with it
+    void seed(size_t seed) override {
+        std::mt19937_64 gen(seed);
+        multiplier = gen() | 1;
+        rehash(capacity());
+    }
+
+    void inspect(common::structure_stats &stats) const override {
+        stats.slots += slots.size();
+        stats.entries += live;
+        stats.bytes += sizeof(*this) + slots.size() * sizeof(slot);
+    }
+
+private:
+    /// The number of home slots, without the extra ones at the end
+    size_t capacity() const {
+        return slots.size() - (Neighborhood - 1);
+    }
+
+    size_t calculateCapacity(size_t elementAmount) const {
+        size_t capacity = minCapacity;
+        while (capacity * maxLoad < elementAmount + 1) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    void allocate(size_t capacity) {
+        slots.assign(capacity + Neighborhood - 1, slot());
+        shift = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) {
+            --shift;
+        }
+        maxUsed = static_cast<size_t>(capacity * maxLoad);
+    }
+
+    size_t home(const Key &key) const {
+        return static_cast<size_t>((static_cast<uint64_t>(preHashFcn(key)) * multiplier) >> shift);
+    }
+
+    /// The slot of key in the neighborhood of h, or npos
+    size_t locate(const Key &key, size_t h) const {
+        for (Bitmap hops = slots[h].hops; hops != 0; hops &= hops - 1) {
+            size_t pos = h + __builtin_ctzll(hops);
+            if (slots[pos].key == key) {
+                return pos;
+            }
+        }
+        return npos;
+    }
+
+    size_t insert(const Key &key) {
+        size_t h = home(key);
+        size_t pos = locate(key, h);
+        if (pos != npos) {
+            return pos;
+        }
+        if (live + 1 > maxUsed) {
+            rehash(2 * capacity());
+            h = home(key);
+        }
+        entry e{key, T()};
+        pos = place(e, h);
+        if (pos == npos) {
+            // No entry could make room: grow and place what was left over
+            rehash(2 * capacity(), std::vector<entry>(1, std::move(e)));
+            return locate(key, home(key));
+        }
+        return pos;
+    }
+
+    /// Moves e into the neighborhood of its home h and returns its slot.
+    /// Returns npos, with e untouched, if no free slot is in reach; hops
+    /// made on the way leave every entry in its neighborhood.
+    size_t place(entry &e, size_t h) {
+        size_t end = std::min(h + maxProbe, slots.size());
+        size_t free = h;
+        while (free < end && slots[free].full) {
+            ++free;
+        }
+        if (free == end) {
+            return npos;
+        }
+        while (free - h >= Neighborhood) {
+            free = hopCloser(free);
+            if (free == npos) {
+                return npos;
+            }
+        }
+        slot &s = slots[free];
+        s.key = std::move(e.key);
+        s.value = std::move(e.value);
+        s.full = true;
+        slots[h].hops |= Bitmap(1) << (free - h);
+        ++live;
+        return free;
+    }
+
+    /// Moves the entry furthest from free that may hop into it there, and
+    /// returns the slot it left, or npos if none may
+    size_t hopCloser(size_t free) {
+        for (size_t h = free - (Neighborhood - 1); h < free; ++h) {
+            // Entries of home h between h and free
+            Bitmap hops = slots[h].hops & ((Bitmap(1) << (free - h)) - 1);
+            if (hops == 0) {
+                continue;
+            }
+            size_t from = h + __builtin_ctzll(hops);
+            slot &source = slots[from];
+            slot &target = slots[free];
+            target.key = std::move(source.key);
+            target.value = std::move(source.value);
+            target.full = true;
+            source.full = false;
+            slots[h].hops = (slots[h].hops & ~(Bitmap(1) << (from - h))) | (Bitmap(1) << (free - h));
+            return from;
+        }
+        return npos;
+    }
+
+    /// Rebuilds the table from its entries and the pending ones, at the
+    /// given capacity or larger if some neighborhood overflows. Throws,
+    /// leaving the table empty, if the hash function clusters the keys so
+    /// badly that growing does not help.
+    void rehash(size_t capacity, std::vector<entry> pending = std::vector<entry>()) {
+        for (;; capacity *= 2) {
+            pending.reserve(pending.size() + live);
+            for (slot &s : slots) {
+                if (s.full) {
+                    pending.push_back(entry{std::move(s.key), std::move(s.value)});
+                }
+            }
+            live = 0;
+            allocate(capacity);
+            size_t i = 0;
+            while (i < pending.size() && place(pending[i], home(pending[i].key)) != npos) {
+                ++i;
+            }
+            if (i == pending.size()) {
+                return;
+            }
+            if (capacity / Neighborhood > live + pending.size() - i) {
+                clear();
+                throw std::length_error("hopscotch: more keys share a home slot than a neighborhood holds");
+            }
+            pending.erase(pending.begin(), pending.begin() + i);
+        }
+    }
+};
+
+}
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "../common/benchmark.h"
 #include "../common/benchmark_util.h"
 #include "../common/contenders.h"
+#include "../common/latency.h"
 
 namespace hashtable {
 
@@ -16,15 +22,18 @@ public:
     using Benchmark = common::benchmark<HashTable, Configuration>;
     using BenchmarkFactory = common::contender_factory<Benchmark>;
     using T = typename HashTable::mapped_type;
+    using value_type = typename HashTable::value_type;
     common::contender_list<Benchmark> benchmarks;
 
     template <int factor=1>
-    static void* fill_data_random(HashTable&, Configuration config, void*) {
+    static void* fill_data_random(HashTable &map, Configuration config, void*) {
+        map.seed(config.second);
         return common::util::fill_data_random<T>(
             factor*config.first, config.second);
     }
 
     static void* fill_map_random(HashTable &map, Configuration config, void*) {
+        map.seed(config.second);
         std::mt19937 gen{config.second};
         for (size_t i = 1; i <= config.first; ++i) {
             map[i] = gen();
@@ -32,26 +41,97 @@ public:
         return nullptr;
     }
 
+    // the map of fill_map_random, and its keys in random order
+    static void* fill_map_shuffled(HashTable &map, Configuration config, void* ptr) {
+        fill_map_random(map, config, ptr);
+        return common::util::fill_data_permutation<T>(config.first, config.second + 1);
+    }
+
     template <int factor = 1>
     static void* fill_both_random(HashTable &map, Configuration config, void* ptr) {
         fill_map_random(map, config, ptr);
-        config.second++;
-        return fill_data_random<factor>(map, config, ptr);
+        return common::util::fill_data_random<T>(
+            factor*config.first, config.second + 1);
+    }
+
+    // the data of "insert", with room for a latency sample per insertion.
+    // Clearing here keeps the samples from growing across runs when the
+    // latency instrumentation, which clears them too, is disabled.
+    static void* fill_data_latency(HashTable &map, Configuration config, void* ptr) {
+        common::latency::samples().clear();
+        common::latency::samples().reserve(config.first);
+        return fill_data_random<1>(map, config, ptr);
     }
 
     static void delete_data(HashTable&, Configuration, void* data) {
         common::util::delete_data<T>(data);
     }
 
-    static void register_benchmarks(common::contender_list<Benchmark> &benchmarks) {
-        auto fill = [](HashTable &map, Configuration config, void* ptr) {
-            T* data = static_cast<T*>(ptr);
-            for (size_t i = 0; i < config.first; ++i) {
-                map[i+1] = data[i];
+    // the keys and values that "insert" inserts, as pairs
+    static void* fill_pairs_random(HashTable &map, Configuration config, void*) {
+        map.seed(config.second);
+        std::mt19937 gen{config.second};
+        return common::util::fill_data<value_type>(config.first, [&gen](size_t i) {
+            return value_type(i+1, gen());
+        });
+    }
+
+    static void delete_pairs(HashTable&, Configuration, void* data) {
+        common::util::delete_data<value_type>(data);
+    }
+
+    // every reader thread finds config.first random keys of [1, config.first]
+    // while the calling thread keeps inserting and erasing the keys of
+    // [config.first + 1, 2 * config.first], so the table never holds more
+    // than twice its keys. Tables without concurrent reads share a reader-writer lock
+    // among all threads.
+    static void find_while_writing(HashTable &map, Configuration config) {
+        using Key = typename HashTable::key_type;
+        const size_t cores = std::thread::hardware_concurrency();
+        const size_t readers = cores > 1 ? cores - 1 : 1;
+        const bool locked = !map.concurrent_reads();
+        std::shared_timed_mutex lock;
+        std::atomic<size_t> running(readers);
+
+        std::vector<std::thread> threads;
+        for (size_t r = 0; r < readers; ++r) {
+            threads.emplace_back([&, r]() {
+                std::mt19937 gen(config.second + r);
+                for (size_t i = 0; i < config.first; ++i) {
+                    Key key = Key(gen() % config.first + 1);
+                    if (locked) {
+                        std::shared_lock<std::shared_timed_mutex> guard(lock);
+                        (void)map.find(key);
+                    } else {
+                        (void)map.find(key);
+                    }
+                }
+                --running;
+            });
+        }
+        auto write = [&map](size_t key, bool inserting) {
+            if (inserting) {
+                map.insert_or_assign(Key(key), T(key));
+            } else {
+                map.erase(Key(key));
             }
-            return nullptr;
         };
+        for (size_t i = 0; running > 0; ++i) {
+            size_t key = config.first + 1 + i % config.first;
+            bool inserting = (i / config.first) % 2 == 0;
+            if (locked) {
+                std::lock_guard<std::shared_timed_mutex> guard(lock);
+                write(key, inserting);
+            } else {
+                write(key, inserting);
+            }
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
 
+    static void register_benchmarks(common::contender_list<Benchmark> &benchmarks) {
         const std::vector<Configuration> configs{
             std::make_pair(1<<16, 0xDECAF),
             std::make_pair(1<<18, 0xBEEF),
@@ -60,11 +140,45 @@ public:
 //            std::make_pair(1<<24, 0xBA5EBA11),
             //std::make_pair(1<<26, 0xCA55E77E)
         };
+        register_benchmarks(benchmarks, configs);
+    }
+
+    // The same benchmarks on other table sizes and seeds, e.g. smaller ones
+    // for tables that need quadratic space
+    static void register_benchmarks(common::contender_list<Benchmark> &benchmarks,
+                                    const std::vector<Configuration> &configs) {
+        auto fill = [](HashTable &map, Configuration config, void* ptr) {
+            T* data = static_cast<T*>(ptr);
+            for (size_t i = 0; i < config.first; ++i) {
+                map[i+1] = data[i];
+            }
+            return nullptr;
+        };
 
         // insert data
         common::register_benchmark("insert", "insert",  microbenchmark::fill_data_random<1>,
             fill, microbenchmark::delete_data, configs, benchmarks);
 
+        // insert the same data as "insert" at once, so tables can build
+        // themselves in one pass instead of growing
+        common::register_benchmark("bulk build", "bulk-build", microbenchmark::fill_pairs_random,
+            [](HashTable &map, Configuration config, void* ptr) {
+                value_type* pairs = static_cast<value_type*>(ptr);
+                map.bulk_insert(pairs, pairs + config.first);
+            }, microbenchmark::delete_pairs, configs, benchmarks);
+
+        // insert data, timing every insertion to expose the tail latency of
+        // rehashes (use with the latency instrumentation)
+        common::register_benchmark("insert latency", "insert-latency", microbenchmark::fill_data_latency,
+            [](HashTable &map, Configuration config, void* ptr) {
+                T* data = static_cast<T*>(ptr);
+                size_t num = config.first;
+                for (size_t i = 0; i < num; ++i) {
+                    common::latency::sample sample;
+                    map[i+1] = data[i];
+                }
+            }, microbenchmark::delete_data, configs, benchmarks);
+
         // insert elements and find them
         common::register_benchmark("insert+find", "insert-find", microbenchmark::fill_data_random<1>,
             [](HashTable &map, Configuration config, void* ptr) {
@@ -111,6 +225,16 @@ public:
                 }
             }, configs, benchmarks);
 
+        // find entries in a dependent chain: the next key is derived from the
+        // value just found, so this measures lookup latency, not throughput
+        common::register_benchmark("find chain", "find-chain", microbenchmark::fill_map_random,
+            [](HashTable &map, Configuration config, void*) {
+                size_t key = 1;
+                for (size_t i = 0; i < config.first; ++i) {
+                    key = static_cast<size_t>(*map.find(key)) % config.first + 1;
+                }
+            }, configs, benchmarks);
+
         // find random keys that very likely don't exist
         common::register_benchmark("find random", "find-random", microbenchmark::fill_both_random<1>,
             [](HashTable &map, Configuration config, void* ptr) {
@@ -119,6 +243,52 @@ public:
                     (void)map.find(data[i]+1);
                 }
             }, microbenchmark::delete_data, configs, benchmarks);
+
+        // find entries that were previously inserted without copying their
+        // values, which measures the probing alone
+        common::register_benchmark("find pointer", "find-ptr", microbenchmark::fill_map_random,
+            [](HashTable &map, Configuration config, void*) {
+                for (size_t i = 1; i <= config.first; ++i) {
+                    (void)map.find_ptr(i);
+                }
+            }, configs, benchmarks);
+
+        // find entries on several threads while one writer takes turns
+        // inserting and erasing the keys of [n+1, 2n], which measures read
+        // throughput under concurrent modification of a bounded table
+        common::register_benchmark("concurrent find", "concurrent-find", microbenchmark::fill_map_random,
+            [](HashTable &map, Configuration config, void*) {
+                find_while_writing(map, config);
+            }, configs, benchmarks);
+
+        // check for random keys that very likely don't exist
+        common::register_benchmark("contains random", "contains-random", microbenchmark::fill_both_random<1>,
+            [](HashTable &map, Configuration config, void* ptr) {
+                T* data = static_cast<T*>(ptr);
+                for (size_t i = 0; i < config.first; ++i) {
+                    (void)map.contains(data[i]+1);
+                }
+            }, microbenchmark::delete_data, configs, benchmarks);
+    }
+
+    // Benchmarks on tables far beyond the caches and the reach of the TLB.
+    // Building them takes long, so they are registered separately.
+    static void register_large_benchmarks(common::contender_list<Benchmark> &benchmarks) {
+        const std::vector<Configuration> configs{
+            std::make_pair(1<<22, 0xF005BA11),
+            std::make_pair(1<<24, 0xBA5EBA11),
+            std::make_pair(1<<26, 0xCA55E77E)
+        };
+
+        // find entries of a large table in random order, so that nearly
+        // every lookup misses the caches and the TLB
+        common::register_benchmark("find large", "find-large", microbenchmark::fill_map_shuffled,
+            [](HashTable &map, Configuration config, void* ptr) {
+                T* data = static_cast<T*>(ptr);
+                for (size_t i = 0; i < config.first; ++i) {
+                    (void)map.find(data[i]+1);
+                }
+            }, microbenchmark::delete_data, configs, benchmarks);
     }
 };
 }
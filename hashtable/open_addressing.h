@@ -0,0 +1,351 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../common/contenders.h"
+#include "hashtable.h"
+
+namespace hashtable {
+
+/// Probing strategies for open_addressing. The probe sequence starts at the
+/// key's home slot, next(pos, i, stride, mask) gives the slot after the i-th
+/// probe. All of them visit every slot of a power-of-two table, so a probe
+/// ends at the latest when it reaches one of the free slots the load factor
+/// keeps. contiguous tells whether a key's sequence is a run of adjacent slots,
+/// which backward-shift deletion needs.
+struct linear_probing {
+    static const bool contiguous = true;
+    static std::string name() { return "linear probing"; }
+    static std::string key() { return "linear"; }
+
+    static size_t stride(uint64_t, unsigned) { return 1; }
+    static size_t next(size_t pos, size_t, size_t, size_t mask) {
+        return (pos + 1) & mask;
+    }
+};
+
+/// Offsets are the triangular numbers i(i+1)/2, which hit every slot of a
+/// power-of-two table
+struct quadratic_probing {
+    static const bool contiguous = false;
+    static std::string name() { return "quadratic probing"; }
+    static std::string key() { return "quadratic"; }
+
+    static size_t stride(uint64_t, unsigned) { return 1; }
+    static size_t next(size_t pos, size_t i, size_t, size_t mask) {
+        return (pos + i) & mask;
+    }
+};
+
+/// The step is a second hash of the key, forced odd so that it is coprime
+/// to the table size
+struct double_hashing {
+    static const bool contiguous = false;
+    static std::string name() { return "double hashing"; }
+    static std::string key() { return "double"; }
+
+    static size_t stride(uint64_t hash, unsigned shift) {
+        return static_cast<size_t>((hash * 0xc2b2ae3d27d4eb4fULL) >> shift) | 1;
+    }
+    static size_t next(size_t pos, size_t, size_t stride, size_t mask) {
+        return (pos + stride) & mask;
+    }
+};
+
+/// Deletion strategies for open_addressing. Erased slots become tombstones,
+/// which lookups skip and inserts reuse, until the next rehash drops them.
+struct tombstone_deletion {
+    static const bool shifts = false;
+    static const bool moves = false;
+    static std::string name() { return "tombstones"; }
+    static std::string key() { return "tombstones"; }
+};
+
+/// Erasing closes the gap by moving later entries of the run back, so there
+/// are no tombstones at all. Only works with linear probing.
+struct backward_shift_deletion {
+    static const bool shifts = true;
+    static const bool moves = false;
+    static std::string name() { return "backward shift"; }
+    static std::string key() { return "backward-shift"; }
+};
+
+/// Tombstones, but an access through operator[] that passes one on its way
+/// to the key moves the entry into the first tombstone, shortening the next
+/// lookup. find and find_ptr leave the slots alone, so they may share the
+/// table with other readers.
+struct moving_tombstone_deletion {
+    static const bool shifts = false;
+    static const bool moves = true;
+    static std::string name() { return "tombstones moved on access"; }
+    static std::string key() { return "moving-tombstones"; }
+};
+
+/// Hashing with open addressing in a flat power-of-two array. Keys are
+/// hashed with PreHashFcn and spread with a multiplicative hash, whose
+/// multiplier seed() redraws. The table doubles once live entries and
+/// tombstones would exceed the maximum load factor, or is rebuilt at the
+/// same size if mostly tombstones fill it.
+template <typename Key, typename T,
+          typename Probing = linear_probing,
+          typename Deletion = tombstone_deletion,
+          typename PreHashFcn = std::hash<Key>>
+class open_addressing : public hashtable<Key, T> {
+    static_assert(!Deletion::shifts || Probing::contiguous,
+                  "backward-shift deletion needs linear probing");
+private:
+    enum : uint8_t { empty = 0, occupied = 1, deleted = 2 };
+
+    struct slot {
+        Key key;
+        T value;
+        uint8_t state;
+
+        slot() : key(), value(), state(empty) {}
+    };
+
+    static const size_t npos = size_t(-1);
+    static const size_t minCapacity = 8;
+
+    PreHashFcn preHashFcn;
+    double maxLoad;
+    size_t initialCapacity;
+    uint64_t multiplier;
+
+    std::vector<slot> slots;
+    size_t mask;
+    unsigned shift;
+    size_t live;
+    size_t tombstones;
+    size_t maxUsed;
+
+public:
+    open_addressing(size_t initialElementAmount = 0, double maxLoad = 0.5) :
+        preHashFcn(),
+        maxLoad(maxLoad),
+        initialCapacity(calculateCapacity(initialElementAmount)),
+        multiplier(0x9e3779b97f4a7c15ULL),
+        live(0),
+        tombstones(0) {
+        allocate(initialCapacity);
+    }
+    virtual ~open_addressing() = default;
+
+    // Register all contenders in the list
+    static void register_contenders(common::contender_list<hashtable<Key, T>> &list) {
+        register_deletions<linear_probing, tombstone_deletion, backward_shift_deletion,
+                           moving_tombstone_deletion>(list);
+        register_deletions<quadratic_probing, tombstone_deletion, moving_tombstone_deletion>(list);
+        register_deletions<double_hashing, tombstone_deletion, moving_tombstone_deletion>(list);
+    }
+
+    T& operator[](const Key &key) override {
+        return slots[insert(key)].value;
+    }
+
+    T& operator[](Key &&key) override {
+        return slots[insert(key)].value;
+    }
+
+    maybe<T> find(const Key &key) const override {
+        const T* value = find_ptr(key);
+        if (value == nullptr) {
+            return nothing<T>();
+        }
+        return just<T>(*value);
+    }
+
+    const T* find_ptr(const Key &key) const override {
+        bool found;
+        size_t tombstone;
+        size_t pos = probe(key, found, tombstone);
+        return found ? &slots[pos].value : nullptr;
+    }
+
+    size_t erase(const Key &key) override {
+        bool found;
+        size_t tombstone;
+        size_t pos = probe(key, found, tombstone);
+        if (!found) {
+            return 0;
+        }
+        if (Deletion::shifts) {
+            shiftBack(pos);
+        } else {
+            slots[pos].state = deleted;
+            ++tombstones;
+        }
+        --live;
+        return 1;
+    }
+
+    size_t size() const override {
+        return live;
+    }
+
+    void clear() override {
+        live = 0;
+        tombstones = 0;
+        allocate(initialCapacity);
+    }
+
+    /// Draws a new multiplier and rehashes the entries with it
+    void seed(size_t seed) override {
+        std::mt19937_64 gen(seed);
+        multiplier = gen() | 1;
+        rehash(slots.size());
+    }
+
+    void inspect(common::structure_stats &stats) const override {
+        stats.slots += slots.size();
+        stats.entries += live;
+        stats.tombstones += tombstones;
+        stats.bytes += sizeof(*this) + slots.size() * sizeof(slot);
+    }
+
+private:
+    template <typename P, typename D>
+    static void register_combination(common::contender_list<hashtable<Key, T>> &list) {
+        using Factory = common::contender_factory<hashtable<Key, T>>;
+        list.register_contender(Factory(
+            "open addressing (" + P::name() + ", " + D::name() + ")",
+            "open-addressing-" + P::key() + "-" + D::key(),
+            [](){ return new open_addressing<Key, T, P, D, PreHashFcn>(); }
+        ));
+    }
+
+    template <typename P>
+    static void register_deletions(common::contender_list<hashtable<Key, T>> &) {}
+
+    template <typename P, typename D, typename... Ds>
+    static void register_deletions(common::contender_list<hashtable<Key, T>> &list) {
+        register_combination<P, D>(list);
+        register_deletions<P, Ds...>(list);
+    }
+
+    size_t calculateCapacity(size_t elementAmount) const {
+        size_t capacity = minCapacity;
+        while (capacity * maxLoad < elementAmount + 1) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    void allocate(size_t capacity) {
+        slots.assign(capacity, slot());
+        mask = capacity - 1;
+        shift = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) {
+            --shift;
+        }
+        // Keep at least one slot empty, so that every probe terminates
+        maxUsed = std::min(static_cast<size_t>(capacity * maxLoad), capacity - 1);
+    }
+
+    uint64_t hash(const Key &key) const {
+        return static_cast<uint64_t>(preHashFcn(key)) * multiplier;
+    }
+
+    size_t home(uint64_t hash) const {
+        return static_cast<size_t>(hash >> shift);
+    }
+
+    /// Looks for key. If it is there, found is set and its slot returned,
+    /// else the empty slot that ended the search. tombstone is the first
+    /// tombstone on the way, or npos.
+    size_t probe(const Key &key, bool &found, size_t &tombstone) const {
+        uint64_t h = hash(key);
+        size_t pos = home(h);
+        size_t stride = Probing::stride(h, shift);
+        tombstone = npos;
+        for (size_t i = 1; ; ++i) {
+            const slot &s = slots[pos];
+            if (s.state == empty) {
+                found = false;
+                return pos;
+            }
+            if (s.state == occupied) {
+                if (s.key == key) {
+                    found = true;
+                    return pos;
+                }
+            } else if (tombstone == npos) {
+                tombstone = pos;
+            }
+            pos = Probing::next(pos, i, stride, mask);
+        }
+    }
+
+    size_t insert(const Key &key) {
+        bool found;
+        size_t tombstone;
+        size_t pos = probe(key, found, tombstone);
+        if (found) {
+            if (Deletion::moves && tombstone != npos) {
+                slot &source = slots[pos];
+                slot &target = slots[tombstone];
+                target.key = std::move(source.key);
+                target.value = std::move(source.value);
+                target.state = occupied;
+                source.state = deleted;
+                return tombstone;
+            }
+            return pos;
+        }
+        if (tombstone != npos) {
+            pos = tombstone;
+            --tombstones;
+        } else if (live + tombstones + 1 > maxUsed) {
+            // Grow if the live entries need it, else just drop the tombstones
+            rehash(live + 1 > maxUsed / 2 ? 2 * slots.size() : slots.size());
+            pos = probe(key, found, tombstone);
+        }
+        slot &s = slots[pos];
+        s.key = key;
+        s.value = T();
+        s.state = occupied;
+        ++live;
+        return pos;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<slot> old;
+        old.swap(slots);
+        allocate(capacity);
+        tombstones = 0;
+        for (slot &s : old) {
+            if (s.state != occupied) {
+                continue;
+            }
+            uint64_t h = hash(s.key);
+            size_t pos = home(h);
+            size_t stride = Probing::stride(h, shift);
+            for (size_t i = 1; slots[pos].state != empty; ++i) {
+                pos = Probing::next(pos, i, stride, mask);
+            }
+            slots[pos] = std::move(s);
+        }
+    }
+
+    /// Closes the gap at pos: every later entry of the run whose home lies
+    /// at or before the gap moves into it, leaving a new gap behind
+    void shiftBack(size_t pos) {
+        size_t gap = pos;
+        for (size_t next = (pos + 1) & mask; slots[next].state == occupied; next = (next + 1) & mask) {
+            size_t distance = (next - home(hash(slots[next].key))) & mask;
+            if (distance >= ((next - gap) & mask)) {
+                slots[gap] = std::move(slots[next]);
+                gap = next;
+            }
+        }
+        slots[gap].state = empty;
+    }
+};
+
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../common/contenders.h"
+#include "hashtable.h"
+
+namespace hashtable {
+
+/// Robin Hood hashing (Celis 1986): linear probing where an insert takes
+/// the slot of any entry that is closer to its home slot than the new one,
+/// and moves that entry on instead. Probe distances stay short and even at
+/// high load, and a lookup can stop as soon as it meets an entry closer to
+/// home than the key would be, so misses end early too. Erasing shifts the
+/// rest of the run back, so there are no tombstones.
+///
+/// Each slot stores its entry's probe distance in a byte next to the key.
+/// An insert that would exceed the largest distance a byte holds grows the
+/// table instead, whatever the load.
+template <typename Key, typename T, typename PreHashFcn = std::hash<Key>>
+class robin_hood : public hashtable<Key, T> {
+private:
+    struct slot {
+        Key key;
+        T value;
+        uint8_t distance; ///< probe distance + 1, 0 for an empty slot
+
+        slot() : key(), value(), distance(0) {}
+    };
+
+    static const size_t npos = size_t(-1);
+    static const size_t minCapacity = 8;
+    static const uint8_t maxDistance = 255;
+
+    PreHashFcn preHashFcn;
+    double maxLoad;
+    size_t initialCapacity;
+    uint64_t multiplier;
+
+    std::vector<slot> slots;
+    size_t mask;
+    unsigned shift;
+    size_t live;
+    size_t maxUsed;
+
+public:
+    robin_hood(size_t initialElementAmount = 0, double maxLoad = 0.9) :
+        preHashFcn(),
+        maxLoad(maxLoad),
+        initialCapacity(calculateCapacity(initialElementAmount)),
+        multiplier(0x9e3779b97f4a7c15ULL),
+        live(0) {
+        allocate(initialCapacity);
+    }
+    virtual ~robin_hood() = default;
+
+    // Register all contenders in the list
+    static void register_contenders(common::contender_list<hashtable<Key, T>> &list) {
+        using Factory = common::contender_factory<hashtable<Key, T>>;
+        for (int percent : {50, 80, 90, 95}) {
+            list.register_contender(Factory(
+                "Robin Hood (load " + std::to_string(percent) + "%)",
+                "robin-hood-" + std::to_string(percent),
+                [percent](){ return new robin_hood<Key, T, PreHashFcn>(0, percent / 100.0); }
+            ));
+        }
+    }
+
+    T& operator[](const Key &key) override {
+        return slots[insert(key)].value;
+    }
+
+    T& operator[](Key &&key) override {
+        return slots[insert(key)].value;
+    }
+
+    maybe<T> find(const Key &key) const override {
+        const T* value = find_ptr(key);
+        if (value == nullptr) {
+            return nothing<T>();
+        }
+        return just<T>(*value);
+    }
+
+    const T* find_ptr(const Key &key) const override {
+        size_t pos = locate(key);
+        return pos != npos ? &slots[pos].value : nullptr;
+    }
+
+    size_t erase(const Key &key) override {
+        size_t pos = locate(key);
+        if (pos == npos) {
+            return 0;
+        }
+        // Shift the rest of the run back by one, up to an empty slot or an
+        // entry in its home slot
+        for (size_t next = (pos + 1) & mask; slots[next].distance > 1; next = (next + 1) & mask) {
+            slots[pos] = std::move(slots[next]);
+            --slots[pos].distance;
+            pos = next;
+        }
+        slots[pos].distance = 0;
+        --live;
+        return 1;
+    }
+
+    size_t size() const override {
+        return live;
+    }
+
+    void clear() override {
+        live = 0;
+        allocate(initialCapacity);
+    }
+
+    /// Draws a new multiplier and rehashes the entries with it
+    void seed(size_t seed) override {
+        std::mt19937_64 gen(seed);
+        multiplier = gen() | 1;
+        rehash(slots.size());
+    }
+
+    void inspect(common::structure_stats &stats) const override {
+        stats.slots += slots.size();
+        stats.entries += live;
+        stats.bytes += sizeof(*this) + slots.size() * sizeof(slot);
+    }
+
+private:
+    size_t calculateCapacity(size_t elementAmount) const {
+        size_t capacity = minCapacity;
+        while (capacity * maxLoad < elementAmount + 1) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    void allocate(size_t capacity) {
+        slots.assign(capacity, slot());
+        mask = capacity - 1;
+        shift = 64;
+        for (size_t c = capacity; c > 1; c >>= 1) {
+            --shift;
+        }
+        maxUsed = std::min(static_cast<size_t>(capacity * maxLoad), capacity - 1);
+    }
+
+    size_t home(const Key &key) const {
+        return static_cast<size_t>((static_cast<uint64_t>(preHashFcn(key)) * multiplier) >> shift);
+    }
+
+    /// The slot of key, or npos. Stops at the first slot whose entry is
+    /// closer to its home than key would be there, empty slots included.
+    size_t locate(const Key &key) const {
+        size_t pos = home(key);
+        for (unsigned distance = 1; ; ++distance) {
+            const slot &s = slots[pos];
+            if (s.distance < distance) {
+                return npos;
+            }
+            if (s.distance == distance && s.key == key) {
+                return pos;
+            }
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    size_t insert(const Key &key) {
+        size_t pos = locate(key);
+        if (pos != npos) {
+            return pos;
+        }
+        if (live + 1 > maxUsed) {
+            rehash(2 * slots.size());
+        }
+        slot entry;
+        entry.key = key;
+        pos = place(entry);
+        ++live;
+        if (entry.distance != 0) {
+            // A run got too long: grow and place what was left over
+            rehash(2 * slots.size(), std::vector<slot>(1, std::move(entry)));
+            pos = locate(key);
+        }
+        return pos;
+    }
+
+    /// Places entry by Robin Hood insertion and returns where it went. If a
+    /// probe distance would overflow, entry is left holding the displaced
+    /// entry that could not be placed, with a distance other than 0.
+    size_t place(slot &entry) {
+        size_t pos = home(entry.key);
+        size_t placed = npos;
+        entry.distance = 1;
+        for (;;) {
+            slot &s = slots[pos];
+            if (s.distance == 0) {
+                s = std::move(entry);
+                entry.distance = 0;
+                return placed != npos ? placed : pos;
+            }
+            if (s.distance < entry.distance) {
+                std::swap(s, entry);
+                if (placed == npos) {
+                    placed = pos;
+                }
+            }
+            if (entry.distance == maxDistance) {
+                return placed;
+            }
+            ++entry.distance;
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    /// Rebuilds the table from its entries and the pending ones, at the
+    /// given capacity or larger if a probe distance would overflow. Throws,
+    /// leaving the table empty, if the hash function clusters the keys so
+    /// badly that growing does not help.
+    void rehash(size_t capacity, std::vector<slot> pending = std::vector<slot>()) {
+        for (;; capacity *= 2) {
+            pending.reserve(pending.size() + live);
+            for (slot &s : slots) {
+                if (s.distance != 0) {
+                    pending.push_back(std::move(s));
+                }
+            }
+            allocate(capacity);
+            size_t i = 0;
+            while (i < pending.size()) {
+                place(pending[i]);
+                if (pending[i].distance != 0) {
+                    break;
+                }
+                ++i;
+            }
+            if (i == pending.size()) {
+                return;
+            }
+            size_t entries = pending.size() - i;
+            for (const slot &s : slots) {
+                entries += s.distance != 0;
+            }
+            if (capacity / maxDistance > entries) {
+                clear();
+                throw std::length_error("robin_hood: more keys share a home slot than a probe distance can hold");
+            }
+            pending.erase(pending.begin(), pending.begin() + i);
+        }
+    }
+};
+
+}
@@ -50,6 +50,15 @@ public:
         }
     }
 
+    const T* find_ptr(const Key &key) const override {
+        auto it = map.find(key);
+        if (it == map.end()) {
+            return nullptr;
+        } else {
+            return &it->second;
+        }
+    }
+
     size_t erase(const Key &key) override {
         return map.erase(key);
     }
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../common/aligned_allocator.h"
+#include "../common/contenders.h"
+#include "hashtable.h"
+
+namespace hashtable {
+
+/// Control bytes of swiss_table: 7 bits of a full slot's hash, or
+/// one of the two markers below, which both have the high bit set
+enum : int8_t { control_empty = -128, control_deleted = -2 };
+
+/// Matches a group of 16 control bytes, returning a bit per matching byte.
+/// The group starts on a 16 byte boundary.
+struct portable_group {
+    static const size_t width = 16;
+
+    static uint32_t match(const int8_t* group, int8_t tag) {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < width; ++i) {
+            mask |= uint32_t(group[i] == tag) << i;
+        }
+        return mask;
+    }
+
+    static uint32_t matchEmpty(const int8_t* group) {
+        return match(group, control_empty);
+    }
+
+    /// The slots an insert may take
+    static uint32_t matchFree(const int8_t* group) {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < width; ++i) {
+            mask |= uint32_t(group[i] < 0) << i;
+        }
+        return mask;
+    }
+};
+
+#if defined(__SSE2__)
+/// One compare and movemask per group. SSE2 is part of x86-64, so this
+/// needs no flags or CPU checks.
+struct sse2_group {
+    static const size_t width = 16;
+
+    static uint32_t match(const int8_t* group, int8_t tag) {
+        __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag))));
+    }
+
+    static uint32_t matchEmpty(const int8_t* group) {
+        return match(group, control_empty);
+    }
+
+    /// Empty and deleted bytes are the ones with the high bit set
+    static uint32_t matchFree(const int8_t* group) {
+        __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+    }
+};
+
+using default_group = sse2_group;
+#else
+using default_group = portable_group;
+#endif
+
+/// Open addressing with a control byte per slot, after Google's Swiss
+/// tables. The control bytes form groups of 16, and a lookup compares 7
+/// bits of the key's hash with a whole group at once, so it only compares
+/// keys of the few slots whose tag matches. It ends at the first group
+/// with an empty slot. Groups are probed quadratically, the key's home
+/// group first.
+///
+/// Erasing leaves a tombstone only if the group is full, as then lookups
+/// may have probed past it; otherwise the slot becomes empty again.
+/// The table doubles once live entries and tombstones would exceed the
+/// maximum load factor, or is rebuilt at the same size if mostly
+/// tombstones fill it.
+template <typename Key, typename T,
+          typename Group = default_group,
+          typename PreHashFcn = std::hash<Key>>
+class swiss_table : public hashtable<Key, T> {
+private:
+    struct slot {
+        Key key;
+        T value;
+
+        slot() : key(), value() {}
+    };
+
+    static const size_t width = Group::width;
+    static const size_t npos = size_t(-1);
+    /// Two groups, so that the group index shift stays below 64
+    static const size_t minCapacity = 2 * width;
+
+    using Controls = std::vector<int8_t, common::aligned_allocator<int8_t, width>>;
+
+    PreHashFcn preHashFcn;
+    double maxLoad;
+    size_t initialCapacity;
+    uint64_t multiplier;
+
+    Controls controls;
+    std::vector<slot> slots;
+    size_t groupMask;
+    unsigned shift;
+    size_t live;
+    size_t tombstones;
+    size_t maxUsed;
+
+public:
+    swiss_table(size_t initialElementAmount = 0, double maxLoad = 0.875) :
+        preHashFcn(),
+        maxLoad(maxLoad),
+        initialCapacity(calculateCapacity(initialElementAmount)),
+        multiplier(0x9e3779b97f4a7c15ULL),
+        live(0),
+        tombstones(0) {
+        allocate(initialCapacity);
+    }
+    virtual ~swiss_table() = default;
+
+    // Register all contenders in the list
+    static void register_contenders(common::contender_list<hashtable<Key, T>> &list) {
+        using Factory = common::contender_factory<hashtable<Key, T>>;
+        list.register_contender(Factory("Swiss table (load 50%)", "swiss-table-50",
+            [](){ return new swiss_table<Key, T, Group, PreHashFcn>(0, 0.5); }
+        ));
+        list.register_contender(Factory("Swiss table (load 87.5%)", "swiss-table-87",
+            [](){ return new swiss_table<Key, T, Group, PreHashFcn>(0, 0.875); }
+        ));
+    }
+
+    T& operator[](const Key &key) override {
+        return slots[insert(key)].value;
+    }
+
+    T& operator[](Key &&key) override {
+        return slots[insert(key)].value;
+    }
+
+    maybe<T> find(const Key &key) const override {
+        const T* value = find_ptr(key);
+        if (value == nullptr) {
+            return nothing<T>();
+        }
+        return just<T>(*value);
+    }
+
+    const T* find_ptr(const Key &key) const override {
+        size_t pos = locate(key, hash(key));
+        return pos != npos ? &slots[pos].value : nullptr;
+    }
+
+    size_t erase(const Key &key) override {
+        size_t pos = locate(key, hash(key));
+        if (pos == npos) {
+            return 0;
+        }
+        if (Group::matchEmpty(&controls[pos & ~(width - 1)]) != 0) {
+            controls[pos] = control_empty;
+        } else {
+            controls[pos] = control_deleted;
+            ++tombstones;
+        }
+        --live;
+        return 1;
+    }
+
+    size_t size() const override {
+        return live;
+    }
+
+    void clear() override {
+        live = 0;
+        tombstones = 0;
+        allocate(initialCapacity);
+    }
+
+    /// Draws a new multiplier and rehashes the entries with it
+    void seed(size_t seed) override {
+        std::mt19937_64 gen(seed);
+        multiplier = gen() | 1;
+        rehash(slots.size());
+    }
+
+    /// Each group counts as a bucket of 16 slots
+    void inspect(common::structure_stats &stats) const override {
+        for (size_t g = 0; g < controls.size(); g += width) {
+            size_t entries = 0, deleted = 0;
+            for (size_t i = g; i < g + width; ++i) {
+                entries += controls[i] >= 0;
+                deleted += controls[i] == control_deleted;
+            }
+            stats.add_bucket(width, entries, deleted);
+        }
+        stats.bytes += sizeof(*this) + slots.size() * (sizeof(slot) + 1);
+    }
+
+private:
+    size_t calculateCapacity(size_t elementAmount) const {
+        size_t capacity = minCapacity;
+        while (capacity * maxLoad < elementAmount + 1) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    void allocate(size_t capacity) {
+        controls.assign(capacity, control_empty);
+        slots.assign(capacity, slot());
+        groupMask = capacity / width - 1;
+        shift = 64;
+        for (size_t g = capacity / width; g > 1; g >>= 1) {
+            --shift;
+        }
+        // Keep at least one slot empty, so that every probe terminates
+        maxUsed = std::min(static_cast<size_t>(capacity * maxLoad), capacity - 1);
+    }
+
+    uint64_t hash(const Key &key) const {
+        return static_cast<uint64_t>(preHashFcn(key)) * multiplier;
+    }
+
+    /// The top bits of the hash pick the home group, the 7 bits below them
+    /// the tag
+    size_t homeGroup(uint64_t h) const {
+        return static_cast<size_t>(h >> shift);
+    }
+
+    int8_t tag(uint64_t h) const {
+        return static_cast<int8_t>((h >> (shift - 7)) & 0x7f);
+    }
+
+    /// The slot of key, or npos
+    size_t locate(const Key &key, uint64_t h) const {
+        int8_t t = tag(h);
+        size_t group = homeGroup(h);
+        for (size_t i = 1; ; ++i) {
+            const int8_t* ctrl = &controls[group * width];
+            for (uint32_t match = Group::match(ctrl, t); match != 0; match &= match - 1) {
+                size_t pos = group * width + __builtin_ctz(match);
+                if (slots[pos].key == key) {
+                    return pos;
+                }
+            }
+            if (Group::matchEmpty(ctrl) != 0) {
+                return npos;
+            }
+            group = (group + i) & groupMask;
+        }
+    }
+
+    /// The first empty or deleted slot on the probe sequence of h
+    size_t findFree(uint64_t h) const {
+        size_t group = homeGroup(h);
+        for (size_t i = 1; ; ++i) {
+            uint32_t free = Group::matchFree(&controls[group * width]);
+            if (free != 0) {
+                return group * width + __builtin_ctz(free);
+            }
+            group = (group + i) & groupMask;
+        }
+    }
+
+    size_t insert(const Key &key) {
+        uint64_t h = hash(key);
+        size_t pos = locate(key, h);
+        if (pos != npos) {
+            return pos;
+        }
+        pos = findFree(h);
+        if (controls[pos] == control_deleted) {
+            --tombstones;
+        } else if (live + tombstones + 1 > maxUsed) {
+            // Grow if the live entries need it, else just drop the tombstones
+            rehash(live + 1 > maxUsed / 2 ? 2 * slots.size() : slots.size());
+            pos = findFree(h);
+        }
+        controls[pos] = tag(h);
+        slot &s = slots[pos];
+        s.key = key;
+        s.value = T();
+        ++live;
+        return pos;
+    }
+
+    void rehash(size_t capacity) {
+        Controls oldControls;
+        std::vector<slot> old;
+        oldControls.swap(controls);
+        old.swap(slots);
+        allocate(capacity);
+        tombstones = 0;
+        for (size_t i = 0; i < old.size(); ++i) {
+            if (oldControls[i] < 0) {
+                continue;
+            }
+            uint64_t h = hash(old[i].key);
+            size_t pos = findFree(h);
+            controls[pos] = tag(h);
+            slots[pos] = std::move(old[i]);
+        }
+    }
+};
+
+}
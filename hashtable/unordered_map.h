@@ -4,6 +4,7 @@
 #include <unordered_map>
 
 #include "../common/contenders.h"
+#include "../common/hugepage_allocator.h"
 #include "hashtable.h"
 
 namespace hashtable {
@@ -24,6 +25,10 @@ public:
         list.register_contender(Factory("std::unordered_map", "std::unordered-map",
             [](){ return new unordered_map<Key, T>();}
         ));
+        list.register_contender(Factory("std::unordered_map with huge pages", "std::unordered-map-hugepages",
+            [](){ return new unordered_map<Key, T, std::hash<Key>, std::equal_to<Key>,
+                                           common::hugepage_allocator<std::pair<const Key, T>>>();}
+        ));
     }
 
     T& operator[](const Key &key) override {
@@ -44,12 +49,32 @@ public:
         }
     }
 
+    const T* find_ptr(const Key &key) const override {
+        auto it = map.find(key);
+        if (it == map.end()) {
+            return nullptr;
+        } else {
+            return &it->second;
+        }
+    }
+
     size_t erase(const Key &key) override {
         return map.erase(key);
     }
 
     size_t size() const override { return map.size(); }
 
+    /// Every bucket is one slot holding a chain. The bytes are an estimate:
+    /// the bucket array plus a node with a next pointer and cached hash per
+    /// entry, as in libstdc++.
+    void inspect(common::structure_stats &stats) const override {
+        for (size_t i = 0; i < map.bucket_count(); ++i) {
+            stats.add_bucket(1, map.bucket_size(i), 0);
+        }
+        stats.bytes += sizeof(*this) + map.bucket_count() * sizeof(void*)
+            + map.size() * (sizeof(std::pair<const Key, T>) + sizeof(void*) + sizeof(size_t));
+    }
+
     void clear() override { map.clear(); }
 
 protected:
@@ -48,7 +48,8 @@ public:
         using Key = typename HashTable::key_type;
 
         common::register_benchmark("wordcount", "wordcount",
-            [](HashTable&, Configuration config, void*) -> void* {
+            [](HashTable &map, Configuration config, void*) -> void* {
+                map.seed(config.second);
                 size_t nameIndex = config.first;
                 std::map < size_t, std::pair< std::string, std::string > >  fileNameMap = getFileNameMap();
                 std::pair< std::string, std::string > namePair = fileNameMap[nameIndex];
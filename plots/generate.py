@@ -33,9 +33,14 @@ plot_types = [
     ("PAPI_instr", [("total cycles", "cycles", "Total_cycles", {}),
                     ("instructions completed", "instructions", "Instr_completed", {}),
                     ("branch mispredictions", "branchmiss", "Cond_br_mspredictd", {})]),
+    ("PAPI_tlb", [("data TLB misses", "dtlbmiss", "Data_TLB_misses", {"keypos": "top left"}),
+                  ("instruction TLB misses", "itlbmiss", "Instr_TLB_misses", {})]),
     ("memory", [("number of allocations", "mem_mallocs", "mallocs", {"logscale": False}),
                 ("total memory allocated", "mem_total", "totalmem", {"logscale": False}),
-                ("peak memory usage", "mem_peak", "peakmem", {"logscale": False})])
+                ("peak memory usage", "mem_peak", "peakmem", {"logscale": False})]),
+    ("structure", [("allocated slots", "slots", "slots", {"logscale": False}),
+                   ("structure size", "structbytes", "structbytes", {"logscale": False, "add": " in bytes"}),
+                   ("tombstones", "tombstones", "tombstones", {"logscale": False})])
 ]
 
 # Name, Abbrevitation, Benchmarks=[(name, col)]
@@ -2,7 +2,9 @@
 
 #include <queue>
 #include <utility>
+#include <vector>
 
+#include "../common/hugepage_allocator.h"
 #include "priority_queue.h"
 
 namespace pq {
@@ -22,6 +24,9 @@ public:
         list.register_contender(Factory("std::priority_queue with deque", "std::priority-queue-deque",
             [](){ return new std_pq<T, std::deque<T>>();}
         ));
+        list.register_contender(Factory("std::priority_queue with huge pages", "std::priority-queue-hugepages",
+            [](){ return new std_pq<T, std::vector<T, common::hugepage_allocator<T>>>();}
+        ));
     }
 
     /// Add an element to the priority queue by const lvalue reference
@@ -0,0 +1,198 @@
+#include "catch.hpp"
+
+#include <common/maybe.h>
+#include <hashtable/DPH_Common.h>
+
+SCENARIO("DPH prime table", "[hashtable]") {
+	GIVEN("The shared prime table") {
+		WHEN("We ask for the next prime of small numbers") {
+			THEN("We get the smallest prime that is not less") {
+				CHECK(hashtable::prime_table::next(0) == 2);
+				CHECK(hashtable::prime_table::next(2) == 2);
+				CHECK(hashtable::prime_table::next(3) == 3);
+				CHECK(hashtable::prime_table::next(4) == 5);
+				CHECK(hashtable::prime_table::next(90) == 97);
+				CHECK(hashtable::prime_table::next(7000) == 7001);
+			}
+		}
+		WHEN("We ask for primes beyond the sieve") {
+			THEN("The Miller-Rabin fallback finds them") {
+				CHECK(hashtable::prime_table::next(4194304) == 4194319);
+				CHECK(hashtable::prime_table::next(1000000000) == 1000000007);
+			}
+		}
+	}
+}
+
+SCENARIO("DPH fast modulo", "[hashtable]") {
+	GIVEN("Some divisors") {
+		const size_t divisors[] = {1, 2, 3, 10, 97, 4194319, 1000000007, size_t(1) << 40};
+		WHEN("We reduce numbers with them") {
+			THEN("The result equals the hardware remainder") {
+				for (size_t divisor : divisors) {
+					hashtable::fast_modulo modulo(divisor);
+					for (size_t x : {size_t(0), size_t(1), divisor - 1, divisor, 123456789 * divisor + 5, ~size_t(0)}) {
+						CHECK(modulo(x) == x % divisor);
+					}
+				}
+			}
+		}
+	}
+}
+
+SCENARIO("DPH random generator", "[hashtable]") {
+	GIVEN("Two generators with the same seed") {
+		hashtable::random_generator first(42), second(42);
+		WHEN("We draw from both") {
+			THEN("They produce the same sequence") {
+				for (size_t i = 0; i < 100; ++i) {
+					CHECK(first(1, 96) == second(1, 96));
+				}
+			}
+		}
+		WHEN("We reseed one of them") {
+			first(0, 10);
+			first.seed(42);
+			THEN("It starts over") {
+				CHECK(first() == second());
+			}
+		}
+	}
+	GIVEN("A generator") {
+		hashtable::random_generator randoms;
+		WHEN("We draw from a range") {
+			THEN("All values lie in the range") {
+				for (size_t i = 0; i < 1000; ++i) {
+					size_t value = randoms(5, 7);
+					CHECK(value >= 5);
+					CHECK(value <= 7);
+				}
+				CHECK(randoms(3, 3) == 3);
+			}
+		}
+	}
+}
+
+SCENARIO("Bitmap storage for DPH buckets", "[hashtable]") {
+	GIVEN("A bitmap storage array with some entries") {
+		hashtable::bitmap_storage::array<int, int> entries(200);
+		entries[3].initialize(30);
+		entries[3].getValue() = 300;
+		entries[64].initialize(640);
+		entries[199].initialize(1990);
+		entries[199].markDeleted();
+
+		WHEN("We look up entries") {
+			THEN("Only live entries with the same key are found") {
+				CHECK(entries.find(3, 30) == just<int>(300));
+				CHECK(!entries.find(3, 31).valid);
+				CHECK(!entries.find(4, 0).valid);
+				CHECK(!entries.find(199, 1990).valid);
+			}
+		}
+		WHEN("We visit the live entries") {
+			std::vector<int> keys;
+			entries.forEachLive([&](hashtable::bitmap_storage::array<int, int>::reference entry) {
+				keys.push_back(entry.getKey());
+			});
+			THEN("Empty and deleted slots are skipped") {
+				CHECK(keys == std::vector<int>({30, 640}));
+			}
+		}
+		WHEN("We copy an entry out and back in") {
+			hashtable::bucket_entry<int, int> entry = entries[3];
+			entries[3] = hashtable::bucket_entry<int, int>();
+			CHECK(!entries.find(3, 30).valid);
+			entries[5] = entry;
+			THEN("It keeps its key, value and flags") {
+				CHECK(entries.find(5, 30) == just<int>(300));
+			}
+		}
+	}
+}
+
+SCENARIO("Scratch buffers for rebuilding DPH buckets", "[hashtable]") {
+	GIVEN("The scratch of this thread with freed slots") {
+		hashtable::rehash_scratch<int, int>& scratch = hashtable::rehash_scratch<int, int>::local();
+		scratch.freeSlots(130);
+
+		WHEN("We take slots") {
+			THEN("Every slot can be taken exactly once") {
+				CHECK(scratch.takeSlot(0));
+				CHECK(scratch.takeSlot(129));
+				CHECK(!scratch.takeSlot(129));
+				CHECK(scratch.takeSlot(64));
+				CHECK(!scratch.takeSlot(0));
+			}
+		}
+		WHEN("We free the slots again") {
+			scratch.takeSlot(7);
+			scratch.freeSlots(20);
+			THEN("Taken slots are free") {
+				CHECK(scratch.takeSlot(7));
+				CHECK(!scratch.takeSlot(7));
+			}
+		}
+	}
+	GIVEN("The pre-hashed keys of a bucket") {
+		hashtable::rehash_scratch<int, int>& scratch = hashtable::rehash_scratch<int, int>::local();
+		std::vector<hashtable::bucket_entry<int, int>> entries(200);
+		for (size_t i = 0; i < entries.size(); ++i) {
+			entries[i].initialize(int(3 * i));
+		}
+		scratch.preHash(entries.data(), entries.size(), std::hash<int>());
+		hashtable::random_generator randoms;
+
+		WHEN("A hash function is injective on them") {
+			hashtable::prime_modulo_family<>::function f;
+			do {
+				f.randomize(randoms, 100000);
+			} while (!scratch.isInjective(f, 100000));
+			THEN("Their slots are the hash values") {
+				size_t wrong = 0;
+				for (size_t i = 0; i < entries.size(); ++i) {
+					wrong += scratch.slots[i] != f(std::hash<int>()(entries[i].getKey()));
+				}
+				CHECK(wrong == 0);
+			}
+		}
+		WHEN("There are more keys than slots") {
+			hashtable::prime_modulo_family<>::function f;
+			f.randomize(randoms, 150);
+			THEN("No hash function is injective") {
+				CHECK(!scratch.isInjective(f, 150));
+			}
+		}
+	}
+}
+
+template <typename HashFamily>
+static size_t blockHashMismatches(size_t size) {
+	hashtable::random_generator randoms(size);
+	typename HashFamily::function f;
+	f.randomize(randoms, size);
+	std::vector<size_t> keys(103), slots(keys.size());
+	for (size_t i = 0; i < keys.size(); ++i) {
+		keys[i] = randoms();
+	}
+	f.hashBlock(keys.data(), slots.data(), keys.size());
+	size_t mismatches = 0;
+	for (size_t i = 0; i < keys.size(); ++i) {
+		mismatches += slots[i] != f(keys[i]);
+	}
+	return mismatches;
+}
+
+SCENARIO("Hashing blocks of keys", "[hashtable]") {
+	GIVEN("The hash families") {
+		THEN("hashBlock agrees with hashing one key at a time") {
+			for (size_t size : {size_t(1), size_t(7), size_t(1024), size_t(1) << 31, size_t(1) << 32}) {
+				CHECK(blockHashMismatches<hashtable::multiply_shift_family>(size) == 0);
+				CHECK(blockHashMismatches<hashtable::tabulation_family>(size) == 0);
+			}
+			for (size_t size : {size_t(1), size_t(7), size_t(1031)}) {
+				CHECK(blockHashMismatches<hashtable::prime_modulo_family<>>(size) == 0);
+			}
+		}
+	}
+}
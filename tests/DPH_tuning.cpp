@@ -0,0 +1,63 @@
+#include "catch.hpp"
+
+#include <memory>
+#include <sstream>
+
+#include <hashtable/DPH_tuning.h>
+
+SCENARIO("DPH parameter tuning helpers", "[hashtable]") {
+	GIVEN("Some measured parameter sets") {
+		hashtable::DPH_parameters a{7, 2, 5, 2, 6, 3500};
+		hashtable::DPH_parameters b{3, 1, 5, 2, 2, 3500};
+		hashtable::DPH_parameters c{3, 2, 5, 2, 2, 1000};
+		hashtable::DPH_parameters d{11, 4, 5, 2, 10, 1000};
+		std::vector<hashtable::DPH_tuning_point> points{
+			{a, 20, 100}, {b, 15, 40}, {c, 10, 60}, {d, 12, 80}
+		};
+
+		WHEN("We compute the Pareto front") {
+			std::vector<hashtable::DPH_tuning_point> front = hashtable::DPH_pareto_front(points);
+			THEN("It holds the undominated points ordered by time") {
+				REQUIRE(front.size() == 2);
+				CHECK(front[0].parameters == c);
+				CHECK(front[1].parameters == b);
+			}
+		}
+		WHEN("We write and read a parameter set") {
+			std::stringstream s;
+			s << a;
+			hashtable::DPH_parameters read{0, 0, 0, 0, 0, 0};
+			s >> read;
+			THEN("It is the same set") {
+				CHECK(read == a);
+				CHECK(a == hashtable::DPH_parameters::defaults());
+				CHECK(a.key() == "7-2-5-2-6-3500");
+			}
+		}
+		WHEN("We ask for the neighbours of a set at the lower bounds") {
+			hashtable::DPH_parameters low{2, 1, 1, 2, 1, 120};
+			std::vector<hashtable::DPH_parameters> neighbours = hashtable::DPH_tuning_neighbours(low);
+			THEN("Only valid sets one step away are proposed") {
+				CHECK(neighbours.size() == 6);
+				for (const hashtable::DPH_parameters &p : neighbours) {
+					CHECK(p.bucketCapacityFactor >= 2);
+					CHECK(p.bucketLengthFactor >= 1);
+					CHECK(p.bucketMaxRehashAttempts >= 1);
+					CHECK(p.bucketRehashLengthFactor >= 2);
+					CHECK(p.tableCapacityFactor >= 1);
+					CHECK(p.elementAmountPerBucket >= 100);
+				}
+			}
+		}
+		WHEN("We build a table from a parameter set") {
+			std::unique_ptr<hashtable::hashtable<int, int>> m(c.create<int, int>());
+			for (int i = 0; i < 10000; ++i) {
+				(*m)[i] = i;
+			}
+			THEN("It works like any other") {
+				CHECK(m->size() == 10000);
+				CHECK(m->find(9999) == just<int>(9999));
+			}
+		}
+	}
+}
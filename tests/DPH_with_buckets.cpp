@@ -1,6 +1,9 @@
 #include "../hashtable/DPH_with_buckets.h"
 #include "catch.hpp"
 
+#include <random>
+#include <unordered_map>
+
 SCENARIO("DPH_with_buckets's basic functions work", "[hashtable]") {
 	GIVEN("A DPH_with_buckets") {
 		hashtable::DPH_with_buckets<unsigned int, unsigned int> m(100);
@@ -29,6 +32,22 @@ SCENARIO("DPH_with_buckets's basic functions work", "[hashtable]") {
 			}
 		}
 
+		WHEN("We look up elements without copying them") {
+			THEN("find_ptr points to the stored value") {
+				const unsigned int* value = m.find_ptr(10);
+				REQUIRE(value != nullptr);
+				CHECK(*value == 100);
+				m[10] = 42;
+				CHECK(*m.find_ptr(10) == 42);
+				CHECK(m.find_ptr(n) == nullptr);
+			}
+			AND_THEN("contains tells which keys are stored") {
+				CHECK(m.contains(0));
+				CHECK(m.contains(n-1));
+				CHECK(!m.contains(n));
+			}
+		}
+
 		WHEN("We insert more elements") {
 			m[n] = n;
 			THEN("We can retrieve them again using find or operator[]") {
@@ -73,6 +92,25 @@ SCENARIO("DPH_with_buckets's basic functions work", "[hashtable]") {
 				CHECK(m.find(0) == nothing<unsigned int>());
 			}
 		}
+
+		WHEN("We clear it after it grew to more buckets") {
+			const size_t grown = 50000;
+			for (size_t i = n; i < grown; ++i) {
+				m[i] = i;
+			}
+			m.clear();
+			for (size_t i = 0; i < grown; ++i) {
+				m[i] = i;
+			}
+			THEN("It keeps everything inserted since") {
+				size_t wrong = 0;
+				for (size_t i = 0; i < grown; ++i) {
+					wrong += m.find(i) != just<unsigned int>(i);
+				}
+				CHECK(wrong == 0);
+				CHECK(m.size() == grown);
+			}
+		}
 	}
 }
 
@@ -175,3 +213,383 @@ SCENARIO("DPH_with_buckets rehash counting", "[hashtable]") {
 
 	}
 }
+
+SCENARIO("DPH_with_buckets incremental rehashing", "[hashtable]") {
+	GIVEN("A DPH_with_buckets that migrates a few slots per operation") {
+		hashtable::DPH_with_buckets<int, int> m(1000, 7, 2, 5, 2, 6, 3500, 4);
+		// The table starts a migration at 56000 operations, which is still
+		// running when the erasing begins
+		size_t elementAmount = 60000;
+		for (size_t i = 0; i < elementAmount; ++i) {
+			m[i] = i;
+		}
+
+		WHEN("Elements are erased while a migration is running") {
+			size_t erased = 0;
+			for (size_t i = 0; i < elementAmount; i += 2) {
+				erased += m.erase(i);
+			}
+			CHECK(erased == elementAmount / 2);
+			THEN("Exactly the remaining elements are found") {
+				CHECK(m.size() == elementAmount / 2);
+				size_t wrong = 0;
+				for (size_t i = 0; i < elementAmount; ++i) {
+					bool found = m.find(i) == just<int>(i);
+					if (found != (i % 2 == 1)) {
+						++wrong;
+					}
+				}
+				CHECK(wrong == 0);
+			}
+		}
+		WHEN("We erase a key that isn't stored") {
+			THEN("Nothing is erased") {
+				CHECK(m.erase(elementAmount) == 0);
+				CHECK(m.size() == elementAmount);
+			}
+		}
+	}
+}
+
+SCENARIO("DPH_with_buckets parallel rehashing", "[hashtable]") {
+	GIVEN("A DPH_with_buckets that rehashes on four threads") {
+		hashtable::DPH_with_buckets<int, int> m(1000, 7, 2, 5, 2, 6, 3500, 0, 4);
+		size_t elementAmount = 60000;
+		for (size_t i = 0; i < elementAmount; ++i) {
+			m[i] = i*i;
+		}
+
+		THEN("All elements are found") {
+			CHECK(m.size() == elementAmount);
+			size_t wrong = 0;
+			for (size_t i = 0; i < elementAmount; ++i) {
+				if (!(m.find(i) == just<int>(i*i))) {
+					++wrong;
+				}
+			}
+			CHECK(wrong == 0);
+		}
+	}
+}
+
+SCENARIO("DPH_with_buckets bulk building", "[hashtable]") {
+	GIVEN("A DPH_with_buckets built from a range with repeated keys") {
+		size_t elementAmount = 20000;
+		std::vector<std::pair<int, int>> pairs;
+		for (size_t i = 0; i < elementAmount; ++i) {
+			pairs.push_back(std::make_pair(int(i), int(i)));
+		}
+		for (size_t i = 0; i < elementAmount; i += 2) {
+			pairs.push_back(std::make_pair(int(i), int(i*i)));
+		}
+		hashtable::DPH_with_buckets<int, int> m(pairs.begin(), pairs.end());
+
+		THEN("Every key is stored once, with its last value") {
+			CHECK(m.size() == elementAmount);
+			size_t wrong = 0;
+			for (size_t i = 0; i < elementAmount; ++i) {
+				int value = i % 2 == 0 ? int(i*i) : int(i);
+				if (!(m.find(i) == just<int>(value))) {
+					++wrong;
+				}
+			}
+			CHECK(wrong == 0);
+		}
+
+		WHEN("We bulk insert into the filled table") {
+			std::vector<std::pair<int, int>> more;
+			for (size_t i = elementAmount / 2; i < 2 * elementAmount; ++i) {
+				more.push_back(std::make_pair(int(i), -int(i)));
+			}
+			m.bulk_insert(more.data(), more.data() + more.size());
+			THEN("New keys are added and stored keys are overwritten") {
+				CHECK(m.size() == 2 * elementAmount);
+				CHECK(m.find(1) == just<int>(1));
+				CHECK(m.find(elementAmount / 2) == just<int>(-int(elementAmount / 2)));
+				CHECK(m.find(2 * elementAmount - 1) == just<int>(-int(2 * elementAmount - 1)));
+			}
+			AND_THEN("The table keeps growing by single insertions") {
+				m[2 * elementAmount] = 7;
+				CHECK(m.find(2 * elementAmount) == just<int>(7));
+				CHECK(m.size() == 2 * elementAmount + 1);
+			}
+		}
+	}
+	GIVEN("A range that repeats every key ten times") {
+		size_t elementAmount = 20000;
+		std::vector<std::pair<int, int>> pairs, distinct;
+		for (size_t repetition = 0; repetition < 10; ++repetition) {
+			for (size_t i = 0; i < elementAmount; ++i) {
+				pairs.push_back(std::make_pair(int(i), int(repetition)));
+			}
+		}
+		for (size_t i = 0; i < elementAmount; ++i) {
+			distinct.push_back(std::make_pair(int(i), 9));
+		}
+		hashtable::DPH_with_buckets<int, int> repeated(pairs.begin(), pairs.end());
+		hashtable::DPH_with_buckets<int, int> once(distinct.begin(), distinct.end());
+		common::structure_stats repeatedStats, onceStats;
+		repeated.inspect(repeatedStats);
+		once.inspect(onceStats);
+
+		THEN("The table is sized for the distinct keys") {
+			CHECK(repeated.size() == elementAmount);
+			CHECK(repeated.find(elementAmount - 1) == just<int>(9));
+			CHECK(repeatedStats.buckets == onceStats.buckets);
+		}
+	}
+}
+
+SCENARIO("DPH_with_buckets with bitmap storage", "[hashtable]") {
+	GIVEN("A DPH_with_buckets that stores its entries in bitmaps") {
+		hashtable::DPH_with_buckets<int, int, std::hash<int>, hashtable::prime_modulo_family<>, hashtable::bitmap_storage> m(100);
+		size_t elementAmount = 20000;
+		for (size_t i = 0; i < elementAmount; ++i) {
+			m[i] = i*i;
+		}
+		size_t erased = 0;
+		for (size_t i = 0; i < elementAmount; i += 2) {
+			erased += m.erase(i);
+		}
+
+		THEN("Exactly the remaining elements are found") {
+			CHECK(erased == elementAmount / 2);
+			CHECK(m.size() == elementAmount / 2);
+			size_t wrong = 0;
+			for (size_t i = 0; i < elementAmount; ++i) {
+				bool found = m.find(i) == just<int>(i*i);
+				if (found != (i % 2 == 1)) {
+					++wrong;
+				}
+			}
+			CHECK(wrong == 0);
+		}
+	}
+}
+
+SCENARIO("DPH_with_buckets with compile-time parameters", "[hashtable]") {
+	GIVEN("A DPH_with_buckets whose tuning factors are template arguments") {
+		hashtable::DPH_with_buckets<int, int, std::hash<int>, hashtable::prime_modulo_family<>, hashtable::entry_vector_storage,
+									hashtable::static_parameters<3, 1, 4, 2, 2, 15000>> m(100);
+		size_t elementAmount = 20000;
+		for (size_t i = 0; i < elementAmount; ++i) {
+			m[i] = i*i;
+		}
+
+		THEN("They behave like the runtime factors") {
+			CHECK(m.size() == elementAmount);
+			size_t wrong = 0;
+			for (size_t i = 0; i < elementAmount; ++i) {
+				if (m.find(i) != just<int>(i*i)) {
+					++wrong;
+				}
+			}
+			CHECK(wrong == 0);
+			CHECK(m.erase(7) == 1);
+			CHECK(m.find(7) == nothing<int>());
+		}
+	}
+}
+
+SCENARIO("DPH_with_buckets structure statistics", "[hashtable]") {
+	GIVEN("A DPH_with_buckets with erased elements") {
+		hashtable::DPH_with_buckets<int, int> m(100);
+		size_t elementAmount = 20000;
+		for (size_t i = 0; i < elementAmount; ++i) {
+			m[i] = i;
+		}
+		for (size_t i = 0; i < elementAmount; i += 4) {
+			m.erase(i);
+		}
+		common::structure_stats stats;
+		m.inspect(stats);
+
+		THEN("The live entries, tombstones and slots add up") {
+			CHECK(stats.entries == m.size());
+			CHECK(stats.tombstones <= elementAmount / 4);
+			CHECK(stats.slots >= stats.entries + stats.tombstones);
+			CHECK(stats.bytes >= stats.slots * sizeof(int) * 2);
+		}
+		THEN("Every bucket is in one size class") {
+			size_t buckets = 0;
+			for (size_t c = 0; c < common::structure_stats::size_classes; ++c) {
+				buckets += stats.bucketSizes[c];
+			}
+			CHECK(stats.buckets > 0);
+			CHECK(buckets == stats.buckets);
+		}
+	}
+	GIVEN("The size classes") {
+		THEN("They are powers of two, the last one open") {
+			CHECK(common::structure_stats::size_class(0) == 0);
+			CHECK(common::structure_stats::size_class(1) == 1);
+			CHECK(common::structure_stats::size_class(3) == 2);
+			CHECK(common::structure_stats::size_class(4) == 3);
+			CHECK(common::structure_stats::size_class(size_t(1) << 40) == common::structure_stats::size_classes - 1);
+		}
+	}
+}
+
+SCENARIO("DPH_with_buckets recycling tombstones", "[hashtable]") {
+	GIVEN("A DPH_with_buckets that recycles tombstones under a sliding window of keys") {
+		hashtable::DPH_with_buckets<int, int, std::hash<int>, hashtable::prime_modulo_family<>, hashtable::entry_vector_storage,
+									hashtable::runtime_parameters, hashtable::recycling_deletion<>> m(100);
+		const int window = 5000;
+		for (int i = 0; i < window; ++i) {
+			m[i] = i;
+		}
+		auto slide = [&](int from, int amount) {
+			for (int i = from; i < from + amount; ++i) {
+				m.erase(i);
+				m[i + window] = i;
+			}
+		};
+		slide(0, 4 * window);
+		common::structure_stats warm;
+		m.inspect(warm);
+		slide(4 * window, 16 * window);
+		common::structure_stats later;
+		m.inspect(later);
+
+		THEN("Exactly the keys in the window are found") {
+			CHECK(m.size() == size_t(window));
+			size_t wrong = 0;
+			for (int i = 0; i < 21 * window; ++i) {
+				bool inWindow = i >= 20 * window;
+				if (m.contains(i) != inWindow || (inWindow && m.find(i) != just<int>(i - window))) {
+					++wrong;
+				}
+			}
+			CHECK(wrong == 0);
+		}
+		THEN("The table reaches a steady state") {
+			CHECK(later.slots <= warm.slots);
+			CHECK(later.tombstones <= later.slots / 2);
+		}
+	}
+	GIVEN("A DPH_with_buckets with bitmap storage that recycles tombstones") {
+		hashtable::DPH_with_buckets<int, int, std::hash<int>, hashtable::prime_modulo_family<>, hashtable::bitmap_storage,
+									hashtable::runtime_parameters, hashtable::recycling_deletion<>> m(100);
+		size_t elementAmount = 20000;
+		for (size_t round = 0; round < 3; ++round) {
+			for (size_t i = 0; i < elementAmount; ++i) {
+				m[i] = i + round;
+			}
+			for (size_t i = 0; i < elementAmount; i += 2) {
+				m.erase(i);
+			}
+		}
+
+		THEN("Purged slots don't come back") {
+			CHECK(m.size() == elementAmount / 2);
+			size_t wrong = 0;
+			for (size_t i = 0; i < elementAmount; ++i) {
+				bool found = m.find(i) == just<int>(i + 2);
+				if (found != (i % 2 == 1)) {
+					++wrong;
+				}
+			}
+			CHECK(wrong == 0);
+		}
+	}
+	GIVEN("A DPH_with_buckets that recycles tombstones and a std::unordered_map") {
+		hashtable::DPH_with_buckets<int, int, std::hash<int>, hashtable::prime_modulo_family<>, hashtable::entry_vector_storage,
+									hashtable::runtime_parameters, hashtable::recycling_deletion<>> m(0);
+		std::unordered_map<int, int> reference;
+		std::mt19937 gen(7);
+		std::uniform_int_distribution<int> keys(0, 50000);
+		size_t wrongErases = 0;
+		for (int i = 0; i < 200000; ++i) {
+			int key = keys(gen);
+			if (i % 3 == 2) {
+				wrongErases += m.erase(key) != reference.erase(key);
+			} else {
+				m[key] = i;
+				reference[key] = i;
+			}
+		}
+
+		THEN("Colliding inserts and erases keep the same size and entries") {
+			CHECK(wrongErases == 0);
+			CHECK(m.size() == reference.size());
+			size_t wrong = 0;
+			for (int key = 0; key <= 50000; ++key) {
+				auto it = reference.find(key);
+				if (it == reference.end() ? m.contains(key) : m.find(key) != just<int>(it->second)) {
+					++wrong;
+				}
+			}
+			CHECK(wrong == 0);
+		}
+	}
+}
+
+namespace {
+
+template <typename Trigger, typename Sizing, typename Retry>
+using policy_table = hashtable::DPH_with_buckets<int, int, std::hash<int>, hashtable::prime_modulo_family<>,
+												 hashtable::entry_vector_storage, hashtable::runtime_parameters,
+												 hashtable::counting_deletion, Trigger, Sizing, Retry>;
+
+/// Fills a table with scattered keys, erases most of them again and
+/// returns the number of wrong lookups
+template <typename Trigger, typename Sizing, typename Retry>
+size_t policyMismatches(const hashtable::runtime_parameters &parameters) {
+	policy_table<Trigger, Sizing, Retry> m(100, parameters);
+	const int n = 20000;
+	for (int i = 0; i < n; ++i) {
+		m[i * 7919] = i;
+	}
+	for (int i = 0; i < n; ++i) {
+		if (i % 4 != 0) {
+			m.erase(i * 7919);
+		}
+	}
+	size_t wrong = m.size() == size_t(n / 4) ? 0 : 1;
+	for (int i = 0; i < n; ++i) {
+		bool found = m.find(i * 7919) == just<int>(i);
+		if (found != (i % 4 == 0)) {
+			++wrong;
+		}
+	}
+	return wrong;
+}
+
+}
+
+SCENARIO("DPH_with_buckets rehash policies", "[hashtable]") {
+	using namespace hashtable;
+	GIVEN("Every growth trigger, bucket sizing and retry policy") {
+		const runtime_parameters defaults, compact(2, 2, 5, 2, 2, 3000);
+
+		THEN("All combinations keep exactly the remaining keys") {
+			CHECK((policyMismatches<update_trigger, multiplicative_sizing, sticky_retries>(defaults)) == 0);
+			CHECK((policyMismatches<update_trigger, proportional_sizing, sticky_retries>(defaults)) == 0);
+			CHECK((policyMismatches<load_trigger, multiplicative_sizing, sticky_retries>(defaults)) == 0);
+			CHECK((policyMismatches<load_trigger, proportional_sizing, sticky_retries>(defaults)) == 0);
+			CHECK((policyMismatches<update_trigger, proportional_sizing, resetting_retries>(compact)) == 0);
+			CHECK((policyMismatches<load_trigger, proportional_sizing, resetting_retries>(compact)) == 0);
+		}
+	}
+	GIVEN("A table that rehashes by load, filled and then mostly emptied") {
+		policy_table<load_trigger, proportional_sizing, sticky_retries> m(100, runtime_parameters(2, 2, 5, 2, 2, 3000));
+		const int n = 20000;
+		for (int i = 0; i < n; ++i) {
+			m[i] = i;
+		}
+		common::structure_stats full;
+		m.inspect(full);
+		for (int i = 100; i < n; ++i) {
+			m.erase(i);
+		}
+		m.erase(n);
+		common::structure_stats emptied;
+		m.inspect(emptied);
+
+		THEN("It shrinks") {
+			CHECK(m.size() == 100);
+			CHECK(emptied.slots < full.slots / 10);
+			CHECK(m.find(99) == just<int>(99));
+		}
+	}
+}
@@ -29,6 +29,22 @@ SCENARIO("DPH_with_buckets_2's basic functions work", "[hashtable]") {
 			}
 		}
 
+		WHEN("We look up elements without copying them") {
+			THEN("find_ptr points to the stored value") {
+				const unsigned int* value = m.find_ptr(10);
+				REQUIRE(value != nullptr);
+				CHECK(*value == 100);
+				m[10] = 42;
+				CHECK(*m.find_ptr(10) == 42);
+				CHECK(m.find_ptr(n) == nullptr);
+			}
+			AND_THEN("contains tells which keys are stored") {
+				CHECK(m.contains(0));
+				CHECK(m.contains(n-1));
+				CHECK(!m.contains(n));
+			}
+		}
+
 		WHEN("We insert more elements") {
 			m[n] = n;
 			THEN("We can retrieve them again using find or operator[]") {
@@ -174,3 +190,69 @@ SCENARIO("DPH_with_buckets_2 rehash counting", "[hashtable]") {
 
 	}
 }
+
+SCENARIO("DPH_with_buckets_2 parallel rehashing", "[hashtable]") {
+	GIVEN("A DPH_with_buckets_2 that rehashes on four threads") {
+		hashtable::DPH_with_buckets_2<int, int> m(100, 2, 2, 5, 2, 2, 3000, 4);
+		size_t elementAmount = 20000;
+		for (size_t i = 0; i < elementAmount; ++i) {
+			m[i] = i*i;
+		}
+
+		THEN("All elements are found") {
+			CHECK(m.size() == elementAmount);
+			size_t wrong = 0;
+			for (size_t i = 0; i < elementAmount; ++i) {
+				if (!(m.find(i) == just<int>(i*i))) {
+					++wrong;
+				}
+			}
+			CHECK(wrong == 0);
+		}
+	}
+}
+
+SCENARIO("DPH_with_buckets_2 bulk building", "[hashtable]") {
+	GIVEN("A DPH_with_buckets_2 built from a range with repeated keys") {
+		size_t elementAmount = 20000;
+		std::vector<std::pair<int, int>> pairs;
+		for (size_t i = 0; i < elementAmount; ++i) {
+			pairs.push_back(std::make_pair(int(i), int(i)));
+		}
+		for (size_t i = 0; i < elementAmount; i += 2) {
+			pairs.push_back(std::make_pair(int(i), int(i*i)));
+		}
+		hashtable::DPH_with_buckets_2<int, int> m(pairs.begin(), pairs.end());
+
+		THEN("Every key is stored once, with its last value") {
+			CHECK(m.size() == elementAmount);
+			size_t wrong = 0;
+			for (size_t i = 0; i < elementAmount; ++i) {
+				int value = i % 2 == 0 ? int(i*i) : int(i);
+				if (!(m.find(i) == just<int>(value))) {
+					++wrong;
+				}
+			}
+			CHECK(wrong == 0);
+		}
+
+		WHEN("We bulk insert into the filled table") {
+			std::vector<std::pair<int, int>> more;
+			for (size_t i = elementAmount / 2; i < 2 * elementAmount; ++i) {
+				more.push_back(std::make_pair(int(i), -int(i)));
+			}
+			m.bulk_insert(more.data(), more.data() + more.size());
+			THEN("New keys are added and stored keys are overwritten") {
+				CHECK(m.size() == 2 * elementAmount);
+				CHECK(m.find(1) == just<int>(1));
+				CHECK(m.find(elementAmount / 2) == just<int>(-int(elementAmount / 2)));
+				CHECK(m.find(2 * elementAmount - 1) == just<int>(-int(2 * elementAmount - 1)));
+			}
+			AND_THEN("The table keeps growing by single insertions") {
+				m[2 * elementAmount] = 7;
+				CHECK(m.find(2 * elementAmount) == just<int>(7));
+				CHECK(m.size() == 2 * elementAmount + 1);
+			}
+		}
+	}
+}
@@ -0,0 +1,122 @@
+#include "../hashtable/DPH_with_buckets_concurrent.h"
+#include "catch.hpp"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+SCENARIO("DPH_with_buckets_concurrent's basic functions work", "[hashtable]") {
+	GIVEN("A DPH_with_buckets_concurrent") {
+		hashtable::DPH_with_buckets_concurrent<unsigned int, unsigned int> m(100);
+		const size_t n = 5000;
+		for (size_t i = 0; i < n; ++i) {
+			m[i] = i*i;
+		}
+
+		THEN("It grows through bucket and global rehashes and keeps everything") {
+			size_t wrong = 0;
+			for (size_t i = 0; i < n; ++i) {
+				wrong += m.find(i) != just<unsigned int>(i*i);
+			}
+			CHECK(wrong == 0);
+			CHECK(m.size() == n);
+			CHECK(m.find(n) == nothing<unsigned int>());
+			CHECK(m.contains(n-1));
+			CHECK(!m.contains(n));
+			CHECK(m.concurrent_reads());
+		}
+
+		WHEN("Values are changed with insert") {
+			m.insert_or_assign(7, 1);
+			m.insert_or_assign(n, 2);
+			THEN("Both the old and the new key have the new value") {
+				CHECK(m.find(7) == just<unsigned int>(1));
+				CHECK(m.find(n) == just<unsigned int>(2));
+				CHECK(m.find(8) == just<unsigned int>(64));
+				CHECK(m.size() == n+1);
+			}
+		}
+
+		WHEN("We erase elements") {
+			size_t erased = 0;
+			for (size_t i = 0; i < n; i += 2) {
+				erased += m.erase(i);
+			}
+			THEN("Only the others are left") {
+				CHECK(erased == n/2);
+				size_t wrong = 0;
+				for (size_t i = 0; i < n; ++i) {
+					wrong += m.contains(i) != (i % 2 == 1);
+				}
+				CHECK(wrong == 0);
+				CHECK(m.size() == n/2);
+				CHECK(m.erase(0) == 0);
+			}
+			AND_THEN("Erased keys can be inserted again") {
+				m[0] = 3;
+				CHECK(m.find(0) == just<unsigned int>(3));
+			}
+		}
+
+		WHEN("It is cleared") {
+			m.clear();
+			THEN("It is empty and usable") {
+				CHECK(m.size() == 0);
+				CHECK(!m.contains(1));
+				m[1] = 1;
+				CHECK(m.find(1) == just<unsigned int>(1));
+			}
+		}
+	}
+}
+
+SCENARIO("DPH_with_buckets_concurrent readers during writes", "[hashtable]") {
+	GIVEN("A table with stable keys, read on three threads") {
+		hashtable::DPH_with_buckets_concurrent<unsigned int, unsigned int> m(100);
+		const unsigned int stable = 2000, added = 40000;
+		for (unsigned int i = 0; i < stable; ++i) {
+			m[i] = i*i;
+		}
+
+		std::atomic<bool> writing(true);
+		std::atomic<size_t> wrong(0), reads(0);
+		std::vector<std::thread> readers;
+		for (unsigned int r = 0; r < 3; ++r) {
+			readers.emplace_back([&, r]() {
+				std::mt19937 gen(r);
+				size_t myReads = 0;
+				do {
+					unsigned int key = gen() % stable;
+					if (m.find(key) != just<unsigned int>(key*key)) {
+						++wrong;
+					}
+					++myReads;
+				} while (writing);
+				reads += myReads;
+			});
+		}
+
+		WHEN("The writer inserts, erases and rewrites keys meanwhile") {
+			for (unsigned int i = stable; i < stable + added; ++i) {
+				m.insert_or_assign(i, i);
+				if (i % 3 == 0) {
+					m.erase(i);
+				}
+				if (i % 10 == 0) {
+					m.insert_or_assign(i % stable, (i % stable) * (i % stable));
+				}
+			}
+			writing = false;
+			for (auto &reader : readers) {
+				reader.join();
+			}
+
+			THEN("Every read saw the stable keys with their values") {
+				CHECK(wrong.load() == 0u);
+				CHECK(reads.load() >= 3u);
+				CHECK(m.size() == stable + added - added / 3);
+			}
+		}
+	}
+}
@@ -29,6 +29,22 @@ SCENARIO("DPH_with_single_vector basic functions work", "[hashtable]") {
 			}
 		}
 
+		WHEN("We look up elements without copying them") {
+			THEN("find_ptr points to the stored value") {
+				const unsigned int* value = m.find_ptr(10);
+				REQUIRE(value != nullptr);
+				CHECK(*value == 100);
+				m[10] = 42;
+				CHECK(*m.find_ptr(10) == 42);
+				CHECK(m.find_ptr(n) == nullptr);
+			}
+			AND_THEN("contains tells which keys are stored") {
+				CHECK(m.contains(0));
+				CHECK(m.contains(n-1));
+				CHECK(!m.contains(n));
+			}
+		}
+
 		WHEN("We insert more elements") {
 			m[n] = n;
 			THEN("We can retrieve them again using find or operator[]") {
@@ -64,6 +80,22 @@ SCENARIO("DPH_with_single_vector basic functions work", "[hashtable]") {
 			}
 		}
 
+		WHEN("We erase keys that aren't stored, some in the slots of stored keys") {
+			size_t erased = 0;
+			for (size_t i = n; i < n + 100000; ++i) {
+				erased += m.erase(i);
+			}
+			THEN("Nothing is erased") {
+				CHECK(erased == 0);
+				CHECK(m.size() == n);
+				size_t wrong = 0;
+				for (size_t i = 0; i < n; ++i) {
+					wrong += m.find(i) != just<unsigned int>(i*i);
+				}
+				CHECK(wrong == 0);
+			}
+		}
+
 		WHEN("We clear it") {
 			m.clear();
 			THEN("Its size changes to 0") {
@@ -168,7 +200,77 @@ SCENARIO("DPH_with_single_vector rehash counting", "[hashtable]") {
 			for (size_t i = 0; i < elementAmount; ++i) {
 				m[i] = i*i;
 			}
-			m.getRehashCounter().print();
+			CHECK(m[0] == 0);
+			CHECK(m[100] == 10000);
+			CHECK(m[4000] == 16000000);
+		}
+	}
+}
+
+SCENARIO("DPH_with_single_vector relocating growing buckets", "[hashtable]") {
+	GIVEN("A DPH_with_single_vector that moves growing buckets to the end") {
+		hashtable::DPH_with_single_vector<int, int> m(100, true);
+		size_t elementAmount = 20000;
+		for (size_t i = 0; i < elementAmount; ++i) {
+			m[i] = i*i;
+		}
+
+		THEN("All elements are found") {
+			CHECK(m.size() == elementAmount);
+			size_t wrong = 0;
+			for (size_t i = 0; i < elementAmount; ++i) {
+				if (!(m.find(i) == just<int>(i*i))) {
+					++wrong;
+				}
+			}
+			CHECK(wrong == 0);
+			CHECK(m.find(elementAmount) == nothing<int>());
+		}
+		WHEN("Elements are erased") {
+			for (size_t i = 0; i < elementAmount; i += 2) {
+				m.erase(i);
+			}
+			THEN("Exactly the remaining elements are found") {
+				CHECK(m.size() == elementAmount / 2);
+				size_t wrong = 0;
+				for (size_t i = 0; i < elementAmount; ++i) {
+					bool found = m.find(i) == just<int>(i*i);
+					if (found != (i % 2 == 1)) {
+						++wrong;
+					}
+				}
+				CHECK(wrong == 0);
+			}
+		}
+	}
+}
+
+SCENARIO("DPH_with_single_vector contenders", "[hashtable]") {
+	GIVEN("Every registered DPH_with_single_vector, with each hash family") {
+		common::contender_list<hashtable::hashtable<int, int>> contenders;
+		hashtable::DPH_with_single_vector<int, int>::register_contenders(contenders);
+		const int elementAmount = 4096;
+
+		THEN("Each keeps exactly the inserted and not erased elements") {
+			for (auto &factory : contenders) {
+				hashtable::hashtable<int, int>* m = factory();
+				for (int i = 0; i < elementAmount; ++i) {
+					(*m)[i] = i*i;
+				}
+				for (int i = 0; i < elementAmount; i += 3) {
+					m->erase(i);
+				}
+				size_t wrong = m->size() == size_t(elementAmount - (elementAmount + 2) / 3) ? 0 : 1;
+				for (int i = 0; i < elementAmount; ++i) {
+					bool found = m->find(i) == just<int>(i*i);
+					if (found != (i % 3 != 0)) {
+						++wrong;
+					}
+				}
+				INFO(factory.key());
+				CHECK(wrong == 0);
+				delete m;
+			}
 		}
 	}
 }
@@ -0,0 +1,35 @@
+#include "catch.hpp"
+
+#include <common/aligned_allocator.h>
+
+#include <cstdint>
+#include <vector>
+
+SCENARIO("aligned_allocator", "[allocator]") {
+	GIVEN("Vectors aligned to a cache line and to 4 KiB") {
+		std::vector<char, common::aligned_allocator<char>> line(3);
+		std::vector<int, common::aligned_allocator<int, 4096>> page(1000);
+		for (size_t i = 0; i < page.size(); ++i) {
+			page[i] = i;
+		}
+
+		THEN("Their data starts on a boundary") {
+			size_t lineOffset = reinterpret_cast<uintptr_t>(line.data()) % 64;
+			size_t pageOffset = reinterpret_cast<uintptr_t>(page.data()) % 4096;
+			CHECK(lineOffset == 0);
+			CHECK(pageOffset == 0);
+		}
+		WHEN("They grow") {
+			line.resize(1000, 'x');
+			page.resize(5000, 1);
+			THEN("The new blocks are aligned too, and the contents move along") {
+				size_t lineOffset = reinterpret_cast<uintptr_t>(line.data()) % 64;
+				size_t pageOffset = reinterpret_cast<uintptr_t>(page.data()) % 4096;
+				CHECK(lineOffset == 0);
+				CHECK(pageOffset == 0);
+				CHECK(page[999] == 999);
+				CHECK(page[4999] == 1);
+			}
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+
+#include "../hashtable/hashtable.h"
+
+/// Fills m with n scattered keys, erases two thirds of them and reinserts
+/// half of those in three rounds, and returns the number of wrong answers:
+/// keys that are missing or should be gone, a neighbouring key that was
+/// never inserted, a wrong size, or an erase of an erased key that succeeds
+template <typename Table>
+size_t churnMismatches(Table &m, size_t n) {
+	using Key = typename Table::key_type;
+	using T = typename Table::mapped_type;
+	for (size_t i = 0; i < n; ++i) {
+		m[Key(i * 7919)] = T(i);
+	}
+	for (int round = 0; round < 3; ++round) {
+		for (size_t i = 0; i < n; ++i) {
+			if (i % 3 != 0) {
+				m.erase(Key(i * 7919));
+			}
+		}
+		for (size_t i = 0; i < n; ++i) {
+			if (i % 3 == 1) {
+				m[Key(i * 7919)] = T(i);
+			}
+		}
+	}
+	size_t wrong = m.size() == (n + 2) / 3 + (n + 1) / 3 ? 0 : 1;
+	for (size_t i = 0; i < n; ++i) {
+		bool found = m.find(Key(i * 7919)) == just<T>(T(i));
+		wrong += found != (i % 3 != 2);
+		wrong += m.contains(Key(i * 7919 + 1));
+	}
+	wrong += m.erase(Key(2 * 7919));
+	return wrong;
+}
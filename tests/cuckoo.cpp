@@ -0,0 +1,136 @@
+#include "../hashtable/cuckoo.h"
+#include "catch.hpp"
+#include "churn.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+/// Churns a table filled to its maximum load
+template <size_t Choices>
+size_t choiceMismatches() {
+	hashtable::cuckoo<int, int, Choices> m;
+	m.seed(Choices);
+	return churnMismatches(m, 20000);
+}
+
+/// Sends every key to the same few slots
+struct clustering_hash {
+	size_t operator()(unsigned int key) const { return key % 3; }
+};
+
+/// Sends every key to the same slots
+struct constant_hash {
+	size_t operator()(unsigned int) const { return 0; }
+};
+
+}
+
+SCENARIO("cuckoo's basic functions work", "[hashtable]") {
+	GIVEN("A cuckoo table") {
+		hashtable::cuckoo<unsigned int, unsigned int> m;
+		const size_t n = 1000;
+		for (size_t i = 0; i < n; ++i) {
+			m[i] = i*i;
+		}
+
+		THEN("It finds everything it grew to hold") {
+			size_t wrong = 0;
+			for (size_t i = 0; i < n; ++i) {
+				wrong += m.find(i) != just<unsigned int>(i*i);
+			}
+			CHECK(wrong == 0);
+			CHECK(m.size() == n);
+			CHECK(m.find(n) == nothing<unsigned int>());
+			CHECK(m.find_ptr(n) == nullptr);
+			CHECK(m[n] == 0);
+			CHECK(m.size() == n+1);
+		}
+
+		WHEN("Its hash functions are reseeded") {
+			m.seed(42);
+			THEN("The entries stay") {
+				size_t wrong = 0;
+				for (size_t i = 0; i < n; ++i) {
+					wrong += m.find(i) != just<unsigned int>(i*i);
+				}
+				CHECK(wrong == 0);
+			}
+		}
+
+		WHEN("It is cleared") {
+			m.clear();
+			THEN("It is empty and usable") {
+				CHECK(m.size() == 0);
+				CHECK(!m.contains(1));
+				m[1] = 1;
+				CHECK(m.find(1) == just<unsigned int>(1));
+			}
+		}
+	}
+	GIVEN("A table with string keys") {
+		hashtable::cuckoo<std::string, int, 3> m;
+		m["foo"] = 1;
+		m["bar"] = 2;
+		m.erase("foo");
+		THEN("It stores them") {
+			CHECK(m.find("bar") == just<int>(2));
+			CHECK(!m.contains("foo"));
+		}
+	}
+}
+
+SCENARIO("cuckoo choices and stash", "[hashtable]") {
+	GIVEN("Two to four hash functions") {
+		THEN("All of them keep exactly the remaining keys") {
+			CHECK(choiceMismatches<2>() == 0);
+			CHECK(choiceMismatches<3>() == 0);
+			CHECK(choiceMismatches<4>() == 0);
+		}
+	}
+	GIVEN("Keys whose hash functions only reach a few slots") {
+		hashtable::cuckoo<unsigned int, unsigned int, 2, clustering_hash> m;
+		const unsigned int n = 8;
+		for (unsigned int i = 0; i < n; ++i) {
+			m[i] = i;
+		}
+
+		THEN("The ones that don't fit are stashed") {
+			size_t wrong = 0;
+			for (unsigned int i = 0; i < n; ++i) {
+				wrong += m.find(i) != just<unsigned int>(i);
+			}
+			CHECK(wrong == 0);
+			CHECK(m.size() == n);
+		}
+		WHEN("Stashed keys are erased") {
+			for (unsigned int i = 0; i < n; i += 2) {
+				m.erase(i);
+			}
+			THEN("The others stay") {
+				size_t wrong = 0;
+				for (unsigned int i = 0; i < n; ++i) {
+					wrong += m.contains(i) != (i % 2 == 1);
+				}
+				CHECK(wrong == 0);
+				CHECK(m.size() == n/2);
+			}
+		}
+	}
+	GIVEN("Keys that all have the same slots") {
+		hashtable::cuckoo<unsigned int, unsigned int, 2, constant_hash> m;
+		THEN("Inserting more than the slots and the stash hold throws") {
+			bool threw = false;
+			try {
+				for (unsigned int i = 0; i < 20; ++i) {
+					m[i] = i;
+				}
+			} catch (const std::length_error &) {
+				threw = true;
+			}
+			CHECK(threw);
+			CHECK(m.size() == 0);
+		}
+	}
+}
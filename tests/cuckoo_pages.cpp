@@ -0,0 +1,124 @@
+#include "../hashtable/cuckoo_pages.h"
+#include "catch.hpp"
+#include "churn.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+/// Churns a table filled close to its maximum load
+template <size_t PageLines, size_t SlotsPerBucket>
+size_t pageMismatches() {
+	hashtable::cuckoo_pages<int, int, PageLines, SlotsPerBucket> m;
+	m.seed(PageLines);
+	return churnMismatches(m, 20000);
+}
+
+/// Sends every key to the same pages and buckets
+struct constant_hash {
+	size_t operator()(unsigned int) const { return 0; }
+};
+
+}
+
+SCENARIO("cuckoo_pages's basic functions work", "[hashtable]") {
+	GIVEN("A cuckoo table with pages") {
+		hashtable::cuckoo_pages<unsigned int, unsigned int> m;
+		const size_t n = 1000;
+		for (size_t i = 0; i < n; ++i) {
+			m[i] = i*i;
+		}
+
+		THEN("It finds everything it grew to hold") {
+			size_t wrong = 0;
+			for (size_t i = 0; i < n; ++i) {
+				wrong += m.find(i) != just<unsigned int>(i*i);
+			}
+			CHECK(wrong == 0);
+			CHECK(m.size() == n);
+			CHECK(m.find(n) == nothing<unsigned int>());
+			CHECK(m.find_ptr(n) == nullptr);
+			CHECK(m[n] == 0);
+			CHECK(m.size() == n+1);
+		}
+
+		WHEN("Its hash functions are reseeded") {
+			m.seed(42);
+			THEN("The entries stay") {
+				size_t wrong = 0;
+				for (size_t i = 0; i < n; ++i) {
+					wrong += m.find(i) != just<unsigned int>(i*i);
+				}
+				CHECK(wrong == 0);
+			}
+		}
+
+		WHEN("It is cleared") {
+			m.clear();
+			THEN("It is empty and usable") {
+				CHECK(m.size() == 0);
+				CHECK(!m.contains(1));
+				m[1] = 1;
+				CHECK(m.find(1) == just<unsigned int>(1));
+			}
+		}
+	}
+	GIVEN("A table with string keys") {
+		hashtable::cuckoo_pages<std::string, int, 8, 2> m;
+		m["foo"] = 1;
+		m["bar"] = 2;
+		m.erase("foo");
+		THEN("It stores them") {
+			CHECK(m.find("bar") == just<int>(2));
+			CHECK(!m.contains("foo"));
+		}
+	}
+}
+
+SCENARIO("cuckoo_pages layouts", "[hashtable]") {
+	GIVEN("Pages of one to 64 cache lines and buckets of one to eight slots") {
+		THEN("All of them keep exactly the remaining keys") {
+			CHECK((pageMismatches<1, 1>()) == 0);
+			CHECK((pageMismatches<1, 3>()) == 0);
+			CHECK((pageMismatches<8, 4>()) == 0);
+			CHECK((pageMismatches<64, 4>()) == 0);
+			CHECK((pageMismatches<64, 8>()) == 0);
+		}
+	}
+	GIVEN("A table that may fill 95% of its slots") {
+		hashtable::cuckoo_pages<unsigned int, unsigned int, 8, 4> m(0, 0.95);
+		const size_t n = 1000;
+		for (size_t i = 0; i < n; ++i) {
+			m[i] = i;
+		}
+		common::structure_stats stats;
+		m.inspect(stats);
+
+		THEN("Its buckets and the stash count as its slots") {
+			size_t wrong = 0;
+			for (size_t i = 0; i < n; ++i) {
+				wrong += m.find(i) != just<unsigned int>(i);
+			}
+			CHECK(wrong == 0);
+			CHECK(stats.entries == n);
+			size_t bucketSlots = stats.buckets * 4 + 4;
+			CHECK(bucketSlots == stats.slots);
+		}
+	}
+	GIVEN("Keys that all have the same pages and buckets") {
+		hashtable::cuckoo_pages<unsigned int, unsigned int, 1, 3, constant_hash> m;
+		THEN("Inserting more than they and the stash hold throws") {
+			bool threw = false;
+			try {
+				for (unsigned int i = 0; i < 20; ++i) {
+					m[i] = i;
+				}
+			} catch (const std::length_error &) {
+				threw = true;
+			}
+			CHECK(threw);
+			CHECK(m.size() == 0);
+		}
+	}
+}
@@ -0,0 +1,85 @@
+#include "catch.hpp"
+
+#include <common/epoch.h>
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+struct counted {
+	static int alive;
+	counted() { ++alive; }
+	~counted() { --alive; }
+};
+
+int counted::alive = 0;
+
+}
+
+SCENARIO("Epoch-based reclamation", "[epoch]") {
+	GIVEN("A limbo list without readers") {
+		common::epoch::limbo limbo;
+		limbo.retire(new counted());
+		limbo.retire(new counted());
+
+		WHEN("The writer collects a few times") {
+			for (int i = 0; i < 3; ++i) {
+				limbo.collect();
+			}
+			THEN("Everything retired is freed") {
+				CHECK(counted::alive == 0);
+				CHECK(limbo.size() == 0);
+			}
+		}
+	}
+
+	GIVEN("A reader that holds a guard on another thread") {
+		common::epoch::limbo limbo;
+		std::atomic<int> stage(0);
+		std::thread reader([&]() {
+			common::epoch::guard guard;
+			stage = 1;
+			while (stage != 2) {
+				std::this_thread::yield();
+			}
+		});
+		while (stage != 1) {
+			std::this_thread::yield();
+		}
+		limbo.retire(new counted());
+
+		WHEN("The writer collects while the reader is in its guard") {
+			for (int i = 0; i < 5; ++i) {
+				limbo.collect();
+			}
+			int aliveInGuard = counted::alive;
+			stage = 2;
+			reader.join();
+
+			THEN("The object survives until the reader has left") {
+				CHECK(aliveInGuard == 1);
+				for (int i = 0; i < 3; ++i) {
+					limbo.collect();
+				}
+				CHECK(counted::alive == 0);
+			}
+		}
+	}
+
+	GIVEN("Nested guards") {
+		common::epoch::limbo limbo;
+		common::epoch::guard outer;
+		{
+			common::epoch::guard inner;
+		}
+		limbo.retire(new counted());
+		for (int i = 0; i < 5; ++i) {
+			limbo.collect();
+		}
+
+		THEN("Leaving the inner guard keeps the outer one announced") {
+			CHECK(counted::alive == 1);
+		}
+	}
+}
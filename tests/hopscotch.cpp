@@ -0,0 +1,116 @@
+#include "../hashtable/hopscotch.h"
+#include "catch.hpp"
+#include "churn.h"
+
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+/// Churns a table filled close to its maximum load
+template <size_t Neighborhood>
+size_t hopscotchMismatches() {
+	hashtable::hopscotch<unsigned int, unsigned int, Neighborhood> m(0, 0.95);
+	return churnMismatches(m, 20000);
+}
+
+/// Sends every key to slot 0
+struct constant_hash {
+	size_t operator()(unsigned int) const { return 0; }
+};
+
+}
+
+SCENARIO("hopscotch's basic functions work", "[hashtable]") {
+	GIVEN("A hopscotch table") {
+		hashtable::hopscotch<unsigned int, unsigned int> m;
+		const size_t n = 20000;
+		for (size_t i = 0; i < n; ++i) {
+			m[i] = i*i;
+		}
+
+		THEN("It finds everything it grew to hold, and misses the rest") {
+			size_t wrong = 0;
+			for (size_t i = 0; i < n; ++i) {
+				wrong += m.find(i) != just<unsigned int>(i*i);
+			}
+			CHECK(wrong == 0);
+			CHECK(m.size() == n);
+			CHECK(m.find(n) == nothing<unsigned int>());
+			CHECK(m.find_ptr(n) == nullptr);
+			CHECK(m[n] == 0);
+			CHECK(m.size() == n+1);
+		}
+
+		WHEN("Its hash function is reseeded") {
+			m.seed(42);
+			THEN("The entries stay") {
+				size_t wrong = 0;
+				for (size_t i = 0; i < n; ++i) {
+					wrong += m.find(i) != just<unsigned int>(i*i);
+				}
+				CHECK(wrong == 0);
+			}
+		}
+
+		WHEN("It is cleared") {
+			m.clear();
+			THEN("It is empty and usable") {
+				CHECK(m.size() == 0);
+				CHECK(!m.contains(1));
+				m[1] = 1;
+				CHECK(m.find(1) == just<unsigned int>(1));
+			}
+		}
+	}
+	GIVEN("A table with string keys") {
+		hashtable::hopscotch<std::string, int, 64> m;
+		m["foo"] = 1;
+		m["bar"] = 2;
+		m.erase("foo");
+		THEN("It stores them") {
+			CHECK(m.find("bar") == just<int>(2));
+			CHECK(!m.contains("foo"));
+		}
+	}
+}
+
+SCENARIO("hopscotch neighborhoods", "[hashtable]") {
+	GIVEN("Neighborhoods of 32 and 64 slots at 95% load") {
+		THEN("Both keep exactly the remaining keys through erase cycles") {
+			CHECK((hopscotchMismatches<32>()) == 0);
+			CHECK((hopscotchMismatches<64>()) == 0);
+		}
+	}
+	GIVEN("A table whose keys all share one home slot") {
+		hashtable::hopscotch<unsigned int, unsigned int, 32, constant_hash> m;
+		for (unsigned int i = 0; i < 32; ++i) {
+			m[i] = i;
+		}
+
+		THEN("A full neighborhood works") {
+			size_t wrong = 0;
+			for (unsigned int i = 0; i < 32; ++i) {
+				wrong += m.find(i) != just<unsigned int>(i);
+			}
+			CHECK(wrong == 0);
+			CHECK(m.erase(0) == 1);
+			CHECK(m.find(31) == just<unsigned int>(31));
+		}
+
+		WHEN("More keys share it than the neighborhood holds") {
+			THEN("Inserting them throws") {
+				bool threw = false;
+				try {
+					for (unsigned int i = 32; i < 40; ++i) {
+						m[i] = i;
+					}
+				} catch (const std::length_error &) {
+					threw = true;
+				}
+				CHECK(threw);
+				CHECK(m.size() == 0);
+			}
+		}
+	}
+}
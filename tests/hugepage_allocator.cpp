@@ -0,0 +1,56 @@
+#include "catch.hpp"
+
+#include <common/hugepage_allocator.h>
+#include <hashtable/DPH_with_buckets.h>
+#include <hashtable/DPH_with_single_vector.h>
+#include <hashtable/unordered_map.h>
+
+#include <cstdint>
+#include <vector>
+
+SCENARIO("hugepage_allocator", "[allocator]") {
+	GIVEN("Vectors below and above the huge page size") {
+		const size_t small = 1000, large = 3 * common::hugepage_allocator<int>::huge_page_size / sizeof(int) + 7;
+		std::vector<int, common::hugepage_allocator<int>> a(small), b(large);
+		for (size_t i = 0; i < large; ++i) {
+			b[i] = i;
+		}
+
+		THEN("Both are usable, and the mapped one is aligned to a huge page") {
+			size_t offset = reinterpret_cast<uintptr_t>(b.data()) % common::hugepage_allocator<int>::huge_page_size;
+			CHECK(a.size() == small);
+			CHECK(b[large - 1] == int(large - 1));
+			CHECK(offset == 0);
+		}
+		WHEN("The large vector grows") {
+			b.resize(2 * large, 1);
+			THEN("Its contents move along") {
+				CHECK(b[large - 1] == int(large - 1));
+				CHECK(b[2 * large - 1] == 1);
+			}
+		}
+	}
+	GIVEN("Hash tables on huge pages") {
+		hashtable::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+								 common::hugepage_allocator<std::pair<const int, int>>> m;
+		hashtable::DPH_with_single_vector<int, int, std::hash<int>, hashtable::prime_modulo_family<>,
+										  common::hugepage_allocator<hashtable::bucket_entry<int, int>>> v(100);
+		hashtable::DPH_with_buckets<int, int, std::hash<int>, hashtable::prime_modulo_family<>, hashtable::hugepage_storage> d(100);
+		const size_t n = 20000;
+		for (size_t i = 0; i < n; ++i) {
+			m[i] = i;
+			v[i] = i;
+			d[i] = i;
+		}
+
+		THEN("They find all their elements") {
+			size_t wrong = 0;
+			for (size_t i = 0; i < n; ++i) {
+				wrong += m.find(i) != just<int>(i);
+				wrong += v.find(i) != just<int>(i);
+				wrong += d.find(i) != just<int>(i);
+			}
+			CHECK(wrong == 0);
+		}
+	}
+}
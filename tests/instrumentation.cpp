@@ -0,0 +1,61 @@
+#include "catch.hpp"
+
+// The archives come first, as in experiments.h, so that the exports
+// register the results with them
+#include <boost/archive/text_iarchive.hpp>
+#include <boost/archive/text_oarchive.hpp>
+
+#include <common/instrumentation.h>
+
+#include <sstream>
+#include <string>
+
+namespace {
+
+/// Writes a result through a base class pointer, as experiment_runner does,
+/// reads it back and returns both of their result columns
+std::pair<std::string, std::string> roundTrip(common::benchmark_result *written) {
+	std::stringstream archive;
+	{
+		boost::archive::text_oarchive oa(archive);
+		oa << written;
+	}
+	common::benchmark_result *read = nullptr;
+	{
+		boost::archive::text_iarchive ia(archive);
+		ia >> read;
+	}
+	std::ostringstream before, after;
+	written->result(before);
+	read->result(after);
+	delete written;
+	delete read;
+	return std::make_pair(before.str(), after.str());
+}
+
+}
+
+SCENARIO("Results survive serialization through the base class", "[instrumentation]") {
+	GIVEN("A structure result with bucket sizes") {
+		common::structure_stats stats;
+		stats.slots = 64;
+		stats.entries = 40;
+		stats.tombstones = 3;
+		stats.bytes = 1024;
+		stats.add_bucket(8, 5, 1);
+		stats.add_bucket(8, 0, 0);
+
+		THEN("It reads back the same") {
+			auto columns = roundTrip(new common::structure_result(stats));
+			CHECK(columns.first == columns.second);
+		}
+	}
+	GIVEN("Rehash and latency results") {
+		THEN("They read back the same") {
+			auto rehash = roundTrip(new common::rehash_result());
+			CHECK(rehash.first == rehash.second);
+			auto latency = roundTrip(new common::latency_result(1.0, 2.0, 3.0));
+			CHECK(latency.first == latency.second);
+		}
+	}
+}
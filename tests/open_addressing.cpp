@@ -0,0 +1,164 @@
+#include "../hashtable/open_addressing.h"
+#include "catch.hpp"
+#include "churn.h"
+
+#include <vector>
+
+namespace {
+
+/// Churns a table with the given strategies
+template <typename Probing, typename Deletion>
+size_t strategyMismatches() {
+	hashtable::open_addressing<int, int, Probing, Deletion> m;
+	return churnMismatches(m, 20000);
+}
+
+}
+
+SCENARIO("open_addressing's basic functions work", "[hashtable]") {
+	GIVEN("An open_addressing table") {
+		hashtable::open_addressing<unsigned int, unsigned int> m;
+		const size_t n = 1000;
+		for (size_t i = 0; i < n; ++i) {
+			m[i] = i*i;
+		}
+
+		THEN("It finds everything it grew to hold") {
+			size_t wrong = 0;
+			for (size_t i = 0; i < n; ++i) {
+				wrong += m.find(i) != just<unsigned int>(i*i);
+			}
+			CHECK(wrong == 0);
+			CHECK(m.size() == n);
+			CHECK(m.find(n) == nothing<unsigned int>());
+			CHECK(m.find_ptr(n) == nullptr);
+			CHECK(m[n] == 0);
+			CHECK(m.size() == n+1);
+		}
+
+		WHEN("Its hash function is reseeded") {
+			m.seed(42);
+			THEN("The entries stay") {
+				size_t wrong = 0;
+				for (size_t i = 0; i < n; ++i) {
+					wrong += m.find(i) != just<unsigned int>(i*i);
+				}
+				CHECK(wrong == 0);
+			}
+		}
+
+		WHEN("We erase elements") {
+			for (size_t i = 0; i < n; i += 2) {
+				m.erase(i);
+			}
+			common::structure_stats stats;
+			m.inspect(stats);
+			THEN("They leave tombstones") {
+				CHECK(m.size() == n/2);
+				CHECK(stats.entries == n/2);
+				CHECK(stats.tombstones == n/2);
+				CHECK(!m.contains(0));
+				CHECK(m.contains(1));
+			}
+		}
+
+		WHEN("It is cleared") {
+			m.clear();
+			THEN("It is empty and usable") {
+				CHECK(m.size() == 0);
+				CHECK(!m.contains(1));
+				m[1] = 1;
+				CHECK(m.find(1) == just<unsigned int>(1));
+			}
+		}
+	}
+}
+
+SCENARIO("open_addressing strategies", "[hashtable]") {
+	using namespace hashtable;
+	GIVEN("Every probing and deletion strategy") {
+		THEN("All combinations keep exactly the remaining keys") {
+			CHECK((strategyMismatches<linear_probing, tombstone_deletion>()) == 0);
+			CHECK((strategyMismatches<linear_probing, backward_shift_deletion>()) == 0);
+			CHECK((strategyMismatches<linear_probing, moving_tombstone_deletion>()) == 0);
+			CHECK((strategyMismatches<quadratic_probing, tombstone_deletion>()) == 0);
+			CHECK((strategyMismatches<quadratic_probing, moving_tombstone_deletion>()) == 0);
+			CHECK((strategyMismatches<double_hashing, tombstone_deletion>()) == 0);
+			CHECK((strategyMismatches<double_hashing, moving_tombstone_deletion>()) == 0);
+		}
+	}
+	GIVEN("A table with backward-shift deletion") {
+		open_addressing<int, int, linear_probing, backward_shift_deletion> m;
+		for (int i = 0; i < 1000; ++i) {
+			m[i] = i;
+		}
+		for (int i = 0; i < 1000; i += 2) {
+			m.erase(i);
+		}
+		common::structure_stats stats;
+		m.inspect(stats);
+
+		THEN("Erasing leaves no tombstones") {
+			CHECK(stats.tombstones == 0);
+			CHECK(m.find(999) == just<int>(999));
+		}
+	}
+	GIVEN("A table that moves entries into tombstones") {
+		open_addressing<int, int, linear_probing, moving_tombstone_deletion> m;
+		const int n = 1000;
+		for (int i = 0; i < n; ++i) {
+			m[i] = i;
+		}
+		// Where the entries are while there are no tombstones yet
+		std::vector<const int*> before;
+		for (int i = 1; i < n; i += 2) {
+			before.push_back(m.find_ptr(i));
+		}
+		for (int i = 0; i < n; i += 2) {
+			m.erase(i);
+		}
+
+		THEN("Lookups leave every entry in place") {
+			size_t moved = 0;
+			for (int i = 1; i < n; i += 2) {
+				moved += m.find(i) != just<int>(i);
+				moved += m.find_ptr(i) != before[i / 2];
+			}
+			CHECK(moved == 0);
+		}
+		WHEN("The entries are accessed through operator[]") {
+			size_t wrong = 0;
+			for (int i = 1; i < n; i += 2) {
+				wrong += m[i] != i;
+			}
+			size_t moved = 0;
+			for (int i = 1; i < n; i += 2) {
+				wrong += m.find(i) != just<int>(i);
+				moved += m.find_ptr(i) != before[i / 2];
+			}
+			THEN("Some move closer to their home slot") {
+				CHECK(wrong == 0);
+				CHECK(moved > 0);
+				CHECK(m.size() == size_t(n / 2));
+			}
+		}
+	}
+	GIVEN("A table that only cycles a few keys") {
+		open_addressing<int, int> m;
+		for (int round = 0; round < 1000; ++round) {
+			for (int i = 0; i < 10; ++i) {
+				m[round * 10 + i] = i;
+			}
+			for (int i = 0; i < 10; ++i) {
+				m.erase(round * 10 + i);
+			}
+		}
+		common::structure_stats stats;
+		m.inspect(stats);
+
+		THEN("Rehashes drop the tombstones instead of growing") {
+			CHECK(m.size() == 0);
+			CHECK(stats.slots <= 64);
+		}
+	}
+}
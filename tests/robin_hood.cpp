@@ -0,0 +1,130 @@
+#include "../hashtable/robin_hood.h"
+#include "catch.hpp"
+
+#include <stdexcept>
+#include <string>
+
+SCENARIO("robin_hood's basic functions work", "[hashtable]") {
+	GIVEN("A robin_hood table at 95% load") {
+		hashtable::robin_hood<unsigned int, unsigned int> m(0, 0.95);
+		const size_t n = 20000;
+		for (size_t i = 0; i < n; ++i) {
+			m[i * 7919] = i;
+		}
+
+		THEN("It finds everything it grew to hold, and misses the rest") {
+			size_t wrong = 0;
+			for (size_t i = 0; i < n; ++i) {
+				wrong += m.find(i * 7919) != just<unsigned int>(i);
+				wrong += m.contains(i * 7919 + 1);
+			}
+			CHECK(wrong == 0);
+			CHECK(m.size() == n);
+			CHECK(m.find_ptr(1) == nullptr);
+		}
+
+		WHEN("Its hash function is reseeded") {
+			m.seed(42);
+			THEN("The entries stay") {
+				size_t wrong = 0;
+				for (size_t i = 0; i < n; ++i) {
+					wrong += m.find(i * 7919) != just<unsigned int>(i);
+				}
+				CHECK(wrong == 0);
+			}
+		}
+
+		WHEN("We erase and reinsert elements in cycles") {
+			for (int round = 0; round < 3; ++round) {
+				for (size_t i = 0; i < n; ++i) {
+					if (i % 3 != 0) {
+						m.erase(i * 7919);
+					}
+				}
+				for (size_t i = 0; i < n; ++i) {
+					if (i % 3 == 1) {
+						m[i * 7919] = i;
+					}
+				}
+			}
+			common::structure_stats stats;
+			m.inspect(stats);
+			THEN("Exactly the remaining keys are left, without tombstones") {
+				size_t wrong = 0;
+				for (size_t i = 0; i < n; ++i) {
+					bool found = m.find(i * 7919) == just<unsigned int>(i);
+					wrong += found != (i % 3 != 2);
+				}
+				CHECK(wrong == 0);
+				CHECK(m.size() == (n + 2) / 3 + (n + 1) / 3);
+				CHECK(stats.tombstones == 0);
+				CHECK(m.erase(2 * 7919) == 0);
+			}
+		}
+
+		WHEN("It is cleared") {
+			m.clear();
+			THEN("It is empty and usable") {
+				CHECK(m.size() == 0);
+				CHECK(!m.contains(0));
+				m[1] = 1;
+				CHECK(m.find(1) == just<unsigned int>(1));
+			}
+		}
+	}
+}
+
+namespace {
+
+/// Sends every key to slot 0
+struct constant_hash {
+	size_t operator()(unsigned int) const { return 0; }
+};
+
+}
+
+SCENARIO("robin_hood with long runs", "[hashtable]") {
+	GIVEN("A table whose keys all share one home slot") {
+		hashtable::robin_hood<unsigned int, unsigned int, constant_hash> m;
+		const size_t n = 200;
+		for (size_t i = 0; i < n; ++i) {
+			m[i] = i;
+		}
+
+		THEN("Runs up to the longest probe distance work") {
+			size_t wrong = 0;
+			for (size_t i = 0; i < n; ++i) {
+				wrong += m.find(i) != just<unsigned int>(i);
+			}
+			CHECK(wrong == 0);
+			CHECK(m.size() == n);
+			m.erase(0);
+			CHECK(m.find(n-1) == just<unsigned int>(n-1));
+		}
+
+		WHEN("More keys share it than a probe distance can hold") {
+			THEN("Inserting them throws") {
+				bool threw = false;
+				try {
+					for (size_t i = n; i < 300; ++i) {
+						m[i] = i;
+					}
+				} catch (const std::length_error &) {
+					threw = true;
+				}
+				CHECK(threw);
+				CHECK(m.size() == 0);
+			}
+		}
+	}
+	GIVEN("A table with string keys") {
+		hashtable::robin_hood<std::string, int> m;
+		m["foo"] = 1;
+		m["bar"] = 2;
+		m.erase("foo");
+		THEN("It stores them") {
+			CHECK(m.find("bar") == just<int>(2));
+			CHECK(!m.contains("foo"));
+		}
+	}
+}
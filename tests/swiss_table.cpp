@@ -0,0 +1,103 @@
+#include "../hashtable/swiss_table.h"
+#include "catch.hpp"
+#include "churn.h"
+
+#include <string>
+
+namespace {
+
+/// Churns a table filled close to its maximum load
+template <typename Group, typename PreHashFcn = std::hash<unsigned int>>
+size_t swissMismatches(size_t n) {
+	hashtable::swiss_table<unsigned int, unsigned int, Group, PreHashFcn> m(0, 0.875);
+	return churnMismatches(m, n);
+}
+
+/// Sends every key to the same group with the same tag
+struct constant_hash {
+	size_t operator()(unsigned int) const { return 0; }
+};
+
+}
+
+SCENARIO("swiss_table's basic functions work", "[hashtable]") {
+	GIVEN("A Swiss table") {
+		hashtable::swiss_table<unsigned int, unsigned int> m;
+		const size_t n = 20000;
+		for (size_t i = 0; i < n; ++i) {
+			m[i] = i*i;
+		}
+
+		THEN("It finds everything it grew to hold, and misses the rest") {
+			size_t wrong = 0;
+			for (size_t i = 0; i < n; ++i) {
+				wrong += m.find(i) != just<unsigned int>(i*i);
+			}
+			CHECK(wrong == 0);
+			CHECK(m.size() == n);
+			CHECK(m.find(n) == nothing<unsigned int>());
+			CHECK(m.find_ptr(n) == nullptr);
+			CHECK(m[n] == 0);
+			CHECK(m.size() == n+1);
+		}
+
+		WHEN("Its hash function is reseeded") {
+			m.seed(42);
+			THEN("The entries stay") {
+				size_t wrong = 0;
+				for (size_t i = 0; i < n; ++i) {
+					wrong += m.find(i) != just<unsigned int>(i*i);
+				}
+				CHECK(wrong == 0);
+			}
+		}
+
+		WHEN("All but one key are erased") {
+			for (size_t i = 1; i < n; ++i) {
+				m.erase(i);
+			}
+			common::structure_stats stats;
+			m.inspect(stats);
+			THEN("Its groups count the remaining slots") {
+				CHECK(m.size() == 1);
+				CHECK(m.find(0) == just<unsigned int>(0));
+				CHECK(stats.entries == 1);
+				CHECK(stats.slots == stats.buckets * 16);
+				CHECK(stats.tombstones <= stats.slots);
+			}
+		}
+
+		WHEN("It is cleared") {
+			m.clear();
+			THEN("It is empty and usable") {
+				CHECK(m.size() == 0);
+				CHECK(!m.contains(1));
+				m[1] = 1;
+				CHECK(m.find(1) == just<unsigned int>(1));
+			}
+		}
+	}
+	GIVEN("A table with string keys") {
+		hashtable::swiss_table<std::string, int> m;
+		m["foo"] = 1;
+		m["bar"] = 2;
+		m.erase("foo");
+		THEN("It stores them") {
+			CHECK(m.find("bar") == just<int>(2));
+			CHECK(!m.contains("foo"));
+		}
+	}
+}
+
+SCENARIO("swiss_table group matching", "[hashtable]") {
+	GIVEN("The portable and the default group matching") {
+		THEN("Both keep exactly the remaining keys through erase cycles") {
+			CHECK((swissMismatches<hashtable::portable_group>(20000)) == 0);
+			CHECK((swissMismatches<hashtable::default_group>(20000)) == 0);
+		}
+		THEN("Both handle keys that all share a group and a tag") {
+			CHECK((swissMismatches<hashtable::portable_group, constant_hash>(300)) == 0);
+			CHECK((swissMismatches<hashtable::default_group, constant_hash>(300)) == 0);
+		}
+	}
+}
@@ -30,6 +30,22 @@ SCENARIO("unordered_map's basic functions work", "[hashtable]") {
 			}
 		}
 
+		WHEN("We look up elements without copying them") {
+			THEN("find_ptr points to the stored value") {
+				const unsigned int* value = m.find_ptr(10);
+				REQUIRE(value != nullptr);
+				CHECK(*value == 100);
+				m[10] = 42;
+				CHECK(*m.find_ptr(10) == 42);
+				CHECK(m.find_ptr(n) == nullptr);
+			}
+			AND_THEN("contains tells which keys are stored") {
+				CHECK(m.contains(0));
+				CHECK(m.contains(n-1));
+				CHECK(!m.contains(n));
+			}
+		}
+
 		WHEN("We insert more elements") {
 			m[n] = n;
 			THEN("We can retrieve them again using find or operator[]") {
@@ -0,0 +1,145 @@
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "common/arg_parser.h"
+#include "common/benchmark.h"
+#include "common/contenders.h"
+#include "common/instrumentation.h"
+#include "common/terminal.h"
+
+#include "hashtable/DPH_tuning.h"
+#include "hashtable/microbenchmark.h"
+
+void usage(char* name) {
+    using std::cout;
+    using std::endl;
+    cout << "Usage: " << name << " <options>" << endl << endl
+         << "Searches the parameters of DPH-with-buckets: a grid, then local refinement" << endl
+         << "around the Pareto front of time versus peak memory." << endl << endl
+         << "Options:" << endl
+         << "-B <keys>     comma-separated benchmarks to tune on (default: insert,find,ins-del-cycle)" << endl
+         << "-k <int>      which configuration of the benchmarks to run (default: 0)" << endl
+         << "-n <int>      number of repetitions, the fastest counts (default: 3)" << endl
+         << "-r <int>      maximum number of refinement rounds (default: 3)" << endl
+         << "-o <filename> Pareto front output, for bench_hash -t (default: tuned_hash.txt)" << endl
+         << "-p <filename> RESULT lines of all measured parameters (default: results_tune.txt)" << endl;
+    exit(0);
+}
+
+int main(int argc, char** argv) {
+    common::arg_parser args(argc, argv);
+    if (args.is_set("h") || args.is_set("-help")) usage(argv[0]);
+    const std::string benchmark_keys = args.get<std::string>("B", "insert,find,ins-del-cycle"),
+                      frontfn = args.get<std::string>("o", "tuned_hash.txt"),
+                      resultfn = args.get<std::string>("p", "results_tune.txt");
+    const size_t config_index = args.get<size_t>("k", 0),
+                 repetitions  = args.get<size_t>("n", 3),
+                 max_rounds   = args.get<size_t>("r", 3);
+
+    using HashTable = hashtable::hashtable<int, int>;
+    using Configuration = std::pair<size_t, size_t>;
+    using Benchmark = common::benchmark<HashTable, Configuration>;
+
+    // Select the benchmarks to tune on
+    std::set<std::string> keys;
+    std::istringstream key_stream(benchmark_keys);
+    for (std::string key; std::getline(key_stream, key, ',');) {
+        keys.insert(key);
+    }
+    common::contender_list<Benchmark> all_benchmarks;
+    hashtable::microbenchmark<HashTable>::register_benchmarks(all_benchmarks);
+    std::vector<common::contender_factory<Benchmark>> benchmarks;
+    for (auto benchmark_factory : all_benchmarks) {
+        if (keys.count(benchmark_factory.key()) > 0) {
+            benchmarks.push_back(benchmark_factory);
+        }
+    }
+    if (benchmarks.empty()) {
+        std::cerr << "No benchmark matches " << benchmark_keys << std::endl;
+        exit(1);
+    }
+
+    common::timer_instrumentation timer;
+    common::memory_instrumentation memory;
+
+    // Measures the summed time of the fastest runs and the largest peak memory
+    std::map<hashtable::DPH_parameters, hashtable::DPH_tuning_point> measured;
+    auto measure = [&](const hashtable::DPH_parameters &p) {
+        if (measured.count(p) > 0) return;
+        common::contender_factory<HashTable> factory(p.key(), p.key(),
+            [p](){ return p.create<int, int>(); });
+        hashtable::DPH_tuning_point point{p, 0, 0};
+        for (auto benchmark_factory : benchmarks) {
+            auto benchmark = benchmark_factory();
+            Configuration configuration = *(benchmark->begin() + std::min(config_index,
+                size_t(benchmark->end() - benchmark->begin()) - 1));
+            double time = 1e100;
+            for (size_t rep = 0; rep < repetitions; ++rep) {
+                auto t = benchmark->run(factory, &timer, configuration);
+                time = std::min(time, t->milliseconds());
+                delete t;
+            }
+            auto m = benchmark->run(factory, &memory, configuration);
+            point.time += time;
+            point.peak = std::max(point.peak, m->peak_bytes());
+            delete m;
+            delete benchmark;
+        }
+        std::cout << p.key() << ": " << point.time << "ms, "
+                  << (1.0 * point.peak) / (1<<20) << " MB" << std::endl;
+        measured[p] = point;
+    };
+    auto front = [&]() {
+        std::vector<hashtable::DPH_tuning_point> points;
+        for (auto &entry : measured) {
+            points.push_back(entry.second);
+        }
+        return hashtable::DPH_pareto_front(points);
+    };
+
+    // Coarse grid, including the hand-picked defaults
+    std::cout << common::term::bold << "Grid search" << common::term::reset << std::endl;
+    measure(hashtable::DPH_parameters::defaults());
+    for (const hashtable::DPH_parameters &p : hashtable::DPH_tuning_grid()) {
+        measure(p);
+    }
+
+    // Local refinement around the front until it stops changing
+    for (size_t round = 1; round <= max_rounds; ++round) {
+        std::cout << common::term::bold << "Refinement round " << round << common::term::reset << std::endl;
+        size_t before = measured.size();
+        for (const hashtable::DPH_tuning_point &point : front()) {
+            for (const hashtable::DPH_parameters &p : hashtable::DPH_tuning_neighbours(point.parameters)) {
+                measure(p);
+            }
+        }
+        if (measured.size() == before) break;
+    }
+
+    // Print the front and write it for bench_hash -t
+    std::ofstream ofs(frontfn);
+    std::set<hashtable::DPH_parameters> on_front;
+    std::cout << std::endl << common::term::bold << "Pareto front (time vs. peak memory)"
+              << common::term::reset << std::endl;
+    for (const hashtable::DPH_tuning_point &point : front()) {
+        std::cout << point.parameters.key() << ": " << point.time << "ms, "
+                  << (1.0 * point.peak) / (1<<20) << " MB"
+                  << (point.parameters == hashtable::DPH_parameters::defaults() ? " (defaults)" : "")
+                  << std::endl;
+        ofs << point.parameters << std::endl;
+        on_front.insert(point.parameters);
+    }
+
+    // Print RESULT lines for sqlplot-tools
+    std::ofstream res(resultfn);
+    for (auto &entry : measured) {
+        const hashtable::DPH_tuning_point &point = entry.second;
+        res << "RESULT params=" << point.parameters.key()
+            << " time=" << point.time << " peakmem=" << point.peak
+            << " front=" << on_front.count(point.parameters) << std::endl;
+    }
+}